@@ -39,6 +39,7 @@
 
 	// #include <numeric/alignment/QCP_Kernel.hh>
 	#include <parallel/algorithm>
+	#include <cmath>
 	#include <exception>
 	#include <stdexcept>
 
@@ -73,6 +74,8 @@
 	#include <scheme/objective/hash/XformHash.hh>
 	#include <riflib/scaffold/ScaffoldDataCache.hh>
 	#include <riflib/scaffold/ScaffoldProviderFactory.hh>
+	#include <riflib/scaffold/ScaffoldPrefetcher.hh>
+	#include <riflib/OutputWriter.hh>
 	#include <riflib/BurialManager.hh>
 	#include <riflib/UnsatManager.hh>
 	#include <riflib/ScoreRotamerVsTarget.hh>
@@ -114,6 +117,7 @@ int main(int argc, char *argv[]) {
 	RifDockOpt opt;
 	opt.init_from_cli();
 	utility::file::create_directory_recursive( opt.outdir );
+	if ( opt.checkpoint_dir.size() ) utility::file::create_directory_recursive( opt.checkpoint_dir );
 
 
 
@@ -147,6 +151,11 @@ int main(int argc, char *argv[]) {
 		::scheme::search::HackPackOpts packopts;
 		packopts.pack_n_iters         = opt.pack_n_iters;
 		packopts.pack_iter_mult       = opt.pack_iter_mult;
+		packopts.packer               = opt.hackpack_packer;
+		packopts.exact_pack_max_cost  = opt.hackpack_exact_max_cost;
+		packopts.exact_pack_max_table = opt.hackpack_exact_max_table;
+		runtime_assert_msg( packopts.packer == "anneal" || packopts.packer == "exact" || packopts.packer == "auto",
+			"-rif_dock:hackpack_packer must be anneal, exact or auto" );
 		packopts.hbond_weight         = opt.hbond_weight;
 		packopts.upweight_iface       = opt.upweight_iface;
 		packopts.upweight_multi_hbond = opt.upweight_multi_hbond;
@@ -517,6 +526,25 @@ int main(int argc, char *argv[]) {
 		}
 	}
 
+	std::vector< std::vector< ::scheme::objective::voxel::CompactVoxelArray * > > target_bounding_compact;
+	if( opt.target_grid_storage != "float" ){
+		runtime_assert_msg( opt.target_grid_storage == "fp16" || opt.target_grid_storage == "int8",
+			"-rif_dock:target_grid_storage must be float, fp16 or int8" );
+		print_header( "converting target bounding grids to " + opt.target_grid_storage );
+		// the unbounded fields and the CH3 proximity grids are still read as float
+		std::vector< VoxelArrayPtr > keep_float( target_field_by_atype );
+		for( int iresl = 0; iresl < std::min<int>( 3, target_bounding_by_atype.size() ); ++iresl ){
+			if( target_bounding_by_atype[iresl].size() > 5 ) keep_float.push_back( target_bounding_by_atype[iresl][5] );
+		}
+		devel::scheme::compact_bounding_fields(
+			target_bounding_by_atype,
+			keep_float,
+			opt.target_grid_storage == "int8" ? ::scheme::objective::voxel::CompactVoxelArray::INT8
+			                                  : ::scheme::objective::voxel::CompactVoxelArray::FP16,
+			target_bounding_compact
+		);
+	}
+
 
 #ifdef USEGRIDSCORE
 	shared_ptr<protocols::ligand_docking::ga_ligand_dock::GridScorer> grid_scorer;
@@ -552,6 +580,10 @@ int main(int argc, char *argv[]) {
     rot_tgt_scorer.target_donor_cache_ = target_donor_cache;
     rot_tgt_scorer.target_acceptor_cache_ = target_acceptor_cache;
 
+    if ( opt.benchmark_rotamer_scoring > 0 ) {
+        benchmark_score_rotamer_v_target( rot_tgt_scorer, opt.benchmark_rotamer_scoring );
+    }
+
 
 	// These numbers are magic, you can't change any individually
 	// They come from fitting against 4S0U with 20 mini-proteins (64aa)
@@ -673,6 +705,13 @@ int main(int argc, char *argv[]) {
 			}
 		}
 
+		for( int i = 0; i < std::min( opt.bound_only_rif_resls, (int)rif_ptrs.size() ); ++i ){
+			if( ! rif_ptrs[i] || rif_ptrs[i]->has_bound_only() ) continue;
+			runtime_assert_msg( rif_ptrs[i]->build_bound_only(), "failed to build bound-only rif for resl " + str(i) );
+			std::cout << "bound-only RIF for resl " << F(7,3,RESLS[i]) << " mem_use: "
+			          << ::devel::scheme::KMGT( rif_ptrs[i]->bound_only_mem_use() ) << " vs " << ::devel::scheme::KMGT( rif_ptrs[i]->mem_use() ) << std::endl;
+		}
+
 		rif_using_rot.resize( rot_index_p->size(), false );
 
 		if ( rif_ptrs.back() ) {
@@ -820,7 +859,45 @@ int main(int argc, char *argv[]) {
         std::cout << "WARNING: NO SCAFFOLDS!!!!!!" << std::endl;
     }
 
-	for( int iscaff = 0; iscaff < opt.scaffold_fnames.size(); ++iscaff )
+	// with -scaffold_batch_size, each provider holds that many scaffolds and they are docked together
+	int const scaffold_batch_size = std::max( 1, opt.scaffold_batch_size );
+	int const n_scaffold_batches = ( opt.scaffold_fnames.size() + scaffold_batch_size - 1 ) / scaffold_batch_size;
+
+	// loads scaffolds and builds their tables ahead of the one being docked
+	ScaffoldPrefetcher scaffold_prefetcher( n_scaffold_batches, opt.scaffold_prefetch,
+		[&]( int ibatch, ScaffoldPrefetcher::Prepared & prepared ){
+			prepared.scaffold_provider = get_scaffold_provider(
+				ibatch * scaffold_batch_size,
+				rot_index_p,
+				opt,
+				make2bopts,
+				rotrf_table_manager,
+				prepared.needs_scaffold_director);
+			if ( opt.scaffold_prefetch <= 0 ) return;
+			uint64_t n_members = scaffold_batch_size > 1 ? prepared.scaffold_provider->get_scaffold_index_limits().front() : 1;
+			for ( uint64_t i = 0; i < n_members; i++ ) {
+				ScaffoldIndex si = scaffold_batch_size > 1 ? ScaffoldIndex( 0, i ) : ScaffoldIndex();
+				prepared.scaffold_provider->get_data_cache_slow( si )->setup_onebody_tables( rot_index_p, opt );
+				if ( opt.hack_pack || opt.hack_pack_during_hsearch || opt.test_hackpack ) {
+					prepared.scaffold_provider->setup_twobody_tables( si );
+				}
+			}
+		});
+
+	// writes the output pdbs in the background while the next results and scaffolds are made
+	shared_ptr<OutputWriter> output_writer = make_shared<OutputWriter>( opt.n_output_threads, 4 * opt.n_output_threads );
+
+	// with -hsearch_n_shards, each HSearch stage is scored by several processes
+	shared_ptr< ::scheme::util::ShardExchange > hsearch_shards;
+	if ( opt.hsearch_n_shards > 1 ) {
+		utility::file::create_directory_recursive( opt.hsearch_shard_dir );
+		hsearch_shards = make_shared< ::scheme::util::ShardExchange >( opt.hsearch_shard_dir, opt.hsearch_n_shards, opt.hsearch_shard );
+		if ( hsearch_shards->is_coordinator() && ! hsearch_shards->is_empty() ) {
+			utility_exit_with_message( "-hsearch_shard_dir must be empty when the coordinator starts: " + opt.hsearch_shard_dir );
+		}
+	}
+
+	for( int iscaff = 0; iscaff < opt.scaffold_fnames.size(); iscaff += scaffold_batch_size )
 	{
 		std::string scaff_fname = opt.scaffold_fnames.at(iscaff);
 		std::vector<std::string> scaffold_sequence_glob0;				// Scaffold sequence in name3 space
@@ -835,19 +912,17 @@ int main(int argc, char *argv[]) {
 			std::cout << "/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////" << std::endl;
 			std::cout << "/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////" << std::endl;
 			std::cout << "//////   begin scaffold " << scafftag << " " << iscaff << " of " << opt.scaffold_fnames.size() << std::endl;
+			if ( scaffold_batch_size > 1 ) {
+				int iscaff_end = std::min<int>( iscaff + scaffold_batch_size, opt.scaffold_fnames.size() );
+				std::cout << "//////   batched with scaffolds " << iscaff << " to " << iscaff_end-1 << " in one search" << std::endl;
+			}
 			std::cout << "/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////" << std::endl;
 			std::cout << "/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////" << std::endl;
 
 
-			bool needs_scaffold_director = false;
-
-			ScaffoldProviderOP scaffold_provider = get_scaffold_provider(
-				iscaff,
-				rot_index_p,
-				opt,
-				make2bopts,
-				rotrf_table_manager,
-				needs_scaffold_director);
+			ScaffoldPrefetcher::Prepared prepared = scaffold_prefetcher.get( iscaff / scaffold_batch_size );
+			bool needs_scaffold_director = prepared.needs_scaffold_director;
+			ScaffoldProviderOP scaffold_provider = prepared.scaffold_provider;
 
 			// General info about a generic scaffold for debugging, cout, and the director
 			ScaffoldDataCacheOP test_data_cache = scaffold_provider->get_data_cache_slow( ScaffoldIndex() );
@@ -861,6 +936,11 @@ int main(int argc, char *argv[]) {
 			std::cout << "using redundancy_filter_rg: ~" << test_redundancy_filter_rg << std::endl;
 			if ( burial_manager ) test_data_cache->setup_burial_grids( burial_manager );
 
+			// the director must cover the largest scaffold of a batch
+			for ( uint64_t i = 1; scaffold_batch_size > 1 && i < scaffold_provider->get_scaffold_index_limits().front(); i++ ) {
+				test_scaff_radius = std::max( test_scaff_radius, scaffold_provider->get_data_cache_slow( ScaffoldIndex( 0, i ) )->scaff_radius );
+			}
+
 
 			shared_ptr<std::vector<EigenXform>> seeding_positions = setup_seeding_positions( opt, pd, scaffold_provider, iscaff );
 
@@ -895,6 +975,7 @@ int main(int argc, char *argv[]) {
             	rso_config.hydrophobic_ddg_cut = opt.hydrophobic_ddg_cut;
 
             	rso_config.ignore_rifres_if_worse_than = opt.ignore_rifres_if_worse_than;
+            	rso_config.n_bound_only_resls = opt.bound_only_rif_resls;
 
 
             if ( opt.require_satisfaction > 0 && rif_ptrs.back()->has_sat_data_slots() ) {
@@ -936,7 +1017,8 @@ int main(int argc, char *argv[]) {
 
 
 			ScenePtr scene_minimal( scene_prototype->clone_deep() );
-			scene_minimal->add_actor( 0, VoxelActor(target_bounding_by_atype) );
+			scene_minimal->add_actor( 0, VoxelActor(target_bounding_by_atype,target_bounding_compact) );
+			scene_minimal->set_rotation_cache_size( std::max( opt.scene_rotation_cache_size, 0 ) );
 
 
 			///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -1042,7 +1124,9 @@ int main(int argc, char *argv[]) {
  						scaffold_provider,
  						burial_manager,
  						unsat_manager,
- 						hydrophobic_manager
+ 						hydrophobic_manager,
+						output_writer,
+						hsearch_shards
 #ifdef USEGRIDSCORE
     				,   grid_scorer
 #endif
@@ -1081,9 +1165,6 @@ int main(int argc, char *argv[]) {
 				}
 				if ( opt.test_hackpack ) {
 					scaffold_provider->setup_twobody_tables( ScaffoldIndex() );
-					if ( unsat_manager ) {
-						scaffold_provider->setup_twobody_tables_per_thread( ScaffoldIndex() );
-					}
 
 
 					SearchPointWithRots result;
@@ -1187,7 +1268,30 @@ int main(int argc, char *argv[]) {
     			task_list.push_back(make_shared<TestMakeChildrenTask>( ));
 			}
 
-			if ( opt.xform_fname.length() > 0) {
+			// HSearch children are made as they are scored and only those that can pass the
+			//  next HSearchScaleToReslTask, or HSearchFinishTask at the end, are kept.
+			//  HackPackTask during HSearch needs them all. Stage 0 children are always
+			//  stored: there are only a few parents there (one per scaffold and seeding
+			//  position) and the work is split over parents, so it would run on one thread
+			bool const implicit_children = ! opt.hack_pack_during_hsearch;
+			auto hsearch_survivor_cut = [&]( int resl ) {
+				return resl < final_resl ? opt.global_score_cut : std::nextafter( 0.0f, 1.0f );
+			};
+			// the beam HSearchFilterSortTask keeps after each stage but the last, for -hsearch_bound_slack_scale
+			auto hsearch_beam_keep = [&]( int resl ) -> uint64_t {
+				return resl < final_resl ? opt.beam_size / opt.DIMPOW2 : 0;
+			};
+
+			if ( hsearch_shards && ! hsearch_shards->is_coordinator() ) {
+				// a worker only scores its share of each HSearch stage, the coordinator does the rest
+				task_list.push_back(make_shared<DiversifyBySeedingPositionsTask>());
+				task_list.push_back(make_shared<DiversifyByScaffoldsTask>());
+				task_list.push_back(make_shared<DiversifyByNestTask>( 0 ));
+				task_list.push_back(make_shared<HSearchInit>( ));
+				for ( int i = 0; i <= final_resl; i++ ) {
+					task_list.push_back(make_shared<HSearchScoreAtReslTask>( i, i, opt.tether_to_input_position_cut, hsearch_survivor_cut( i ), hsearch_beam_keep( i ) ));
+				}
+			} else if ( opt.xform_fname.length() > 0) {
 				create_rifine_task( task_list, rdd );
 			} else {
 				if ( opt.scaff_search_mode == "morph_dive_pop" ) {
@@ -1196,11 +1300,12 @@ int main(int argc, char *argv[]) {
 
 
 					task_list.push_back(make_shared<DiversifyBySeedingPositionsTask>()); // this is a no-op if there are no seeding positions
+					task_list.push_back(make_shared<DiversifyByScaffoldsTask>()); // this is a no-op unless scaffolds are batched
 					task_list.push_back(make_shared<DiversifyByNestTask>( 0 ));
 
 					task_list.push_back(make_shared<HSearchInit>( ));
 					for ( int i = 0; i <= final_resl; i++ ) {
-						task_list.push_back(make_shared<HSearchScoreAtReslTask>( i, i, opt.tether_to_input_position_cut ));
+						task_list.push_back(make_shared<HSearchScoreAtReslTask>( i, i, opt.tether_to_input_position_cut, hsearch_survivor_cut( i ), hsearch_beam_keep( i ) ));
 
 						if (opt.hack_pack_during_hsearch) {
 							task_list.push_back(make_shared<SortByScoreTask>( ));
@@ -1215,7 +1320,7 @@ int main(int argc, char *argv[]) {
 								                                                    opt.dump_prefix + "_" + test_data_cache->scafftag + boost::str(boost::format("_resl%i")%i) ));
 						}
 						if ( i < final_resl ) {
-							task_list.push_back(make_shared<HSearchScaleToReslTask>( i, i+1, opt.DIMPOW2, opt.global_score_cut )); 
+							task_list.push_back(make_shared<HSearchScaleToReslTask>( i, i+1, opt.DIMPOW2, opt.global_score_cut, implicit_children )); 
 						} 
 					}
 					task_list.push_back(make_shared<HSearchFinishTask>( opt.global_score_cut )); 
@@ -1279,6 +1384,15 @@ int main(int argc, char *argv[]) {
 
 			TaskProtocol protocol( task_list );
 
+			if ( opt.checkpoint_dir.size() ) {
+				// same command line and scaffold, same search
+				::scheme::util::ContentHash checkpoint_key;
+				for ( int iarg = 0; iarg < argc; iarg++ ) checkpoint_key.add( std::string( argv[iarg] ) );
+				checkpoint_key.add( scaff_fname );
+				checkpoint_key.add_pod( (int64_t)iscaff );
+				protocol.set_checkpoint( opt.checkpoint_dir + "/" + scafftag + "_" + devel::scheme::str( iscaff, 6 ) + ".checkpoint", checkpoint_key );
+			}
+
 
 			shared_ptr<std::vector<SearchPoint>> starting_point = make_shared<std::vector<SearchPoint>>( );
 			starting_point->push_back(SearchPoint(RifDockIndex()));
@@ -1311,9 +1425,15 @@ int main(int argc, char *argv[]) {
 			std::cout << "!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!" << std::endl;
 		}
 
+		if ( hsearch_shards && hsearch_shards->is_coordinator() ) {
+			// anything left of this scaffold, e.g. after an error mid stage, won't be read again
+			hsearch_shards_remove_scaffold( *hsearch_shards, iscaff, RESLS.size() );
+			hsearch_shards->publish( hsearch_shards_done_name( iscaff ), "" );
+		}
 
 	} // end scaffold loop
 
+	output_writer->wait();
 
 	dokout.close();
 
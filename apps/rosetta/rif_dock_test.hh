@@ -3,6 +3,7 @@
 #include <basic/options/option_macros.hh>
 #include <basic/options/keys/corrections.OptionKeys.gen.hh>
 #include <riflib/scaffold/nineA_util.hh>
+#include <limits>
 #include <vector>
 
 #ifdef GLOBAL_VARIABLES_ARE_BAD
@@ -29,6 +30,7 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 	OPT_1GRP_KEY(  Real        , rif_dock, target_rf_resl )
 	OPT_1GRP_KEY(  Integer     , rif_dock, target_rf_oversample )
 	OPT_1GRP_KEY(  String      , rif_dock, target_rf_cache )
+	OPT_1GRP_KEY(  String      , rif_dock, target_grid_storage )
 	OPT_1GRP_KEY(  String      , rif_dock, target_donors )
 	OPT_1GRP_KEY(  String      , rif_dock, target_acceptors )
 	OPT_1GRP_KEY(  Boolean     , rif_dock, only_load_highest_resl )
@@ -40,6 +42,18 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 
 	OPT_1GRP_KEY(  Real        , rif_dock, beam_size_M )
     OPT_1GRP_KEY(  Real        , rif_dock, max_beam_multiplier )
+    OPT_1GRP_KEY(  Integer     , rif_dock, hsearch_numa_groups )
+    OPT_1GRP_KEY(  Integer     , rif_dock, scaffold_prefetch )
+    OPT_1GRP_KEY(  Integer     , rif_dock, n_output_threads )
+    OPT_1GRP_KEY(  String      , rif_dock, checkpoint_dir )
+    OPT_1GRP_KEY(  Integer     , rif_dock, hsearch_n_shards )
+    OPT_1GRP_KEY(  Integer     , rif_dock, hsearch_shard )
+    OPT_1GRP_KEY(  String      , rif_dock, hsearch_shard_dir )
+    OPT_1GRP_KEY(  Real        , rif_dock, hsearch_shard_timeout )
+    OPT_1GRP_KEY(  Real        , rif_dock, hsearch_bound_slack_scale )
+    OPT_1GRP_KEY(  Integer     , rif_dock, hsearch_bound_calibration )
+    OPT_1GRP_KEY(  Integer     , rif_dock, scene_rotation_cache_size )
+    OPT_1GRP_KEY(  Integer     , rif_dock, scaffold_batch_size )
     OPT_1GRP_KEY(  Boolean     , rif_dock, multiply_beam_by_seeding_positions )
     OPT_1GRP_KEY(  Boolean     , rif_dock, multiply_beam_by_scaffolds )
 	OPT_1GRP_KEY(  Real        , rif_dock, search_diameter )
@@ -75,6 +89,9 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 	OPT_1GRP_KEY(  Real        , rif_dock, hack_pack_frac )
 	OPT_1GRP_KEY(  Real        , rif_dock, pack_iter_mult )
 	OPT_1GRP_KEY(  Integer     , rif_dock, pack_n_iters )
+	OPT_1GRP_KEY(  String      , rif_dock, hackpack_packer )
+	OPT_1GRP_KEY(  Real        , rif_dock, hackpack_exact_max_cost )
+	OPT_1GRP_KEY(  Real        , rif_dock, hackpack_exact_max_table )
 	OPT_1GRP_KEY(  Real        , rif_dock, hbond_weight )
     OPT_1GRP_KEY(  Real        , rif_dock, scaff_bb_hbond_weight )
     OPT_1GRP_KEY(  Boolean     , rif_dock, dump_scaff_bb_hbond_rays )
@@ -98,6 +115,7 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 	OPT_1GRP_KEY(  Real        , rif_dock, bonus_to_native_scaffold_res )
 	OPT_1GRP_KEY(  Boolean     , rif_dock, add_native_scaffold_rots_when_packing )
     OPT_1GRP_KEY(  Real        , rif_dock, ignore_rifres_if_worse_than )
+    OPT_1GRP_KEY(  Integer     , rif_dock, bound_only_rif_resls )
 
 	OPT_1GRP_KEY(  Boolean     , rif_dock, dump_all_rif_rots )
 	OPT_1GRP_KEY(  Boolean     , rif_dock, dump_all_rif_rots_into_output )
@@ -116,6 +134,7 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 	OPT_1GRP_KEY(  String      , rif_dock, score_this_pdb )
 	OPT_1GRP_KEY(  String      , rif_dock, dump_pdb_at_bin_center )
     OPT_1GRP_KEY(  Boolean     , rif_dock, test_hackpack )
+    OPT_1GRP_KEY(  Integer     , rif_dock, benchmark_rotamer_scoring )
     OPT_1GRP_KEY(  Boolean     , rif_dock, only_score_input_pos )
 
 	OPT_1GRP_KEY(  String     , rif_dock, dokfile )
@@ -128,6 +147,7 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 	OPT_1GRP_KEY(  Boolean    , rif_dock, pdb_info_pikaa )
 
 	OPT_1GRP_KEY(  Boolean    , rif_dock, cache_scaffold_data )
+	OPT_1GRP_KEY(  String     , rif_dock, scaffold_cache_format )
 
 	OPT_1GRP_KEY(  Real        , rif_dock, tether_to_input_position )
 
@@ -293,6 +313,7 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
             NEW_OPT(  rif_dock::rotboltz_ignore_missing_rots, "Ignore mismatches in the number of rotamers. Missing rotamers get score of 0", false );
 
 			NEW_OPT(  rif_dock::target_rf_cache, "" , "NO_CACHE_SPECIFIED_ON_COMMAND_LINE" );
+			NEW_OPT(  rif_dock::target_grid_storage, "float, fp16 or int8. fp16/int8 convert the target bounding grids after loading, 2x/4x less memory" , "float" );
 			NEW_OPT(  rif_dock::target_donors, "", "" );
 			NEW_OPT(  rif_dock::target_acceptors, "", "" );
 			NEW_OPT(  rif_dock::only_load_highest_resl, "Only read in the highest resolution rif", false );
@@ -304,6 +325,18 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 			NEW_OPT(  rif_dock::beam_size_M, "" , 10.000000 );
 
 			NEW_OPT(  rif_dock::max_beam_multiplier, "Maximum beam multiplier", 1 );
+			NEW_OPT(  rif_dock::scaffold_prefetch, "Prepare up to this many scaffolds ahead (loading, 1-body and 2-body tables) in a background thread while docking. 0 prepares each one when it is docked", 0 );
+			NEW_OPT(  rif_dock::n_output_threads, "Write output pdbs, resfiles and rif rots on this many background threads while docking continues. 0 writes them as they are made", 2 );
+			NEW_OPT(  rif_dock::checkpoint_dir, "Save the search state after each stage of the protocol to a file per scaffold here. A rerun with the same command line resumes each scaffold after its last saved stage. Empty for no checkpoints", "" );
+			NEW_OPT(  rif_dock::hsearch_n_shards, "Split the scoring of each HSearch stage across this many rif_dock_test processes, started with the same flags and -hsearch_shard 0 to n-1", 1 );
+			NEW_OPT(  rif_dock::hsearch_shard, "Which process of -hsearch_n_shards this is. 0 coordinates the search and does everything after it, the others only score their share of the HSearch stages", 0 );
+			NEW_OPT(  rif_dock::hsearch_shard_dir, "Directory all processes of -hsearch_n_shards can see, for passing points and scores. Must be empty when the coordinator starts", "" );
+			NEW_OPT(  rif_dock::hsearch_shard_timeout, "Seconds the -hsearch_shard 0 coordinator waits for the scores of another shard before it gives up on the scaffold", 3600 );
+			NEW_OPT(  rif_dock::hsearch_bound_slack_scale, "Skip HSearch parents whose children can't make the beam. Children are assumed no better than their parent by this times the largest gain seen so far. 0 is off, larger is safer. Ignored with -hack_pack_during_hsearch", 0 );
+			NEW_OPT(  rif_dock::hsearch_bound_calibration, "Parents to expand at each HSearch stage before -hsearch_bound_slack_scale skips any", 1000 );
+			NEW_OPT(  rif_dock::scene_rotation_cache_size, "Scaffold orientations each thread keeps the rotated backbone actors of, so samples that only differ in translation don't rotate them again. 0 is off", 16 );
+			NEW_OPT(  rif_dock::scaffold_batch_size, "Dock this many scaffolds at once in a single HSearch that shares one beam. Use with -multiply_beam_by_scaffolds and -max_beam_multiplier to size the beam", 1 );
+			NEW_OPT(  rif_dock::hsearch_numa_groups, "Thread groups for hsearch work stealing, threads steal within their group first. 0 means one per NUMA node. Use with OMP_PROC_BIND=close", 0 );
 			NEW_OPT(  rif_dock::multiply_beam_by_seeding_positions, "Multiply beam size by number of seeding positions", false);
 			NEW_OPT(  rif_dock::multiply_beam_by_scaffolds, "Multiply beam size by number of scaffolds", true);
 			NEW_OPT(  rif_dock::max_rf_bounding_ratio, "" , 4 );
@@ -329,6 +362,9 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 			NEW_OPT(  rif_dock::hack_pack_frac, "" , 0.2 );
 			NEW_OPT(  rif_dock::pack_iter_mult, "" , 2.0 );
 			NEW_OPT(  rif_dock::pack_n_iters, "" , 1 );
+			NEW_OPT(  rif_dock::hackpack_packer, "anneal, exact (DEE + dynamic programming), or auto: exact when the estimated cost is below hackpack_exact_max_cost", "auto" );
+			NEW_OPT(  rif_dock::hackpack_exact_max_cost, "max table work for the exact packer in auto mode" , 2e6 );
+			NEW_OPT(  rif_dock::hackpack_exact_max_table, "max entries in any one exact packer table, larger problems are annealed even with hackpack_packer exact" , 1e7 );
 			NEW_OPT(  rif_dock::hbond_weight, "" , 2.0 );
             NEW_OPT(  rif_dock::scaff_bb_hbond_weight, "" , 0.0 );
             NEW_OPT(  rif_dock::dump_scaff_bb_hbond_rays, "Dump scaffold backbone hydrogen bond rays", false );
@@ -355,6 +391,7 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 			NEW_OPT(  rif_dock::bonus_to_native_scaffold_res, "aka favor native CHEAT", -0.3 );
 			NEW_OPT(  rif_dock::add_native_scaffold_rots_when_packing, "CHEAT", false );
             NEW_OPT(  rif_dock::ignore_rifres_if_worse_than, "Don't use bad rif residues", 0 );
+            NEW_OPT(  rif_dock::bound_only_rif_resls, "Score this many of the lowest resolution rifs with a compact copy holding only the best score of each cell, plus the best onebody of the residue, an optimistic bound. Not used with burial, unsats, sat groups or requirements. Packing still uses the full rif", 0 );
 
 			NEW_OPT(  rif_dock::dump_all_rif_rots, "", false );
 			NEW_OPT(  rif_dock::dump_all_rif_rots_into_output, "dump all rif rots into output", false);
@@ -373,6 +410,7 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 			NEW_OPT(  rif_dock::score_this_pdb, "Score every residue of this pdb using the rif scoring machinery", "" );
 			NEW_OPT(  rif_dock::dump_pdb_at_bin_center, "Dump each residue of this pdb at the rotamer's bin center", "" );
             NEW_OPT(  rif_dock::test_hackpack, "Test the packing objective in the original position too", false );
+            NEW_OPT(  rif_dock::benchmark_rotamer_scoring, "Time this many rotamer vs target scores at random positions near the target hbonders, with and without the donor/acceptor cache, before docking", 0 );
             NEW_OPT(  rif_dock::only_score_input_pos, "Dont' actually run the protocol, just score the input", false );
 
 			NEW_OPT(  rif_dock::dokfile, "", "default.dok" );
@@ -385,6 +423,7 @@ OPT_1GRP_KEY(     StringVector , rif_dock, scaffolds )
 			NEW_OPT(  rif_dock::pdb_info_pikaa, "", false );
 
 			NEW_OPT(  rif_dock::cache_scaffold_data, "", false );
+			NEW_OPT(  rif_dock::scaffold_cache_format, "Format of the -cache_scaffold_data files. flat: uncompressed, named by a hash of the scaffold coordinates, rotamers and scoring options, safe to share between concurrent jobs. gz: the old .bin.gz files named by scaffold tag", "flat" );
 
 			NEW_OPT(  rif_dock::tether_to_input_position, "", -1.0 );
 
@@ -541,6 +580,18 @@ struct RifDockOpt
 	int64_t     DIMPOW2                              ;
 	int64_t     beam_size                            ;
     float       max_beam_multiplier                  ;
+    int         hsearch_numa_groups                  ;
+    int         scaffold_prefetch                    ;
+    int         n_output_threads                     ;
+    std::string checkpoint_dir                       ;
+    int         hsearch_n_shards                     ;
+    int         hsearch_shard                        ;
+    std::string hsearch_shard_dir                    ;
+    float       hsearch_shard_timeout                ;
+    float       hsearch_bound_slack_scale            ;
+    int         hsearch_bound_calibration            ;
+    int         scene_rotation_cache_size            ;
+    int         scaffold_batch_size                  ;
     bool        multiply_beam_by_seeding_positions   ;
     bool        multiply_beam_by_scaffolds           ;
 	bool        replace_all_with_ala_1bre            ;
@@ -568,9 +619,11 @@ struct RifDockOpt
 	std::string score_this_pdb                       ;
 	std::string dump_pdb_at_bin_center               ;
     bool        test_hackpack                        ;  
+    int         benchmark_rotamer_scoring            ;
     bool        only_score_input_pos                 ;
 	bool        add_native_scaffold_rots_when_packing;
     float       ignore_rifres_if_worse_than          ;
+    int         bound_only_rif_resls                 ;
 	bool        restrict_to_native_scaffold_res      ;
 	float       bonus_to_native_scaffold_res         ;
 	float       hack_pack_frac                       ;
@@ -605,6 +658,7 @@ struct RifDockOpt
 	int         target_rf_oversample                 ;
 	float       max_rf_bounding_ratio                ;
 	std::string target_rf_cache                      ;
+	std::string target_grid_storage                  ;
 	std::string target_donors                        ;
 	std::string target_acceptors                     ;
 	bool        only_load_highest_resl               ;
@@ -621,6 +675,7 @@ struct RifDockOpt
 	bool        random_perturb_scaffold              ;
 	bool        dont_use_scaffold_loops              ;
 	bool        cache_scaffold_data                  ;
+	std::string scaffold_cache_format                ;
 	float       rf_resl                              ;
 	bool        hack_pack                            ;
 	bool        hack_pack_during_hsearch             ;
@@ -634,6 +689,9 @@ struct RifDockOpt
 
 	float       pack_iter_mult                       ;
 	int         pack_n_iters                         ;
+	std::string hackpack_packer                      ;
+	float       hackpack_exact_max_cost              ;
+	float       hackpack_exact_max_table             ;
 	float       hbond_weight                         ;
     float       scaff_bb_hbond_weight                ;
     bool        dump_scaff_bb_hbond_rays             ;
@@ -788,6 +846,18 @@ struct RifDockOpt
 		DIMPOW2                                = 1<<DIM;
 		beam_size                              = int64_t( option[rif_dock::beam_size_M]() * 1000000.0 / DIMPOW2 ) * DIMPOW2;
         max_beam_multiplier                    = option[rif_dock::max_beam_multiplier                ]();
+        hsearch_numa_groups                    = option[rif_dock::hsearch_numa_groups                ]();
+        scaffold_prefetch                      = option[rif_dock::scaffold_prefetch                  ]();
+        n_output_threads                       = option[rif_dock::n_output_threads                   ]();
+        checkpoint_dir                         = option[rif_dock::checkpoint_dir                     ]();
+        hsearch_n_shards                       = option[rif_dock::hsearch_n_shards                   ]();
+        hsearch_shard                          = option[rif_dock::hsearch_shard                      ]();
+        hsearch_shard_dir                      = option[rif_dock::hsearch_shard_dir                  ]();
+        hsearch_shard_timeout                  = option[rif_dock::hsearch_shard_timeout              ]();
+        hsearch_bound_slack_scale              = option[rif_dock::hsearch_bound_slack_scale          ]();
+        hsearch_bound_calibration              = option[rif_dock::hsearch_bound_calibration          ]();
+        scene_rotation_cache_size              = option[rif_dock::scene_rotation_cache_size          ]();
+        scaffold_batch_size                    = option[rif_dock::scaffold_batch_size                ]();
 		multiply_beam_by_seeding_positions     = option[rif_dock::multiply_beam_by_seeding_positions ]();
 		multiply_beam_by_scaffolds             = option[rif_dock::multiply_beam_by_scaffolds         ]();        
 		replace_all_with_ala_1bre              = option[rif_dock::replace_all_with_ala_1bre          ]();
@@ -814,9 +884,11 @@ struct RifDockOpt
 		score_this_pdb                         = option[rif_dock::score_this_pdb                     ]();
 		dump_pdb_at_bin_center                 = option[rif_dock::dump_pdb_at_bin_center             ]();
         test_hackpack                          = option[rif_dock::test_hackpack                      ]();  
+        benchmark_rotamer_scoring              = option[rif_dock::benchmark_rotamer_scoring          ]();
         only_score_input_pos                   = option[rif_dock::only_score_input_pos               ]();
 		add_native_scaffold_rots_when_packing  = option[rif_dock::add_native_scaffold_rots_when_packing ]();
         ignore_rifres_if_worse_than            = option[rif_dock::ignore_rifres_if_worse_than           ]();
+        bound_only_rif_resls                   = option[rif_dock::bound_only_rif_resls                  ]();
 		restrict_to_native_scaffold_res        = option[rif_dock::restrict_to_native_scaffold_res       ]();
 		bonus_to_native_scaffold_res           = option[rif_dock::bonus_to_native_scaffold_res          ]();
 		hack_pack_frac                         = option[rif_dock::hack_pack_frac                        ]();
@@ -850,6 +922,7 @@ struct RifDockOpt
 		target_rf_oversample                   = option[rif_dock::target_rf_oversample                  ]();
 		max_rf_bounding_ratio                  = option[rif_dock::max_rf_bounding_ratio                 ]();
 		target_rf_cache                        = option[rif_dock::target_rf_cache                       ]();
+		target_grid_storage                    = option[rif_dock::target_grid_storage                   ]();
 		target_donors                          = option[rif_dock::target_donors                         ]();
 		target_acceptors                       = option[rif_dock::target_acceptors                      ]();		
 		only_load_highest_resl                 = option[rif_dock::only_load_highest_resl                ]();
@@ -865,6 +938,7 @@ struct RifDockOpt
 		random_perturb_scaffold                = option[rif_dock::random_perturb_scaffold               ]();
 		dont_use_scaffold_loops                = option[rif_dock::dont_use_scaffold_loops               ]();
 		cache_scaffold_data                    = option[rif_dock::cache_scaffold_data                   ]();
+		scaffold_cache_format                  = option[rif_dock::scaffold_cache_format                 ]();
 		rf_resl                                = option[rif_dock::rf_resl                               ]();
 		hack_pack                              = option[rif_dock::hack_pack                             ]();
 		hack_pack_during_hsearch               = option[rif_dock::hack_pack_during_hsearch              ]();
@@ -880,6 +954,9 @@ struct RifDockOpt
 		rotrf_scale_atr                        = option[rif_dock::rotrf_scale_atr                       ]();
 		pack_iter_mult                         = option[rif_dock::pack_iter_mult                        ]();
 		pack_n_iters                           = option[rif_dock::pack_n_iters                          ]();
+		hackpack_packer                        = option[rif_dock::hackpack_packer                       ]();
+		hackpack_exact_max_cost                = option[rif_dock::hackpack_exact_max_cost               ]();
+		hackpack_exact_max_table               = option[rif_dock::hackpack_exact_max_table              ]();
 		hbond_weight                           = option[rif_dock::hbond_weight                          ]();
         scaff_bb_hbond_weight                  = option[rif_dock::scaff_bb_hbond_weight                 ]();
         dump_scaff_bb_hbond_rays               = option[rif_dock::dump_scaff_bb_hbond_rays              ]();
@@ -1081,6 +1158,43 @@ struct RifDockOpt
 
         for( std::string s : option[rif_dock::rotamer_boltzmann_files ]() ) rotamer_boltzmann_fnames.push_back(s);
 
+        if ( scaffold_cache_format != "flat" && scaffold_cache_format != "gz" ) {
+        	std::cout << "ERROR: -scaffold_cache_format must be flat or gz, not " << scaffold_cache_format << std::endl;
+        	std::exit(-1);
+        }
+
+        if ( scaffold_batch_size > 1 ) {
+        	if ( scaff_search_mode != "default" ) {
+        		std::cout << "ERROR: -scaffold_batch_size only works with -scaff_search_mode default." << std::endl;
+        		std::exit(-1);
+        	}
+        	if ( seeding_fnames.size() > 0 || seed_with_these_pdbs.size() > 0 || xform_fname.length() > 0 ) {
+        		std::cout << "ERROR: -scaffold_batch_size can't be used with seeding positions or xform files." << std::endl;
+        		std::exit(-1);
+        	}
+        	if ( scaffold_batch_size > std::numeric_limits<uint16_t>::max() ) {
+        		std::cout << "ERROR: -scaffold_batch_size can be at most " << std::numeric_limits<uint16_t>::max() << std::endl;
+        		std::exit(-1);
+        	}
+        }
+
+        if ( hsearch_n_shards > 1 ) {
+        	if ( hsearch_shard < 0 || hsearch_shard >= hsearch_n_shards ) {
+        		std::cout << "ERROR: -hsearch_shard must be from 0 to -hsearch_n_shards - 1." << std::endl;
+        		std::exit(-1);
+        	}
+        	if ( hsearch_shard_dir.length() == 0 ) {
+        		std::cout << "ERROR: -hsearch_n_shards needs -hsearch_shard_dir." << std::endl;
+        		std::exit(-1);
+        	}
+        	if ( scaff_search_mode != "default" || xform_fname.length() > 0 ) {
+        		std::cout << "ERROR: -hsearch_n_shards only works with -scaff_search_mode default and no xform files." << std::endl;
+        		std::exit(-1);
+        	}
+        	// workers write no results, but keep them from truncating the coordinator's dok file
+        	if ( hsearch_shard > 0 ) dokfile_fname += "_shard" + std::to_string( hsearch_shard );
+        }
+
         patchdock_min_sasa                      = option[rif_dock::patchdock_min_sasa                  ]();
         patchdock_top_ranks                     = option[rif_dock::patchdock_top_ranks                 ]();
         
@@ -0,0 +1,89 @@
+// -*- mode:c++;tab-width:2;indent-tabs-mode:t;show-trailing-whitespace:t;rm-trailing-spaces:t -*-
+// vi: set ts=2 noet:
+//
+// (c) Copyright Rosetta Commons Member Institutions.
+// (c) This file is part of the Rosetta software suite and is made available under license.
+// (c) The Rosetta software is developed by the contributing members of the Rosetta Commons.
+// (c) For more information, see http://wsic_dockosettacommons.org. Questions about this casic_dock
+// (c) addressed to University of Waprotocolsgton UW TechTransfer, email: license@u.washington.eprotocols
+
+// converts .rif.gz / .xmap.gz files into the flat format that rif_dock_test
+// mmaps instead of loading, so many jobs on a node share one copy of the rif
+
+#include <basic/options/option_macros.hh>
+#include <devel/init.hh>
+
+#include <utility/file/file_sys_util.hh>
+
+#include <riflib/RifFactory.hh>
+#include <riflib/util.hh>
+
+#include <cstdio>
+#include <fstream>
+
+
+using std::cout;
+using std::endl;
+using devel::scheme::KMGT;
+
+
+OPT_1GRP_KEY( StringVector, rif_to_flat, rif_files )
+	OPT_1GRP_KEY( String      , rif_to_flat, outdir    )
+
+	void REGISTER_OPTIONS() {
+		using namespace basic::options;
+		using namespace basic::options::OptionKeys;
+		NEW_OPT( rif_to_flat::rif_files, "rif or bounding xmap files to convert", utility::vector1<std::string>() );
+		NEW_OPT( rif_to_flat::outdir   , "output dir, default is next to the input file", "" );
+	}
+
+// foo.rif.gz -> foo.rif.flat, foo_BOUNDING_RIF_16.xmap.gz -> foo_BOUNDING_RIF_16.xmap.flat
+std::string
+flat_fname( std::string fname, std::string const & outdir )
+{
+	if( fname.size() > 3 && fname.substr(fname.size()-3) == ".gz" ) fname = fname.substr(0,fname.size()-3);
+	if( outdir.size() ){
+		size_t slash = fname.find_last_of('/');
+		if( slash != std::string::npos ) fname = fname.substr(slash+1);
+		fname = outdir + "/" + fname;
+	}
+	return fname + ".flat";
+}
+
+int main(int argc, char *argv[])
+{
+	using namespace basic::options;
+	using namespace ::devel::scheme;
+	namespace ropt = basic::options::OptionKeys::rif_to_flat;
+
+	REGISTER_OPTIONS();
+	devel::init(argc,argv);
+
+	for( std::string const & fname : option[ropt::rif_files]() ){
+		runtime_assert_msg( utility::file::file_exists( fname ), "missing rif file: " + fname );
+		if( is_flat_rif_file( fname ) ){
+			cout << "already flat: " << fname << endl;
+			continue;
+		}
+		std::string rif_type = get_rif_type_from_file( fname );
+		RifFactoryConfig rif_factory_config;
+		rif_factory_config.rif_type = rif_type;
+		shared_ptr<RifFactory> rif_factory = create_rif_factory( rif_factory_config );
+
+		std::string description;
+		RifPtr rif = rif_factory->create_rif_from_file( fname, description );
+		runtime_assert_msg( rif, "rif creation from file failed! " + fname );
+
+		std::string outfile = flat_fname( fname, option[ropt::outdir]() );
+		cout << "converting " << fname << " (" << rif_type << ", " << KMGT( rif->size() ) << " cells) to " << outfile << endl;
+
+		// write to a temp name and rename so readers never see a partial table
+		std::string tmpfile = outfile + ".tmp";
+		std::ofstream out( tmpfile, std::ios::binary );
+		runtime_assert_msg( rif->save_flat( out, description ), "save_flat failed: " + outfile );
+		out.close();
+		runtime_assert_msg( std::rename( tmpfile.c_str(), outfile.c_str() ) == 0, "rename failed: " + outfile );
+	}
+
+	return 0;
+}
@@ -98,6 +98,7 @@ OPT_1GRP_KEY( StringVector, rifgen, donres )
 	OPT_1GRP_KEY( Real          , rifgen, hbond_cart_sample_hack_range )
 	OPT_1GRP_KEY( Real          , rifgen, hbond_cart_sample_hack_resl )
 	OPT_1GRP_KEY( Integer       , rifgen, rif_accum_scratch_size_M )
+	OPT_1GRP_KEY( String        , rifgen, rif_accum_spill_dir )
 	OPT_1GRP_KEY( Boolean       , rifgen, make_shitty_rpm_file )
 	OPT_1GRP_KEY( Boolean       , rifgen, test_without_rosetta_fields )
 	OPT_1GRP_KEY( Boolean       , rifgen, downweight_hydrophobics )
@@ -176,6 +177,7 @@ OPT_1GRP_KEY( StringVector, rifgen, donres )
 		NEW_OPT(  rifgen::hbond_cart_sample_hack_range     , "" , 0.375 );
 		NEW_OPT(  rifgen::hbond_cart_sample_hack_resl      , "" , 0.375 );
 		NEW_OPT(  rifgen::rif_accum_scratch_size_M         , "" , 32000 );
+		NEW_OPT(  rifgen::rif_accum_spill_dir              , "if set, partial rifs are written here as sorted runs and merged at the end, so the rif and the scratch maps are never in memory together" , "" );
 		NEW_OPT(  rifgen::make_shitty_rpm_file             , "" , false );
 		NEW_OPT(  rifgen::test_without_rosetta_fields      , "" , false );
 		NEW_OPT(  rifgen::downweight_hydrophobics          , "" , false );
@@ -246,7 +248,8 @@ make_bounding_grids(
 	::devel::scheme::RifPtr ref_rif,
 	std::string ref_description,
 	std::string fname_base,
-	int ibound
+	int ibound,
+	::devel::scheme::RifPtr new_rif = nullptr // already filled from ref_rif, see RifAccumulator::merge_spill_runs
 ){
 	std::string fname;
 
@@ -269,7 +272,7 @@ make_bounding_grids(
 		double const  ang_bound_rad = lever_bound / lever_radius;
 		double const  ang_bound = ang_bound_rad * 180.0 / M_PI;
 
-		RifPtr new_rif = rif_factory->create_rif_from_rif( ref_rif, hash_cart_resl, hash_ang_resl, hash_cart_bound );
+		if( ! new_rif ) new_rif = rif_factory->create_rif_from_rif( ref_rif, hash_cart_resl, hash_ang_resl, hash_cart_bound );
 
 		#pragma omp critical
 		{
@@ -680,11 +683,20 @@ int main(int argc, char *argv[]) {
 	// 	512.0f,
 	// 	option[rifgen::rif_accum_scratch_size_M]()
 	// );
+	std::string spill_prefix = "";
+	if( option[rifgen::rif_accum_spill_dir]().size() ){
+		if( option[rifgen::test_hotspot_redundancy]() || option[rifgen::report_aa_count]() ){
+			utility_exit_with_message( "-rifgen:rif_accum_spill_dir can't be used with -rifgen:test_hotspot_redundancy or -rifgen:report_aa_count, they need the whole rif in memory" );
+		}
+		makedircheck( option[rifgen::rif_accum_spill_dir]() );
+		spill_prefix = option[rifgen::rif_accum_spill_dir]() + "/" + utility::file_basename( outfile );
+	}
 	shared_ptr< rif::RifAccumulator > rif_accum = rif_factory->create_rif_accumulator(
 		option[rifgen::hash_cart_resl](),
 		option[rifgen::hash_angle_resl](),
 		512.0f,
-		option[rifgen::rif_accum_scratch_size_M]()
+		option[rifgen::rif_accum_scratch_size_M](),
+		spill_prefix
 	);
 
 
@@ -801,6 +813,22 @@ int main(int argc, char *argv[]) {
 		// N_motifs_found += rif_accum->total_samples();
 		std::cout << "RIFAccumulator building rif...." << std::endl;
 		rif_accum->condense();
+		// when spilling, the coarse bounding rifs are filled by the same pass over the spilled runs
+		std::vector< RifPtr > bounding_rifs( option[rifgen::lever_bounds]().size()+1, nullptr );
+		if( spill_prefix.size() ){
+			std::vector< RifPtr > coarse_rifs;
+			if( option[rifgen::outfile].user() ){
+				for( int ibound = 1; ibound <= option[rifgen::lever_bounds]().size(); ++ibound ){
+					bounding_rifs[ibound] = rif_factory->create_rif(
+						option[rifgen::hash_cart_resls  ]().at( ibound ),
+						option[rifgen::hash_ang_resls   ]().at( ibound ),
+						option[rifgen::hash_cart_bounds ]().at( ibound ) );
+					coarse_rifs.push_back( bounding_rifs[ibound] );
+				}
+			}
+			std::cout << "RIFAccumulator merging spilled runs...." << std::endl;
+			rif_accum->merge_spill_runs( coarse_rifs );
+		}
 		rif = rif_accum->rif();
 		// rif->set_xmap_ptr( rif_accum.rif_ );
 		rif_accum->clear();
@@ -884,7 +912,7 @@ int main(int argc, char *argv[]) {
 					rif->save( out, description );
 					out.close();
 				} else {
-					std::string bgfn = make_bounding_grids( rif_factory, rif, description, fname, ibound );
+					std::string bgfn = make_bounding_grids( rif_factory, rif, description, fname, ibound, bounding_rifs[ibound] );
 					#ifdef USE_OPENMP
 					#pragma omp critical
 					#endif
@@ -0,0 +1,137 @@
+// -*- mode:c++;tab-width:2;indent-tabs-mode:t;show-trailing-whitespace:t;rm-trailing-spaces:t -*-
+// vi: set ts=2 noet:
+//
+// (c) Copyright Rosetta Commons Member Institutions.
+// (c) This file is part of the Rosetta software suite and is made available under license.
+// (c) The Rosetta software is developed by the contributing members of the Rosetta Commons.
+// (c) For more information, see http://www.rosettacommons.org. Questions about this can be
+// (c) addressed to University of Washington UW TechTransfer, email: license@u.washington.edu.
+
+
+
+#ifndef INCLUDED_riflib_OutputWriter_hh
+#define INCLUDED_riflib_OutputWriter_hh
+
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+
+namespace devel {
+namespace scheme {
+
+// Writes output files on background threads.
+//
+// The main thread builds each output (the pose with its labels, the text
+//  that goes with it) and hands over a job that writes it. A pool of
+//  writer threads runs the jobs, formatting and gzipping each file with its
+//  own ozstream, while the main thread moves on to the next result and the
+//  next scaffold. At most max_queued jobs wait at once, submit() blocks
+//  beyond that, which bounds the memory held by outputs in flight.
+//
+// With no threads, submit() runs the job right away. Jobs must not touch
+//  anything the main thread may change, so they get copies of what they write.
+//
+// A job that throws is logged under its name and skipped. Rethrowing it
+//  later would abort whichever scaffold happened to submit next.
+
+struct OutputWriter {
+
+    typedef std::function<void()> Job;
+
+    OutputWriter( int n_threads, int max_queued )
+      : max_queued_( max_queued > 0 ? max_queued : 1 ),
+        running_( 0 ),
+        stop_( false )
+    {
+        for ( int i = 0; i < n_threads; i++ ) workers_.emplace_back( [this](){ run(); } );
+    }
+
+    ~OutputWriter() {
+        {
+            std::lock_guard<std::mutex> guard( mutex_ );
+            stop_ = true;
+        }
+        cond_.notify_all();
+        for ( std::thread & worker : workers_ ) worker.join();
+    }
+
+    void
+    submit( Job job, std::string const & name ) {
+        if ( workers_.empty() ) {
+            run_job( job, name );
+            return;
+        }
+        std::unique_lock<std::mutex> lock( mutex_ );
+        cond_.wait( lock, [&](){ return jobs_.size() < max_queued_; } );
+        jobs_.emplace_back( job, name );
+        lock.unlock();
+        cond_.notify_all();
+    }
+
+    // Blocks until every submitted job has finished
+    void
+    wait() {
+        std::unique_lock<std::mutex> lock( mutex_ );
+        cond_.wait( lock, [&](){ return jobs_.empty() && running_ == 0; } );
+    }
+
+private:
+
+    static void
+    run_job( Job const & job, std::string const & name ) {
+        try {
+            job();
+        } catch ( std::exception const & ex ) {
+            std::cout << "error writing " << name << " (skipped):\n" << ex.what() << std::endl;
+        } catch ( ... ) {
+            std::cout << "unknown error writing " << name << " (skipped)" << std::endl;
+        }
+    }
+
+    void
+    run() {
+        while ( true ) {
+            std::pair<Job,std::string> job;
+            {
+                std::unique_lock<std::mutex> lock( mutex_ );
+                cond_.wait( lock, [&](){ return stop_ || ! jobs_.empty(); } );
+                if ( jobs_.empty() ) return;
+                job = jobs_.front();
+                jobs_.pop_front();
+                running_++;
+            }
+            cond_.notify_all();
+            run_job( job.first, job.second );
+            {
+                std::lock_guard<std::mutex> guard( mutex_ );
+                running_--;
+            }
+            cond_.notify_all();
+        }
+    }
+
+    size_t max_queued_;
+    std::vector<std::thread> workers_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque< std::pair<Job,std::string> > jobs_;
+    int running_;
+    bool stop_;
+};
+
+
+}}
+
+
+
+#endif
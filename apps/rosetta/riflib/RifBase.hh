@@ -97,6 +97,19 @@ struct RifBase
 	virtual bool load( std::istream & in , std::string & description ) = 0;
 	virtual bool save( std::ostream & out, std::string & description ) = 0;
 
+	// flat rifs are mmaped read-only, see XformMap::save_flat
+	virtual bool load_flat( std::string const & fname, std::string & description ) = 0;
+	virtual bool save_flat( std::ostream & out, std::string & description ) = 0;
+	virtual bool is_flat() const = 0;
+
+	// compact tier with only the best rotamer and score per cell, scored in
+	// place of the full rif when not packing, see XformMapBound
+	virtual bool build_bound_only() = 0;
+	virtual bool has_bound_only() const = 0;
+	virtual size_t bound_only_mem_use() const = 0;
+	virtual bool get_bound_only_const_ptr( boost::any * any_p ) const = 0;
+	template< class BMap > bool get_bound_only_const_ptr( shared_ptr<BMap const> & bmap_ptr ) const;
+
 	virtual void finalize_rif() = 0;
 
     virtual RifBaseKeyRange key_range() const = 0;
@@ -157,6 +170,16 @@ bool RifBase::get_xmap_const_ptr( shared_ptr<XMap const> & xmap_ptr ) const
 	}
 	return false;
 }
+template< class BMap >
+bool RifBase::get_bound_only_const_ptr( shared_ptr<BMap const> & bmap_ptr ) const
+{
+	boost::any any = static_cast< shared_ptr<BMap const> const>( bmap_ptr );
+	if( get_bound_only_const_ptr( &any ) ){
+		bmap_ptr = boost::any_cast< shared_ptr<BMap const> const>( any );
+		return true;
+	}
+	return false;
+}
 template< class XMap >
 bool RifBase::set_xmap_ptr( shared_ptr<XMap> const & xmap_ptr )
 {
@@ -24,6 +24,7 @@
 
 
 #include <scheme/objective/hash/XformMap.hh>
+#include <scheme/objective/hash/XformMapBound.hh>
 #include <scheme/objective/storage/RotamerScores.hh>
 
 #include <scheme/actor/Atom.hh>
@@ -68,7 +69,10 @@ struct XmapKeyIterHelper : public KeyIterHelperBase<typename RifBase::Key> {
 template< class XMap >
 class RifWrapper : public RifBase {
 
+	typedef ::scheme::objective::hash::XformMapBound<XMap> BoundMap;
+
 	shared_ptr<XMap> xmap_ptr_;
+	shared_ptr<BoundMap const> bound_ptr_;
 
 public:
 
@@ -95,6 +99,43 @@ public:
 		return xmap_ptr_->save( out, description );
 	}
 
+	virtual bool load_flat( std::string const & fname, std::string & description )
+	{
+		std::ifstream in( fname, std::ios::binary );
+		size_t s;
+		in.read((char*)&s,sizeof(size_t));
+		runtime_assert_msg( in.good() && s < 9999, "bad flat rif file: " + fname );
+		char buf[9999];
+		for(int i = 0; i < 9999; ++i) buf[i] = 0;
+		in.read(buf,s);
+		std::string type_in(buf);
+		runtime_assert_msg( type_in == type_, "mismatched rif_types, expected: '" + type_ + "' , got: '" + type_in + "'" );
+		size_t const offset = in.tellg();
+		in.close();
+		return xmap_ptr_->load_flat( fname, description, offset );
+	}
+	virtual bool save_flat( std::ostream & out, std::string & description ) {
+		size_t s = type_.size();
+		out.write((char*)&s,sizeof(size_t));
+		out.write(type_.c_str(),s);
+		return xmap_ptr_->save_flat( out, description );
+	}
+	bool is_flat() const override { return xmap_ptr_->is_flat(); }
+
+	bool build_bound_only() override {
+		shared_ptr<BoundMap> bound = make_shared<BoundMap>();
+		bound->init( *xmap_ptr_ );
+		bound_ptr_ = bound;
+		return true;
+	}
+	bool has_bound_only() const override { return bound_ptr_ != nullptr; }
+	size_t bound_only_mem_use() const override { return bound_ptr_ ? bound_ptr_->mem_use() : 0; }
+	bool get_bound_only_const_ptr( boost::any * any_p ) const override {
+		bool is_compatible_type = boost::any_cast< shared_ptr<BoundMap const> const>( any_p );
+		if( is_compatible_type && bound_ptr_ ) *any_p = bound_ptr_;
+		return is_compatible_type && bound_ptr_;
+	}
+
 	virtual bool get_xmap_ptr( boost::any * any_p )	{
 		bool is_compatible_type =     boost::any_cast< shared_ptr<XMap> const>( any_p );
 		if( is_compatible_type ) *any_p = static_cast< shared_ptr<XMap> const>( xmap_ptr_ );
@@ -142,7 +183,7 @@ public:
     }
 
 	size_t size() const override { return xmap_ptr_->size(); }
-	float load_factor() const override { return xmap_ptr_->map_.size()*1.f/xmap_ptr_->map_.bucket_count(); }
+	float load_factor() const override { return xmap_ptr_->size()*1.f/xmap_ptr_->bucket_count(); }
 	size_t mem_use()    const override { return xmap_ptr_->mem_use(); }
 	float cart_resl()   const override { return xmap_ptr_->cart_resl_; }
 	float ang_resl()    const override { return xmap_ptr_->ang_resl_; }
@@ -152,17 +193,15 @@ public:
 	// will resize to accomodate highest number rotamer
 	void get_rotamer_ids_in_use( std::vector<bool> & using_rot ) const override
 	{
-		typedef typename XMap::Map::value_type MapPair;
-		typedef typename MapPair::second_type RotScores;
-		for( auto const & v : xmap_ptr_->map_ ){
-			RotScores const & xmrot( v.second );
+		typedef typename XMap::Value RotScores;
+		xmap_ptr_->for_each_entry( [&]( Key, RotScores const & xmrot ){
 			for( int i = 0; i < RotScores::N; ++i ){
 				if( xmrot.empty(i) ) break;
 				if( xmrot.rotamer(i) >= using_rot.size() ) using_rot.resize( xmrot.rotamer(i)+1 , false );
 
 				using_rot[ xmrot.rotamer(i) ] = true;
 			}
-		}
+		});
 
 	}
 
@@ -193,6 +232,7 @@ public:
 	}
 
 	void finalize_rif() override {
+		runtime_assert_msg( !xmap_ptr_->is_flat(), "finalize_rif: flat rifs are read-only" );
 		// sort the rotamers in each cell so best scoring is first
 		__gnu_parallel::for_each( xmap_ptr_->map_.begin(), xmap_ptr_->map_.end(), call_sort_rotamers<typename XMap::Map::value_type> );
 	}
@@ -208,17 +248,17 @@ public:
 		double  rif_avg_scores      [ XMapVal::N ];
 		int64_t rif_avg_scores_count[ XMapVal::N ];
 		for( int i = 0; i < XMapVal::N; ++i ){ rif_num_collisions[i]=0; rif_avg_scores[i]=0; rif_avg_scores_count[i]=0; }
-		for( auto const & v : xmap_ptr_->map_ ){
+		xmap_ptr_->for_each_entry( [&]( Key, XMapVal const & val ){
 			for( int i = 0; i < XMapVal::N; ++i ){
-				bool not_empty = !v.second.rotscores_[i].empty();
+				bool not_empty = !val.rotscores_[i].empty();
 				if( not_empty ){
 					rif_num_collisions[i] += 1;
-					rif_avg_scores[i] += v.second.rotscores_[i].score();
+					rif_avg_scores[i] += val.rotscores_[i].score();
 					// std::out << v.second.rotscores_[i].score() << std::endl; // WHY SOME WAY TOO LOW?????? fixed.
 					rif_avg_scores_count[i]++;
 				}
 			}
-		}
+		});
 		for( int i = 0; i < XMapVal::N; ++i ) rif_avg_scores[i] /= rif_avg_scores_count[i];
 
 		// out << "======================================================================" << std::endl;
@@ -229,20 +269,21 @@ public:
 		out << "======================================================================" << std::endl;
 		float Ecollision = 0.0;
 		for( int i = 0; i < XMapVal::N; ++i ){
-			float colfrac = rif_num_collisions[i]*1.0/xmap_ptr_->map_.size();
+			float colfrac = rif_num_collisions[i]*1.0/xmap_ptr_->size();
 			out << "   Nrots " << I(3,i+1) << " " << F(7,5,colfrac) << " " << F(7,3,rif_avg_scores[i]) << " " << rif_avg_scores_count[i] << std::endl;
 			if( i > 0 ){
-				float pcolfrac = rif_num_collisions[i-1]*1.0/xmap_ptr_->map_.size();
+				float pcolfrac = rif_num_collisions[i-1]*1.0/xmap_ptr_->size();
 				Ecollision += i * (pcolfrac-colfrac);
 			}
 		}
-		Ecollision += rif_num_collisions[XMapVal::N-1]*1.0/xmap_ptr_->map_.size() * XMapVal::N;
+		Ecollision += rif_num_collisions[XMapVal::N-1]*1.0/xmap_ptr_->size() * XMapVal::N;
 		out << "E(collisions) = " << Ecollision << std::endl;
 		out << "======================================================================" << std::endl;
 
 	}
 
     RifBaseKeyRange key_range() const override {
+        runtime_assert_msg( !xmap_ptr_->is_flat(), "key_range: not supported for flat rifs" );
         auto b = std::make_shared<XmapKeyIterHelper<typename XMap::Map::const_iterator>>(
             ((typename XMap::Map const &)xmap_ptr_->map_).begin()  );
         auto e = std::make_shared<XmapKeyIterHelper<typename XMap::Map::const_iterator>>(
@@ -262,6 +303,7 @@ public:
             const RifBase * base = this;
             shared_ptr<XMap const> from;
             base->get_xmap_const_ptr( from );
+            runtime_assert_msg( !from->is_flat(), "rif dumps are not supported for flat rifs, use the .rif.gz" );
             
             
             utility::io::ozstream fout( file_name );
@@ -353,6 +395,7 @@ public:
         const RifBase * base = this;
         shared_ptr<XMap const> from;
         base->get_xmap_const_ptr( from );
+        runtime_assert_msg( !from->is_flat(), "rif dumps are not supported for flat rifs, use the .rif.gz" );
         static int const Nrots = XMap::Value::N;
 
         for( auto const & v : from->map_ ){
@@ -484,6 +527,7 @@ public:
         const RifBase * base = this;
         shared_ptr<XMap const> from;
         base->get_xmap_const_ptr( from );
+        runtime_assert_msg( !from->is_flat(), "rif dumps are not supported for flat rifs, use the .rif.gz" );
 
         // If there are ever more than 1M rotamers, change this
         std::pair<int, int> ok_range( -100, 1000000 );
@@ -636,6 +680,7 @@ public:
     	const RifBase * base = this;
 		shared_ptr<XMap const> from;
 		base->get_xmap_const_ptr( from );
+		runtime_assert_msg( !from->is_flat(), "rif dumps are not supported for flat rifs, use the .rif.gz" );
 
 
 		float coarse_dist_sq = (dump_dist + 8) * (dump_dist + 8);
@@ -887,6 +932,7 @@ public:
         const RifBase * base = this;
         shared_ptr<XMap const> xmap;
         base->get_xmap_const_ptr( xmap );
+        runtime_assert_msg( !xmap->is_flat(), "rif dumps are not supported for flat rifs, use the .rif.gz" );
 
         std::cout << "Distance 0.00:" << std::endl;
 
@@ -940,6 +986,21 @@ std::string get_rif_type_from_file( std::string fname )
 	return std::string(buf);
 }
 
+bool is_flat_rif_file( std::string fname )
+{
+	std::ifstream in( fname, std::ios::binary );
+	if( !in.good() ) return false;
+	size_t s;
+	in.read((char*)&s,sizeof(size_t));
+	if( !in.good() || s >= 9999 ) return false; // gzip magic makes s huge
+	in.seekg( s, std::ios::cur );
+	char magic[16];
+	for(int i = 0; i < 16; ++i) magic[i] = 0;
+	in.read( magic, 16 );
+	if( !in.good() ) return false;
+	return std::strncmp( magic, ::scheme::objective::hash::XformMapFlatHeader::MAGIC(), 16 ) == 0;
+}
+
 
 
 
@@ -978,13 +1039,19 @@ std::string get_rif_type_from_file( std::string fname )
 
         std::vector<bool> requirements_satisfied_;
 		std::vector<std::vector<float> > const * rotamer_energies_1b_ = nullptr;
+		std::vector<float> const * rotamer_energies_1b_min_ = nullptr;
 		std::vector< std::pair<int,int> > const * scaffold_rotamers_ = nullptr;
 		shared_ptr< BurialManager > burial_manager_;
 		shared_ptr< UnsatManager > unsat_manager_;
         shared_ptr< BurialVoxelArray > scaff_burial_grid_;
-		shared_ptr<::scheme::objective::storage::TwoBodyTable<float> const> reference_twobody_;
         //std::vector<std::vector<bool>> allowed_irots_;
         shared_ptr<std::vector<std::vector<bool>>> allowed_irots_;
+        // rif key per scaffold residue, hashed and prefetched in pre()
+        std::vector<uint64_t> rif_keys_;
+        // bb actors near the target and their keys, batch hashed in pre()
+        std::vector<EigenXform> rif_xforms_;
+        std::vector<int> rif_resis_;
+        std::vector<uint64_t> rif_batch_keys_;
 		// sat group vector goes here
 		//std::vector<float> is_satisfied_score_;
 	};
@@ -997,6 +1064,7 @@ std::string get_rif_type_from_file( std::string fname )
 		typedef ScoreBBActorvsRIFScratch Scratch;
 		typedef ScoreBBActorvsRIFResult Result;
 		typedef std::pair<RIFAnchor,BBActor> Interaction;
+		static uint64_t const NO_RIF_KEY = std::numeric_limits<uint64_t>::max();
 		bool packing_ = false;
 		::scheme::search::HackPackOpts packopts_;
 		int n_sat_groups_ = 0, require_satisfaction_ = 0, require_n_rifres_ = 0, require_hydrophobic_residue_contacts_ = 0;
@@ -1009,8 +1077,10 @@ std::string get_rif_type_from_file( std::string fname )
         
         // the requirements code
         std::vector< int > requirements_;
+		typedef ::scheme::objective::hash::XformMapBound<RIF> BoundRIF;
 	private:
 		shared_ptr<RIF const> rif_ = nullptr;
+		shared_ptr<BoundRIF const> bound_rif_ = nullptr;
 	public:
 		VoxelArrayPtr target_proximity_test_grid_ = nullptr;
 		RifScoreRotamerVsTarget rot_tgt_scorer_;
@@ -1028,6 +1098,16 @@ std::string get_rif_type_from_file( std::string fname )
 			rif_ptr->get_xmap_const_ptr( rif_ );
 		}
 
+		// score each cell with an optimistic bound from the rif's bound-only
+		// tier, much smaller than the full rif: the best rif score in the cell
+		// plus the best onebody at the residue, over all rotamers and without
+		// the rotamer filters. not usable for packing, or when sat groups,
+		// burial / unsats or requirements need every rotamer in the cell
+		bool set_bound_rif( shared_ptr< ::devel::scheme::RifBase const> rif_ptr ){
+			bound_rif_ = nullptr;
+			return rif_ptr->get_bound_only_const_ptr( bound_rif_ );
+		}
+
 		void init_for_packing(
 			// ::scheme::objective::storage::TwoBodyTable<float> const & twob,
 			shared_ptr< ::devel::scheme::RotamerIndex > rot_index_p,
@@ -1081,6 +1161,7 @@ std::string get_rif_type_from_file( std::string fname )
 			ScaffoldDataCacheOP data_cache = scene.conformation_ptr(1)->cache_data_;
             runtime_assert( data_cache );
 			scratch.rotamer_energies_1b_ = data_cache->local_onebody_p.get();
+			scratch.rotamer_energies_1b_min_ = data_cache->local_onebody_min_p.get();
             scratch.scaff_burial_grid_ = data_cache->burial_grid;
             scratch.allowed_irots_ = data_cache->allowed_irot_at_ires_p;
 
@@ -1104,6 +1185,29 @@ std::string get_rif_type_from_file( std::string fname )
 			scratch.has_rifrot_.resize(scratch.rotamer_energies_1b_->size(), false);
 			for ( int i = 0; i < scratch.has_rifrot_.size(); i++ ) scratch.has_rifrot_[i] = false;
 
+			// hash every bb actor and prefetch its rif bucket up front so the
+			// lookups in operator() don't each pay a full cache miss in turn
+			scratch.rif_keys_.assign( scratch.rotamer_energies_1b_->size(), (uint64_t)NO_RIF_KEY );
+			scratch.rif_xforms_.clear();
+			scratch.rif_resis_.clear();
+			for( size_t ia = 0; ia < scene.template num_actors<BBActor>(1); ++ia ){
+				BBActor const bb = scene.template get_actor<BBActor>( 1, ia );
+				if( target_proximity_test_grid_ && target_proximity_test_grid_->at( bb.position().translation() ) == 0.0 ){
+					continue;
+				}
+				scratch.rif_xforms_.push_back( bb.position() );
+				scratch.rif_resis_.push_back( bb.index_ );
+			}
+			size_t const nkeys = scratch.rif_xforms_.size();
+			scratch.rif_batch_keys_.resize( nkeys );
+			if( nkeys ) rif_->get_keys( &scratch.rif_xforms_[0], nkeys, &scratch.rif_batch_keys_[0] );
+			for( size_t i = 0; i < nkeys; ++i ){
+				uint64_t const key = scratch.rif_batch_keys_[i];
+				if( bound_rif_ ) bound_rif_->prefetch( key );
+				else             rif_->prefetch( key );
+				scratch.rif_keys_[ scratch.rif_resis_[i] ] = key;
+			}
+
 			if ( burialperthread_.size() > 0 ) {
 				scratch.burial_manager_ = burialperthread_.at( ::devel::scheme::omp_thread_num() );
 				scratch.burial_manager_->reset();
@@ -1124,12 +1228,7 @@ std::string get_rif_type_from_file( std::string fname )
 			runtime_assert( rot_tgt_scorer_.target_field_by_atype_.size() == 22 );
 			scratch.hackpack_ = packperthread_.at( ::devel::scheme::omp_thread_num() );
 
-			if ( ! scratch.burial_manager_ ) {
-				scratch.hackpack_->reinitialize( data_cache->local_twobody_p );
-			} else {
-				scratch.hackpack_->reinitialize( data_cache->local_twobody_per_thread.at(::devel::scheme::omp_thread_num()) );
-				scratch.reference_twobody_ = data_cache->local_twobody_p;
-			}
+			scratch.hackpack_->reinitialize( data_cache->local_twobody_p );
 
 		}
 
@@ -1137,13 +1236,27 @@ std::string get_rif_type_from_file( std::string fname )
 		Result operator()( RIFAnchor const &, BBActor const & bb, Scratch & scratch, Config const& c ) const
 		{
 
-			if( target_proximity_test_grid_ && target_proximity_test_grid_->at( bb.position().translation() ) == 0.0 ){
-				return 0.0;
+			uint64_t key = NO_RIF_KEY;
+			if( bb.index_ < scratch.rif_keys_.size() ){
+				key = scratch.rif_keys_[ bb.index_ ];
+			} else if( !target_proximity_test_grid_ || target_proximity_test_grid_->at( bb.position().translation() ) != 0.0 ){
+				key = rif_->get_key( bb.position() );
+			}
+			if( key == NO_RIF_KEY ) return 0.0; // not near target
+
+			if( bound_rif_ && !packing_ && !scratch.burial_manager_ && n_sat_groups_ == 0 && requirements_.size() == 0 ){
+				float best_rot_v_target;
+				if( !bound_rif_->lookup( key, best_rot_v_target ) ) return 0.0;
+				int const ires = bb.index_;
+				runtime_assert( scratch.rotamer_energies_1b_min_ );
+				float const score_rot_tot = best_rot_v_target + scratch.rotamer_energies_1b_min_->at(ires);
+				if( score_rot_tot < 0.0 ) scratch.has_rifrot_[ires] = true;
+				return std::min( score_rot_tot, 0.0f );
 			}
 
 			const bool want_sats = scratch.burial_manager_;
 
-			typename RIF::Value const & rotscores = rif_->operator[]( bb.position() );
+			typename RIF::Value const & rotscores = rif_->operator[]( key );
 			static int const Nrots = RIF::Value::N;
 			int const ires = bb.index_;
 			float bestsc = 0.0;
@@ -1292,9 +1405,7 @@ std::string get_rif_type_from_file( std::string fname )
 				result.val_ = packer.pack( result.rotamers_ );
 				result.val_ += unsat_zerobody;
 
-				if ( scratch.burial_manager_ ) {scratch.unsat_manager_->fix_packer( packer, scratch.reference_twobody_ );
-					// runtime_assert(scratch.reference_twobody_->check_equal(*packer.twob_));
-				}
+				if ( scratch.burial_manager_ ) scratch.unsat_manager_->fix_packer( packer );
 				
 
                 if ( hydrophobic_manager_ ) {
@@ -1720,21 +1831,21 @@ struct RifFactoryImpl :
 
 		// old
 		int progress0 = 0;
-		for( auto const & v : from->map_ ){
+		from->for_each_entry( [&]( uint64_t from_key, typename XMap::Value const & from_val ){
 			// if( ++progress0 % std::max((size_t)1,(from->size()/100)) == 0 ){
 				// std::cout << '*'; std::cout.flush();
 			// }
-			EigenXform x = from->hasher_.get_center( v.first );
+			EigenXform x = from->hasher_.get_center( from_key );
 
 			uint64_t k = to->hasher_.get_key(x);
 			typename XMap::Map::iterator iter = to->map_.find(k);
 			if( iter == to->map_.end() ){
-				to->map_.insert( std::make_pair(k,v.second) );
+				to->map_.insert( std::make_pair(k,from_val) );
 			} else {
-				iter->second.merge( v.second );
+				iter->second.merge( from_val );
 
 			}
-		}
+		});
 		// // std::cout << std::endl;
 
 		// new
@@ -1761,11 +1872,11 @@ struct RifFactoryImpl :
 	}
 
 	virtual	shared_ptr<rif::RifAccumulator>
-	create_rif_accumulator( float cart_resl, float ang_resl, float cart_bound, size_t scratchM ) const {
+	create_rif_accumulator( float cart_resl, float ang_resl, float cart_bound, size_t scratchM, std::string spill_prefix ) const {
 		return make_shared< rif::RIFAccumulatorMapThreaded<XMap> >(
 			this->shared_from_this(),
 			cart_resl, ang_resl, cart_bound,
-			scratchM
+			scratchM, spill_prefix
 		);
 	}
 
@@ -1777,6 +1888,10 @@ struct RifFactoryImpl :
 		if( ! utility::file::file_exists(fname) ){
 			utility_exit_with_message("create_rif_from_file missing file: " + fname );
 		}
+		if( is_flat_rif_file( fname ) ){
+			if( rif->load_flat( fname, description ) ) return rif;
+			else return nullptr;
+		}
 		utility::io::izstream in( fname );
 		if( !in.good() ) return nullptr;
 		bool success = rif->load( in, description );
@@ -1813,6 +1928,10 @@ struct RifFactoryImpl :
 				}
                 dynamic_cast<MySceneObjectiveRIF&>(*objective).objective.template
                     get_objective<MyScoreBBActorRIF>().ignore_rifres_if_worse_than = config.ignore_rifres_if_worse_than;
+				if( i_so < config.n_bound_only_resls && config.require_satisfaction == 0 && config.requirements.size() == 0
+					&& ! config.burial_manager && ! config.unsat_manager ){
+					objective->objective.template get_objective< MyScoreBBActorRIF >().set_bound_rif( config.rif_ptrs[i_so] );
+				}
 				objective->config = i_so;
 				objectives.push_back( objective );
 			}
@@ -78,7 +78,7 @@ struct RifFactory
 	) const = 0;
 
 	virtual	shared_ptr<rif::RifAccumulator>
-	create_rif_accumulator( float cart_resl, float ang_resl, float cart_bound, size_t scratchM ) const = 0;
+	create_rif_accumulator( float cart_resl, float ang_resl, float cart_bound, size_t scratchM, std::string spill_prefix="" ) const = 0;
 
 	RifPtr
 	create_rif_from_file( std::string const & fname ) const {
@@ -109,6 +109,9 @@ create_rif_factory( RifFactoryConfig const & config );
 
 std::string get_rif_type_from_file( std::string fname );
 
+// true if fname was written by RifBase::save_flat and can be mmaped
+bool is_flat_rif_file( std::string fname );
+
 
 
 struct HackPackOpts;
@@ -134,6 +137,7 @@ struct RifSceneObjectiveConfig
     float sasa_threshold;
     float sasa_multiplier;
     float ignore_rifres_if_worse_than;
+    int n_bound_only_resls;
 
 };
 
@@ -175,18 +175,13 @@ struct ScoreRotamerVsTarget {
         if( calculate_hbonds ){
             float hbscore = 0;
             // int hbcount = 0;
-            if( rot_index_p_->rotamer(irot).acceptors_.size() > 0 ||
-                rot_index_p_->rotamer(irot).donors_   .size() > 0 )
+            std::vector<HBondRay> const & acceptors = rot_index_p_->rotamer(irot).acceptors_;
+            std::vector<HBondRay> const & donors    = rot_index_p_->rotamer(irot).donors_;
+            if( acceptors.size() > 0 || donors.size() > 0 )
             {
-
-                std::vector<HBondRay> acceptor_rays = rot_index_p_->rotamer(irot).acceptors_;
-                for ( HBondRay & hb_ray : acceptor_rays ) hb_ray.apply_xform( rbpos );
-                hbscore += score_acceptor_rays_v_target( acceptor_rays, sat1, sat2, hbcount );
-
-                std::vector<HBondRay> donor_rays = rot_index_p_->rotamer(irot).donors_;
-                for ( HBondRay & hb_ray : donor_rays ) hb_ray.apply_xform( rbpos );
-                hbscore += score_donor_rays_v_target( donor_rays, sat1, sat2, hbcount );
-                
+                // rays are moved to rbpos one at a time on the stack, nothing is allocated
+                hbscore += score_acceptor_rays_v_target( acceptors.data(), acceptors.size(), rbpos, sat1, sat2, hbcount );
+                hbscore += score_donor_rays_v_target( donors.data(), donors.size(), rbpos, sat1, sat2, hbcount );
             }
 
             // oh god, fix me..... what should the logic be??? probably "softer" thresh on thishb to count
@@ -225,17 +220,41 @@ struct ScoreRotamerVsTarget {
         return score * upweight_iface_;
     }
 
+    // rays already in the target frame
+    struct NoRayXform {};
+    static void xform_ray( HBondRay &, NoRayXform const & ) {}
+    template< class Xform >
+    static void xform_ray( HBondRay & ray, Xform const & xform ) { ray.apply_xform( xform ); }
+
     float
     score_acceptor_rays_v_target( std::vector<HBondRay> const & acceptor_rays, int & sat1, int & sat2, int & hbcount ) const {
+        return score_acceptor_rays_v_target( acceptor_rays.data(), acceptor_rays.size(), NoRayXform(), sat1, sat2, hbcount );
+    }
+
+    // Each ray takes at most one target donor, so the best score seen for each
+    //  used donor is kept in a list as long as the rays, not an array over all
+    //  target donors that would have to be reset on every call
+    template< class Xform >
+    float
+    score_acceptor_rays_v_target(
+        HBondRay const * acceptor_rays,
+        size_t nrays,
+        Xform const & xform,
+        int & sat1,
+        int & sat2,
+        int & hbcount
+    ) const {
         float hbscore = 0;
-        const size_t target_donors_size = target_donors_.size();
 
         // this is faster than std::vector
-        float used_tgt_donor   [target_donors_size];
-        for( int i = 0; i < target_donors_size; ++i ) used_tgt_donor   [i] = 9e9;
+        int   used_sat  [ nrays > 0 ? nrays : 1 ];
+        float used_score[ nrays > 0 ? nrays : 1 ];
+        int nused = 0;
 
+        for( size_t iray = 0; iray < nrays; ++iray ) {
 
-        for( HBondRay const & hr_rot_acc : acceptor_rays ) {
+            HBondRay hr_rot_acc = acceptor_rays[iray];
+            xform_ray( hr_rot_acc, xform );
             
             float best_score = 100;
             int best_sat = -1;
@@ -249,7 +268,7 @@ struct ScoreRotamerVsTarget {
                 while ( (i_hr_tgt_don = *(sats_iter++)) != DonorAcceptorCache::CACHE_MAX_SAT ) {
 
                     /////////////// DUPLICATE CODE ///////////////////////////////////////////
-                    HBondRay const & hr_tgt_don = target_donors_.at(i_hr_tgt_don);
+                    HBondRay const & hr_tgt_don = target_donors_[i_hr_tgt_don];
                     float const thishb = score_hbond_rays( hr_tgt_don, hr_rot_acc, 0.0, long_hbond_fudge_distance_ );
                     if ( thishb < best_score ) {
                         best_score = thishb;
@@ -263,7 +282,7 @@ struct ScoreRotamerVsTarget {
                 for( int i_hr_tgt_don = 0; i_hr_tgt_don < target_donors_.size(); ++i_hr_tgt_don )
                 {
                     /////////////// DUPLICATE CODE ///////////////////////////////////////////
-                    HBondRay const & hr_tgt_don = target_donors_.at(i_hr_tgt_don);
+                    HBondRay const & hr_tgt_don = target_donors_[i_hr_tgt_don];
                     float const thishb = score_hbond_rays( hr_tgt_don, hr_rot_acc, 0.0, long_hbond_fudge_distance_ );
                     if ( thishb < best_score ) {
                         best_score = thishb;
@@ -273,28 +292,15 @@ struct ScoreRotamerVsTarget {
                 }
             }
 
-            if ( best_sat > -1 && used_tgt_donor[best_sat] > best_score ) {
-                // I don't think there is any need to use if ... else ..., but to make things more clear.
-                if ( used_tgt_donor[ best_sat ] < this->min_hb_quality_for_satisfaction_ ){
-                    if ( sat1 == -1 || sat1 == best_sat ){
-                        sat1 = best_sat;
-                    } else if ( sat2 == -1 || sat2 == best_sat) {
-                        sat2 = best_sat;
-                    }
-                } else if ( best_score < this->min_hb_quality_for_satisfaction_ ) {
-                    if(      sat1==-1 ) sat1 = best_sat;
-                    else if( sat2==-1 ) sat2 = best_sat;
-                }
-                if( upweight_multi_hbond_ && best_score < min_hb_quality_for_multi_ ){
-                    if( used_tgt_donor[best_sat] >= min_hb_quality_for_multi_ ) ++hbcount;
+            if ( best_sat > -1 ) {
+                int iused = 0;
+                while ( iused < nused && used_sat[iused] != best_sat ) ++iused;
+                if ( iused == nused ) {
+                    used_sat[nused] = best_sat;
+                    used_score[nused] = 9e9;
+                    ++nused;
                 }
-                // remove the double counting of hbond??? Do I need to do this, or ..........
-                if ( used_tgt_donor[ best_sat ] <= 9e5 ){
-                    hbscore += ( best_score - used_tgt_donor[best_sat] ) * hbond_weight_;
-                } else {
-                    hbscore += best_score * hbond_weight_;
-                }
-                used_tgt_donor[ best_sat ] = best_score;
+                hbscore += record_best_sat( best_sat, best_score, used_score[iused], sat1, sat2, hbcount );
             }
         }
 
@@ -303,18 +309,33 @@ struct ScoreRotamerVsTarget {
     }
 
 
-
     float
     score_donor_rays_v_target( std::vector<HBondRay> const & donor_rays, int & sat1, int & sat2, int & hbcount ) const {
-        float hbscore = 0;
+        return score_donor_rays_v_target( donor_rays.data(), donor_rays.size(), NoRayXform(), sat1, sat2, hbcount );
+    }
 
-        const size_t target_acceptors_size = target_acceptors_.size();
+    // same as score_acceptor_rays_v_target, sats of target acceptors are offset by the number of target donors
+    template< class Xform >
+    float
+    score_donor_rays_v_target(
+        HBondRay const * donor_rays,
+        size_t nrays,
+        Xform const & xform,
+        int & sat1,
+        int & sat2,
+        int & hbcount
+    ) const {
+        float hbscore = 0;
 
         // This is faster than std::vector
-        float used_tgt_acceptor[target_acceptors_size];
-        for( int i = 0; i < target_acceptors_size; ++i ) used_tgt_acceptor[i] = 9e9;
+        int   used_sat  [ nrays > 0 ? nrays : 1 ];
+        float used_score[ nrays > 0 ? nrays : 1 ];
+        int nused = 0;
 
-        for( HBondRay const & hr_rot_don : donor_rays ) {
+        for( size_t iray = 0; iray < nrays; ++iray ) {
+
+            HBondRay hr_rot_don = donor_rays[iray];
+            xform_ray( hr_rot_don, xform );
             
             float best_score = 100;
             int best_sat = -1;
@@ -329,7 +350,7 @@ struct ScoreRotamerVsTarget {
                 while ( (i_hr_tgt_acc = *(sats_iter++)) != DonorAcceptorCache::CACHE_MAX_SAT ) {
 
                     /////////////// DUPLICATE CODE ///////////////////////////////////////////
-                    HBondRay const & hr_tgt_acc = target_acceptors_.at(i_hr_tgt_acc);
+                    HBondRay const & hr_tgt_acc = target_acceptors_[i_hr_tgt_acc];
                     float const thishb = score_hbond_rays( hr_rot_don, hr_tgt_acc, 0.0, long_hbond_fudge_distance_ );
                     if ( thishb < best_score ) {
                         best_score = thishb;
@@ -342,7 +363,7 @@ struct ScoreRotamerVsTarget {
                 for( int i_hr_tgt_acc = 0; i_hr_tgt_acc < target_acceptors_.size(); ++i_hr_tgt_acc )
                 {
                     /////////////// DUPLICATE CODE ///////////////////////////////////////////
-                    HBondRay const & hr_tgt_acc = target_acceptors_.at(i_hr_tgt_acc);
+                    HBondRay const & hr_tgt_acc = target_acceptors_[i_hr_tgt_acc];
                     float const thishb = score_hbond_rays( hr_rot_don, hr_tgt_acc, 0.0, long_hbond_fudge_distance_ );
                     if ( thishb < best_score ) {
                         best_score = thishb;
@@ -353,28 +374,15 @@ struct ScoreRotamerVsTarget {
             }
 
 
-            if ( best_sat > -1 && used_tgt_acceptor[best_sat - target_donors_.size()] > best_score ) {
-                // I don't think there is any need to use if ... else ..., but to make things more clear.
-                if ( used_tgt_acceptor[ best_sat - target_donors_.size() ] < this->min_hb_quality_for_satisfaction_ ){
-                    if ( sat1 == -1 || sat1 == best_sat ){
-                        sat1 = best_sat;
-                    } else if ( sat2 == -1 || sat2 == best_sat) {
-                        sat2 = best_sat;
-                    }
-                } else if ( best_score < this->min_hb_quality_for_satisfaction_ ) {
-                    if(      sat1==-1 ) sat1 = best_sat;
-                    else if( sat2==-1 ) sat2 = best_sat;
+            if ( best_sat > -1 ) {
+                int iused = 0;
+                while ( iused < nused && used_sat[iused] != best_sat ) ++iused;
+                if ( iused == nused ) {
+                    used_sat[nused] = best_sat;
+                    used_score[nused] = 9e9;
+                    ++nused;
                 }
-                if( upweight_multi_hbond_ && best_score < min_hb_quality_for_multi_ ){
-                    if( used_tgt_acceptor[best_sat - target_donors_.size()] >= min_hb_quality_for_multi_ ) ++hbcount;
-                }
-                // remove the double counting of hbond??? Do I need to do this, or ..........
-                if ( used_tgt_acceptor[ best_sat - target_donors_.size() ] <= 9e5 ){
-                    hbscore += ( best_score - used_tgt_acceptor[best_sat - target_donors_.size()] ) * hbond_weight_;
-                } else {
-                    hbscore += best_score * hbond_weight_;
-                }
-                used_tgt_acceptor[ best_sat - target_donors_.size() ] = best_score;
+                hbscore += record_best_sat( best_sat, best_score, used_score[iused], sat1, sat2, hbcount );
             }
             
         }
@@ -383,6 +391,36 @@ struct ScoreRotamerVsTarget {
 
     }
 
+    // bookkeeping for the best target partner of one rotamer ray. used_score is the
+    //  best score of an earlier ray of this rotamer with the same partner, 9e9 if none
+    float
+    record_best_sat( int best_sat, float best_score, float & used_score, int & sat1, int & sat2, int & hbcount ) const {
+        if ( used_score <= best_score ) return 0;
+        // I don't think there is any need to use if ... else ..., but to make things more clear.
+        if ( used_score < this->min_hb_quality_for_satisfaction_ ){
+            if ( sat1 == -1 || sat1 == best_sat ){
+                sat1 = best_sat;
+            } else if ( sat2 == -1 || sat2 == best_sat) {
+                sat2 = best_sat;
+            }
+        } else if ( best_score < this->min_hb_quality_for_satisfaction_ ) {
+            if(      sat1==-1 ) sat1 = best_sat;
+            else if( sat2==-1 ) sat2 = best_sat;
+        }
+        if( upweight_multi_hbond_ && best_score < min_hb_quality_for_multi_ ){
+            if( used_score >= min_hb_quality_for_multi_ ) ++hbcount;
+        }
+        // remove the double counting of hbond??? Do I need to do this, or ..........
+        float hbscore = 0;
+        if ( used_score <= 9e5 ){
+            hbscore = ( best_score - used_score ) * hbond_weight_;
+        } else {
+            hbscore = best_score * hbond_weight_;
+        }
+        used_score = best_score;
+        return hbscore;
+    }
+
 
 
 };
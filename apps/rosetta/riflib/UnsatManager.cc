@@ -226,9 +226,6 @@ void
 UnsatManager::reset() {
     to_pack_rots_.clear();  // this supposedly doesn't mess with the memory
     to_pack_rots_.reserve(512);
-
-    modified_edges_.clear();
-    modified_edges_.reserve(1024);
 }
 
 
@@ -1202,21 +1199,17 @@ UnsatManager::handle_twobody( int satisfier1, int satisfier2, float penalty, ::s
     ToPackRot const & pack1 = to_pack_rots_[ satisfier1 ];
     ToPackRot const & pack2 = to_pack_rots_[ satisfier2 ];
 
-    packer.twob_->upweight_edge( pack1.ires, pack2.ires, pack1.irot, pack2.irot, penalty );
-    modified_edges_.push_back( std::array<int, 4> { pack1.ires, pack2.ires, pack1.irot, pack2.irot } );
+    packer.upweight_edge( pack1.ires, pack2.ires, pack1.irot, pack2.irot, penalty );
 
     return 0;
 
 }
 
+// The upweighted edges only live in the packer's overlay, the shared
+//  twobody table is never touched
 void
-UnsatManager::fix_packer( 
-    ::scheme::search::HackPack & packer, 
-    shared_ptr<::scheme::objective::storage::TwoBodyTable<float> const> reference_twobody
-) {
-    for ( std::array<int, 4> const & arr : modified_edges_ ) {
-        packer.twob_->restore_edge( arr[0], arr[1], arr[2], arr[3], reference_twobody );
-    }
+UnsatManager::fix_packer( ::scheme::search::HackPack & packer ) {
+    packer.clear_twobody_edits();
 }
 
 
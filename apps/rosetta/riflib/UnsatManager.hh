@@ -277,10 +277,7 @@ struct UnsatManager {
     insert_to_pack_rots_into_packer( ::scheme::search::HackPack & packer );
 
     void
-    fix_packer( 
-        ::scheme::search::HackPack & packer, 
-        shared_ptr<::scheme::objective::storage::TwoBodyTable<float> const> reference_twobody
-    );
+    fix_packer( ::scheme::search::HackPack & packer );
 
     bool
     patch_heavy_atoms( 
@@ -349,7 +346,6 @@ struct UnsatManager {
 
 // things that are resetable
     std::vector<ToPackRot> to_pack_rots_;
-    std::vector<std::array<int, 4>> modified_edges_;
 
 };
 
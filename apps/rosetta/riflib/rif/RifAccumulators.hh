@@ -14,6 +14,12 @@
 
 #include <riflib/rif/RifGenerator.hh>
 #include <riflib/RifFactory.hh>
+#include <scheme/objective/hash/XformMap.hh>
+#include <scheme/objective/hash/XformMapRuns.hh>
+
+#include <cstdio>
+#include <parallel/algorithm>
+#include <unistd.h>
 
 namespace devel {
 namespace scheme {
@@ -24,32 +30,60 @@ template<class XMap>
 struct RIFAccumulatorMapThreaded : public RifAccumulator {
 
 	typedef typename XMap::Map Map;
+
+	// the rif under construction is split by key hash into shards that
+	// condense fills in parallel, one thread per shard. keys land in
+	// rif_shards_ until rif() moves them into xmap_ptr_->map_; a key is never
+	// in both, so keys already in map_ are merged in place
+	static int const N_RIF_SHARDS = 64;
+	static int rif_shard( uint64_t key ){ return ::scheme::objective::hash::xform_map_flat_hash( key ) >> 58; }
+	static Map empty_map(){
+		Map m;
+		m.set_empty_key( std::numeric_limits<uint64_t>::max() );
+		return m;
+	}
+
 	shared_ptr<RifFactory const> rif_factory_;
-	std::vector< Map > to_insert_;
+	std::vector< std::vector< Map > > to_insert_; // [thread][shard]
+	mutable std::vector< Map > rif_shards_;
 	std::vector<int64_t> nsamp_;
 	float scratch_size_M_;
 	uint64_t N_motifs_found_;
 
 	shared_ptr<XMap> xmap_ptr_;
 
+	// if set, condense writes sorted runs to spill_prefix_*.run instead of
+	// growing xmap_ptr_, and merge_spill_runs builds the rif at the end
+	std::string spill_prefix_;
+	std::vector<std::string> spill_runs_;
+	std::vector<bool> spill_force_;
+
 	RIFAccumulatorMapThreaded(
 		shared_ptr<RifFactory const> rif_factory,
 		float cart_resl,
 		float ang_resl,
 		float cart_bound,
-		size_t scratch_size_M=8000
+		size_t scratch_size_M=8000,
+		std::string spill_prefix=""
 	)
 		: rif_factory_(rif_factory)
 		, scratch_size_M_(scratch_size_M)
 	 	, N_motifs_found_(0)
+		, spill_prefix_(spill_prefix)
+		, rif_shards_( N_RIF_SHARDS, empty_map() )
 	{
 		clear();
 		xmap_ptr_ = make_shared<XMap>( cart_resl, ang_resl );
 	}
 
+	~RIFAccumulatorMapThreaded(){
+		for( std::string const & fname : spill_runs_ ) std::remove( fname.c_str() );
+	}
+
 	uint64_t n_motifs_found() const override { return N_motifs_found_ + total_samples(); }
 
 	shared_ptr<RifBase> rif() const override {
+		flatten_rif_shards();
 		shared_ptr<RifBase> r = rif_factory_->create_rif();
 		r->set_xmap_ptr( xmap_ptr_ );
 		return r;
@@ -58,7 +92,10 @@ struct RIFAccumulatorMapThreaded : public RifAccumulator {
 	void insert( devel::scheme::EigenXform const & x, float score, int32_t rot, int sat1, int sat2, bool force, bool single_thread ) override {
 		if( score > 0.0 ) return;
 		uint64_t const key = xmap_ptr_->hasher_.get_key( x );
-		typename XMap::Map & map_for_this_thread( single_thread ? xmap_ptr_->map_ : to_insert_[ omp_get_thread_num() ] );
+		int const ishard = rif_shard( key );
+		Map & main_map = xmap_ptr_->map_;
+		typename XMap::Map & map_for_this_thread( !single_thread ? to_insert_[ omp_get_thread_num() ][ ishard ] :
+			main_map.find( key ) != main_map.end() ? main_map : rif_shards_[ ishard ] );
 		// std::cerr << "INSERT mapsize: " << map_for_this_thread.size() << " thread: " << omp_get_thread_num() << " nmaps: " << to_insert_.size() << std::endl;
 		typename XMap::Map::iterator iter = map_for_this_thread.find(key);
 		if( iter == map_for_this_thread.end() ){
@@ -96,34 +133,155 @@ struct RIFAccumulatorMapThreaded : public RifAccumulator {
 		return mem_use() > uint64_t(scratch_size_M_)*uint64_t(1024*1024);
 	}
 
+	// merges the per-thread maps into the rif shards, one thread per shard.
+	// each shard takes its scratch maps in thread order 0, 1, ... so the merge
+	// order per key is the same as merging the thread maps serially. keys
+	// already in map_ are merged there in place (every key belongs to exactly
+	// one shard, and map_ only sees finds here)
+	// when spilling, the rif is left alone and the keys are merged into
+	// separate shards that are written as one run
 	void condense(bool force_override/*=false*/) override {
-		using ObjexxFCL::format::I;
-		for( int i = 0; i < to_insert_.size(); ++i ){
-			// std::cout << I(3,i+1) << " of " << to_insert_.size() << " progress: ";
-			int64_t const out_interval = std::max<int64_t>(1,to_insert_[i].size()/100);
-			int64_t count = 0;
-			BOOST_FOREACH( typename XMap::Map::value_type const & value, to_insert_[i] ){
-				// if( ++count%out_interval == 0 ){ std::cout << '*'; std::cout.flush(); }
-				typename XMap::Key const key = value.first;
-				typename XMap::Value const & rotsc = value.second;
-				typename XMap::Map::iterator iter = xmap_ptr_->map_.find(key);
-				if( iter == xmap_ptr_->map_.end() ){
-					xmap_ptr_->map_.insert( std::make_pair( key, rotsc ) );
-					// for( int i = 0; i < rotsc.maxsize(); ++i ) runtime_assert( rotsc.score(i) > -9.0 );
-				} else {
-					iter->second.merge( rotsc, force_override );
-					// for( int i = 0; i < iter->second.maxsize(); ++i ) runtime_assert( iter->second.score(i) > -9.0 );
+		if( spill_prefix_.empty() ){
+			merge_scratch_maps( rif_shards_, force_override );
+			return;
+		}
+		std::vector<Map> new_keys( N_RIF_SHARDS, empty_map() );
+		merge_scratch_maps( new_keys, force_override );
+		write_spill_run( new_keys, force_override );
+	}
+
+	void merge_scratch_maps( std::vector<Map> & targets, bool force_override ){
+		Map & main_map = xmap_ptr_->map_;
+		#ifdef USE_OPENMP
+		#pragma omp parallel for schedule(dynamic,1)
+		#endif
+		for( int ishard = 0; ishard < N_RIF_SHARDS; ++ishard ){
+			Map & target = targets[ishard];
+			for( int i = 0; i < to_insert_.size(); ++i ){
+				Map & scratch = to_insert_[i][ishard];
+				for( typename Map::const_iterator it = scratch.begin(); it != scratch.end(); ++it ){
+					typename XMap::Map::iterator iter = main_map.find( it->first );
+					if( iter != main_map.end() ){
+						iter->second.merge( it->second, force_override );
+						continue;
+					}
+					iter = target.find( it->first );
+					if( iter == target.end() ) target.insert( *it );
+					else iter->second.merge( it->second, force_override );
 				}
+				scratch.clear(); // shrinks the table back to the minimum size
+			}
+		}
+	}
+
+	// moves the shard entries, freeing each shard as it goes
+	static void drain_shards( std::vector<Map> & shards, std::vector< std::pair< typename XMap::Key, typename XMap::Value > > & entries ){
+		size_t n = 0;
+		for( Map const & m : shards ) n += m.size();
+		entries.reserve( entries.size() + n );
+		for( Map & m : shards ){
+			entries.insert( entries.end(), m.begin(), m.end() );
+			empty_map().swap( m );
+		}
+	}
 
+	// bulk build of map_ from the shards: map_ is sized once, and the entries
+	// are sorted by home bucket so the inserts walk the table in order rather
+	// than missing cache on every one
+	void flatten_rif_shards() const {
+		typedef std::pair< typename XMap::Key, typename XMap::Value > Entry;
+		size_t n = 0;
+		for( Map const & m : rif_shards_ ) n += m.size();
+		if( n == 0 ) return;
+		std::vector<Entry> entries;
+		drain_shards( rif_shards_, entries );
+		Map & main_map = xmap_ptr_->map_;
+		main_map.resize( main_map.size() + entries.size() );
+		typename Map::hasher const hash = main_map.hash_funct();
+		size_t const mask = main_map.bucket_count() - 1;
+		__gnu_parallel::sort( entries.begin(), entries.end(),
+			[&hash,mask]( Entry const & a, Entry const & b ){ return ( hash( a.first ) & mask ) < ( hash( b.first ) & mask ); } );
+		main_map.insert( entries.begin(), entries.end() );
+	}
+
+	size_t rif_shards_mem_use() const {
+		size_t mem = 0;
+		for( Map const & m : rif_shards_ ) mem += m.bucket_count()*sizeof(typename XMap::Map::value_type);
+		return mem;
+	}
+
+	void write_spill_run( std::vector<Map> & new_keys, bool force_override ){
+		std::vector< std::pair< typename XMap::Key, typename XMap::Value > > entries;
+		drain_shards( new_keys, entries );
+		if( entries.empty() ) return;
+		// the pid keeps jobs that share a spill dir (and outfile name) apart
+		std::string fname = spill_prefix_ + "_" + str( (long)::getpid() ) + "_" + str( spill_runs_.size() ) + ".run";
+		runtime_assert_msg( ::scheme::objective::hash::write_xform_map_run( fname, entries ), "failed to write rif spill run " + fname );
+		spill_runs_.push_back( fname );
+		spill_force_.push_back( force_override );
+	}
+
+	// k-way merge of the spilled runs into the rif, and at the same time into
+	// each of coarse_rifs the same way RifFactory::create_rif_from_rif would.
+	// keys are counted first so map_ is sized once and never rehashed
+	void merge_spill_runs( std::vector< shared_ptr<RifBase> > const & coarse_rifs ) override {
+		typedef typename XMap::Key Key;
+		typedef typename XMap::Value Value;
+		flatten_rif_shards(); // single_thread inserts may be waiting there
+		if( spill_runs_.empty() ) return;
+
+		std::vector< shared_ptr<XMap> > coarse( coarse_rifs.size() );
+		for( int i = 0; i < coarse_rifs.size(); ++i ){
+			runtime_assert( coarse_rifs[i]->get_xmap_ptr( coarse[i] ) );
+		}
+
+		::scheme::objective::hash::XformMapRunMerger<Key,Value> merger;
+		Key key;
+		Value value;
+		uint64_t nkeys = 0;
+		runtime_assert_msg( merger.open( spill_runs_ ), "bad rif spill runs" );
+		while( merger.next( key, value, []( Value &, Value const &, int ){} ) ) ++nkeys;
+
+		Map & main_map = xmap_ptr_->map_;
+		main_map.resize( main_map.size() + nkeys );
+		bool merged_force = false;
+		auto merge = [this,&merged_force]( Value & a, Value const & b, int irun ){
+			a.merge( b, spill_force_[irun] );
+			merged_force = merged_force || spill_force_[irun];
+		};
+		runtime_assert_msg( merger.open( spill_runs_ ), "bad rif spill runs" );
+		while( merger.next( key, value, merge ) ){
+			bool const force = merged_force || spill_force_[ merger.first_run() ];
+			merged_force = false;
+			typename XMap::Map::iterator iter = main_map.find( key );
+			if( iter == main_map.end() ){
+				iter = main_map.insert( std::make_pair( key, value ) ).first;
+			} else {
+				iter->second.merge( value, force ); // single_thread inserts are already in map_
+			}
+			if( coarse.empty() ) continue;
+			Value sorted = iter->second;
+			sorted.sort_rotamers();
+			EigenXform const x = xmap_ptr_->hasher_.get_center( key );
+			for( shared_ptr<XMap> & to : coarse ){
+				uint64_t const k = to->hasher_.get_key( x );
+				typename XMap::Map::iterator citer = to->map_.find( k );
+				if( citer == to->map_.end() ) to->map_.insert( std::make_pair( k, sorted ) );
+				else                          citer->second.merge( sorted );
 			}
-			// std::cout << std::endl;
 		}
+
+		for( std::string const & fname : spill_runs_ ) std::remove( fname.c_str() );
+		spill_runs_.clear();
+		spill_force_.clear();
 	}
 
 	void report( std::ostream & out ) const override {
 		out << "RIFAccum nrots: " << devel::scheme::KMGT(n_motifs_found())
 		    << " mem: " << devel::scheme::KMGT(mem_use())
-		    << " rif_mem: " << devel::scheme::KMGT(xmap_ptr_->mem_use()) << std::endl;
+		    << " rif_mem: " << devel::scheme::KMGT(xmap_ptr_->mem_use()+rif_shards_mem_use());
+		if( spill_prefix_.size() ) out << " spilled runs: " << spill_runs_.size();
+		out << std::endl;
 	}
 
 	// inclusive on the ranges
@@ -132,6 +290,11 @@ struct RIFAccumulatorMapThreaded : public RifAccumulator {
 		for ( auto pair : xmap_ptr_->map_ ) {
 			count += pair.second.count_these_irots( irot_low, irot_high );
 		}
+		for ( Map const & m : rif_shards_ ) {
+			for ( auto pair : m ) {
+				count += pair.second.count_these_irots( irot_low, irot_high );
+			}
+		}
 		return count;
 	}
 
@@ -142,7 +305,8 @@ struct RIFAccumulatorMapThreaded : public RifAccumulator {
 
 		uint64_t const key = xmap_ptr_->hasher_.get_key( x );
 
-		typename XMap::Map & map_for_this_thread(xmap_ptr_->map_);
+		typename XMap::Map & map_for_this_thread( xmap_ptr_->map_.find(key) != xmap_ptr_->map_.end() ?
+			xmap_ptr_->map_ : rif_shards_[ rif_shard( key ) ] );
 		typename XMap::Map::iterator iter = map_for_this_thread.find(key);
 
 		typedef typename XMap::Value Value;
@@ -183,23 +347,19 @@ struct RIFAccumulatorMapThreaded : public RifAccumulator {
 	uint64_t mem_use() const {
 		uint64_t mem = 0;
 		for( int i = 0; i < to_insert_.size(); ++i ){
-			mem += to_insert_[i].bucket_count()*(sizeof(typename XMap::Map::value_type));
+			for( Map const & m : to_insert_[i] ){
+				mem += m.bucket_count()*(sizeof(typename XMap::Map::value_type));
+			}
 		}
 		return mem;
 	}
 
 
 	void clear() override {
-		for( int i = 0; i < to_insert_.size(); ++i ) to_insert_[i].clear();
 		to_insert_.clear();
 		nsamp_.clear();
 
-		to_insert_.reserve( devel::scheme::omp_max_threads_1() );
-		for( int i = 0; i < devel::scheme::omp_max_threads_1(); ++i ){
-			Map m;
-			m.set_empty_key( std::numeric_limits<uint64_t>::max() );
-			to_insert_.push_back(m);
-		}
+		to_insert_.resize( devel::scheme::omp_max_threads_1(), std::vector<Map>( N_RIF_SHARDS, empty_map() ) );
 		nsamp_.resize( devel::scheme::omp_max_threads_1(), 0 );
 	}
 
@@ -48,6 +48,8 @@ struct RifAccumulator {
 	virtual void clear() = 0; // seems to only clear temporary storage....
 	virtual uint64_t count_these_irots( int irot_low, int irot_high ) const = 0;
 	virtual std::set<size_t> get_sats_of_this_irot( devel::scheme::EigenXform const & x, int irot ) const = 0;
+	// for accumulators that spill to disk, builds rif() (and coarse_rifs) from the spilled data
+	virtual void merge_spill_runs( std::vector< shared_ptr<RifBase> > const & coarse_rifs ) = 0;
 };
 typedef shared_ptr<RifAccumulator> RifAccumulatorP;
 
@@ -14,7 +14,12 @@
 #include <riflib/scaffold/ScaffoldDataCache.hh>
 #include <riflib/rifdock_tasks/OutputResultsTasks.hh>
 
+#include <scheme/util/WorkStealingRange.hh>
+#include <scheme/util/ShardExchange.hh>
+#include <scheme/search/ParentBound.hh>
 
+
+#include <cstring>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -78,6 +83,59 @@ DiversifyByNestTask::return_any_points(
 
 
 
+shared_ptr<std::vector<SearchPoint>> 
+DiversifyByScaffoldsTask::return_search_points( 
+    shared_ptr<std::vector<SearchPoint>> search_points, 
+    RifDockData & rdd, 
+    ProtocolData & pd ) {
+    return return_any_points( search_points, rdd, pd );
+}
+shared_ptr<std::vector<SearchPointWithRots>> 
+DiversifyByScaffoldsTask::return_search_point_with_rotss( 
+    shared_ptr<std::vector<SearchPointWithRots>> search_point_with_rotss, 
+    RifDockData & rdd, 
+    ProtocolData & pd ) { 
+    return return_any_points( search_point_with_rotss, rdd, pd );
+}
+shared_ptr<std::vector<RifDockResult>> 
+DiversifyByScaffoldsTask::return_rif_dock_results( 
+    shared_ptr<std::vector<RifDockResult>> rif_dock_results, 
+    RifDockData & rdd, 
+    ProtocolData & pd ) { 
+    return return_any_points( rif_dock_results, rdd, pd );
+}
+
+template<class AnyPoint>
+shared_ptr<std::vector<AnyPoint>>
+DiversifyByScaffoldsTask::return_any_points( 
+    shared_ptr<std::vector<AnyPoint>> any_points, 
+    RifDockData & rdd, 
+    ProtocolData & pd ) {
+
+    uint64_t num_scaffolds = rdd.scaffold_provider->get_scaffold_index_limits().front();
+    if ( num_scaffolds <= 1 ) {
+        return any_points;
+    }
+
+    shared_ptr<std::vector<AnyPoint>> diversified = make_shared<std::vector<AnyPoint>>( num_scaffolds * any_points->size() );
+
+    uint64_t added = 0;
+    for ( AnyPoint const & pt : *any_points ) {
+
+        for ( uint64_t i = 0; i < num_scaffolds; i++ ) {
+            (*diversified)[added] = pt;
+            (*diversified)[added].index.scaffold_index = ScaffoldIndex( 0, i );
+            added++;
+        }
+    }
+
+    any_points->clear();
+
+    return diversified;
+}
+
+
+
 shared_ptr<std::vector<SearchPoint>> 
 HSearchInit::return_search_points( 
     shared_ptr<std::vector<SearchPoint>> search_points, 
@@ -98,15 +156,9 @@ HSearchInit::return_search_points(
 
     pd.unique_scaffolds.clear();
     for ( std::pair<RifDockIndex, bool> pair : uniq_scaffolds ) {
-        ScaffoldIndex si = pair.first.scaffold_index;
-        ScaffoldDataCacheOP sdc = rdd.scaffold_provider->get_data_cache_slow(si);
-        sdc->setup_onebody_tables( rdd.rot_index_p, rdd.opt);
-        pd.unique_scaffolds.push_back(si);
-
-        if ( rdd.burial_manager ) {
-            sdc->setup_burial_grids( rdd.burial_manager );
-        }
+        pd.unique_scaffolds.push_back( pair.first.scaffold_index );
     }
+    setup_scaffolds_( rdd, pd );
 
 
     ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -128,6 +180,25 @@ HSearchInit::return_search_points(
 }
 
 
+void
+HSearchInit::restore_state( RifDockData & rdd, ProtocolData & pd ) {
+    pd.start_rif = std::chrono::high_resolution_clock::now();
+    setup_scaffolds_( rdd, pd );
+}
+
+void
+HSearchInit::setup_scaffolds_( RifDockData & rdd, ProtocolData & pd ) {
+    for ( ScaffoldIndex si : pd.unique_scaffolds ) {
+        ScaffoldDataCacheOP sdc = rdd.scaffold_provider->get_data_cache_slow(si);
+        sdc->setup_onebody_tables( rdd.rot_index_p, rdd.opt);
+
+        if ( rdd.burial_manager ) {
+            sdc->setup_burial_grids( rdd.burial_manager );
+        }
+    }
+}
+
+
 shared_ptr<std::vector<SearchPoint>> 
 HSearchScoreAtReslTask::return_search_points( 
     shared_ptr<std::vector<SearchPoint>> search_points_p, 
@@ -150,90 +221,245 @@ HSearchScoreAtReslTask::return_search_points(
 
     bool need_sdc = using_csts || tether_to_input_position_cut_ != 0;
 
+    // After an implicit HSearchScaleToReslTask, each point
+    //  is a parent standing for implicit_children children with nest_index
+    //  parent*n to parent*n+n-1. The children are made as they are scored and only
+    //  those under survivor_cut_ are kept, so the full child beam is never stored
+    uint64_t implicit_children = pd.implicit_children;
+    pd.implicit_children = 1;
+
+    // With -hsearch_n_shards, the coordinator publishes the points and every
+    //  process scores one contiguous slice of them, i.e. a range of parents and
+    //  their children. The workers send their slices back to the coordinator
+    shared_ptr< ::scheme::util::ShardExchange > shards = rdd.hsearch_shards;
+    std::string const stage_name = "scaff" + std::to_string( rdd.iscaff ) + "_resl" + std::to_string( rif_resl_ );
+    int64_t score_begin = 0, score_end = search_points.size();
+    if ( shards ) {
+        if ( shards->is_coordinator() ) {
+            runtime_assert_msg( shards->publish( stage_name + "_children", (char const *)&implicit_children, sizeof(uint64_t) ),
+                "failed to publish the HSearch points to " + shards->fname( stage_name + "_children" ) );
+            runtime_assert_msg( shards->publish( stage_name + "_points", (char const *)search_points.data(), search_points.size()*sizeof(SearchPoint) ),
+                "failed to publish the HSearch points to " + shards->fname( stage_name + "_points" ) );
+        } else {
+            ::scheme::util::FlatCacheFile msg, children_msg;
+            if ( ! shards->wait_for( stage_name + "_points", msg, hsearch_shards_done_name( rdd.iscaff ) ) ) {
+                cout << "HSearch coordinator is done with this scaffold" << endl;
+                // it won't read scores this shard sent at a stage it gave up on
+                for ( int resl = 0; resl < rdd.RESLS.size(); resl++ ) {
+                    shards->remove( "scaff" + std::to_string( rdd.iscaff ) + "_resl" + std::to_string( resl ) + "_scores" + std::to_string( shards->ishard() ) );
+                }
+                return make_shared<std::vector<SearchPoint>>();
+            }
+            runtime_assert( shards->poll( stage_name + "_children", children_msg ) && children_msg.size() == sizeof(uint64_t) );
+            std::memcpy( &implicit_children, children_msg.data(), sizeof(uint64_t) );
+            search_points.resize( msg.size() / sizeof(SearchPoint) );
+            std::memcpy( search_points.data(), msg.data(), search_points.size()*sizeof(SearchPoint) );
+        }
+        ::scheme::util::shard_range( search_points.size(), shards->nshards(), shards->ishard(), score_begin, score_end );
+    }
+    bool const implicit = implicit_children > 1;
+    int64_t const n_parents = score_end - score_begin;
+    int64_t const n_to_score = n_parents * implicit_children;
 
-    cout << "HSearsh stage " << rif_resl_+1 << " resl " << F(5,2,rdd.RESLS[rif_resl_]) << " begin threaded sampling, " << KMGT(search_points.size()) << " samples: ";
-    int64_t const out_interval = std::max<int64_t>(search_points.size()/50, 1);
+
+    cout << "HSearsh stage " << rif_resl_+1 << " resl " << F(5,2,rdd.RESLS[rif_resl_]) << " begin threaded sampling, " << KMGT(n_to_score) << " samples: ";
+    int64_t const out_interval = std::max<int64_t>(n_parents/50, 1);
     std::exception_ptr exception = nullptr;
     std::chrono::time_point<std::chrono::high_resolution_clock> start, end;
     start = std::chrono::high_resolution_clock::now();
-    pd.total_search_effort += search_points.size();
+    pd.total_search_effort += search_points.size() * implicit_children;
 
-    #ifdef USE_OPENMP
-    #pragma omp parallel for schedule(dynamic,64)
-    #endif
-    for( int64_t i = 0; i < search_points.size(); ++i ){
-        if( exception ) continue;
-        try {
-            if( i%out_interval==0 ){ cout << '*'; cout.flush(); }
-            RifDockIndex const isamp = search_points[i].index;
-
-            ScenePtr tscene( rdd.scene_pt[omp_get_thread_num()] );
-            bool director_success = rdd.director->set_scene( isamp, director_resl_, *tscene );
-            if ( ! director_success ) {
-                search_points[i].score = 9e9;
-                continue;
-            }
+    auto score_point = [&]( SearchPoint & search_point, ScenePtr const & tscene ) {
+        RifDockIndex const isamp = search_point.index;
 
-            if ( need_sdc ) {
-                ScaffoldIndex si = isamp.scaffold_index;
-                ScaffoldDataCacheOP sdc = rdd.scaffold_provider->get_data_cache_slow(si);
-
-                if( tether_to_input_position_cut_ > 0 ){
-                    float redundancy_filter_rg = sdc->get_redundancy_filter_rg( rdd.target_redundancy_filter_rg );
-
-                    EigenXform x;// = tscene->position(1);
-                    rdd.nest.get_state( isamp.nest_index, director_resl_, x );
-                    x.translation() -= sdc->scaffold_center;
-                    float xmag =  xform_magnitude( x, redundancy_filter_rg );
-                    if( xmag > tether_to_input_position_cut_ + rdd.RESLS[rif_resl_] ){
-                        search_points[i].score = 9e9;
-                        continue;
-                    } 
-                }
+        bool director_success = rdd.director->set_scene( isamp, director_resl_, *tscene );
+        if ( ! director_success ) {
+            search_point.score = 9e9;
+            return;
+        }
 
-                /////////////////////////////////////////////////////
-                /////// Longxing' code  ////////////////////////////
-                ////////////////////////////////////////////////////
-                if (using_csts) {
-                    EigenXform x = tscene->position(1);
-                    bool pass_all = true;
-                    for(CstBaseOP p : sdc->csts) {
-                        if (!p->apply( x )) {
-                            pass_all = false;
-                            break;
-                        }
-                    }
-                    if (!pass_all) {
-                        search_points[i].score = 9e9;
-                        continue;
+        if ( need_sdc ) {
+            ScaffoldIndex si = isamp.scaffold_index;
+            ScaffoldDataCacheOP sdc = rdd.scaffold_provider->get_data_cache_slow(si);
+
+            if( tether_to_input_position_cut_ > 0 ){
+                float redundancy_filter_rg = sdc->get_redundancy_filter_rg( rdd.target_redundancy_filter_rg );
+
+                EigenXform x;// = tscene->position(1);
+                rdd.nest.get_state( isamp.nest_index, director_resl_, x );
+                x.translation() -= sdc->scaffold_center;
+                float xmag =  xform_magnitude( x, redundancy_filter_rg );
+                if( xmag > tether_to_input_position_cut_ + rdd.RESLS[rif_resl_] ){
+                    search_point.score = 9e9;
+                    return;
+                } 
+            }
+
+            /////////////////////////////////////////////////////
+            /////// Longxing' code  ////////////////////////////
+            ////////////////////////////////////////////////////
+            if (using_csts) {
+                EigenXform x = tscene->position(1);
+                bool pass_all = true;
+                for(CstBaseOP p : sdc->csts) {
+                    if (!p->apply( x )) {
+                        pass_all = false;
+                        break;
                     }
                 }
+                if (!pass_all) {
+                    search_point.score = 9e9;
+                    return;
+                }
             }
+        }
+
+        // the real rif score!!!!!!
+        std::vector<float> scores;
+        search_point.score = rdd.objectives[rif_resl_]->score( *tscene, scores );
 
-            // the real rif score!!!!!!
-            std::vector<float> scores;
-            search_points[i].score = rdd.objectives[rif_resl_]->score( *tscene, scores );
+        search_point.sasa = (uint16_t) ( scores[3] / SASA_SUBVERT_MULTIPLIER );
 
-            search_points[i].sasa = (uint16_t) ( scores[3] / SASA_SUBVERT_MULTIPLIER );
+        // search_point.score = rdd.objectives[rif_resl_]->score( *tscene );// + tot_sym_score;
+    };
 
-            // search_points[i].score = rdd.objectives[rif_resl_]->score( *tscene );// + tot_sym_score;
+    // branch and bound over the parents, best first. only parents scored at the
+    //  previous stage say anything about their children, stage 0 has none
+    shared_ptr< ::scheme::search::ParentBound<float> > bound;
+    if ( implicit && rif_resl_ > 0 && beam_keep_ > 0 && rdd.opt.hsearch_bound_slack_scale > 0 && ! rdd.opt.hack_pack_during_hsearch ) {
+        __gnu_parallel::sort( search_points.begin() + score_begin, search_points.begin() + score_end );
+        bound = make_shared< ::scheme::search::ParentBound<float> >( beam_keep_ * pd.beam_multiplier, omp_max_threads(),
+            survivor_cut_, rdd.opt.hsearch_bound_slack_scale, rdd.opt.hsearch_bound_calibration );
+    }
 
+    // with implicit children, each thread keeps the survivors of the grains of
+    //  parents it scored, and they are put back in parent order below
+    struct SurvivorGrain {
+        int64_t begin;
+        int ithread;
+        size_t offset, size;
+        bool operator < ( SurvivorGrain const & o ) const { return begin < o.begin; }
+    };
+    std::vector<std::vector<SearchPoint>> thread_survivors( implicit ? omp_max_threads() : 0 );
+    std::vector<std::vector<SurvivorGrain>> thread_grains( implicit ? omp_max_threads() : 0 );
+
+    // each thread works through a contiguous block of points (children of the
+    // same parents, so they hit the same rif buckets) and steals from threads
+    // on its own socket before crossing to another one
+    ::scheme::util::WorkStealingRange work( n_parents, omp_max_threads(),
+        rdd.opt.hsearch_numa_groups > 0 ? rdd.opt.hsearch_numa_groups : ::scheme::util::numa_node_count(),
+        std::max<int64_t>( 64 / implicit_children, 1 ) );
 
-        } catch( std::exception const & ex ) {
-            #ifdef USE_OPENMP
-            #pragma omp critical
-            #endif
-            exception = std::current_exception();
+    #ifdef USE_OPENMP
+    #pragma omp parallel
+    #endif
+    {
+    int const ithread = omp_thread_num();
+    ScenePtr tscene( rdd.scene_pt[omp_get_thread_num()] );
+    int victim = 0;
+    int64_t ibegin, iend;
+    while( work.next( ithread, victim, ibegin, iend ) ){
+        if ( implicit ) thread_grains[ithread].push_back( SurvivorGrain { ibegin, ithread, thread_survivors[ithread].size(), 0 } );
+        for( int64_t i = score_begin + ibegin; i < score_begin + iend; ++i ){
+            if( exception ) continue;
+            try {
+                if( i%out_interval==0 ){ cout << '*'; cout.flush(); }
+                if ( ! implicit ) {
+                    score_point( search_points[i], tscene );
+                    continue;
+                }
+                float const parent_score = search_points[i].score;
+                if ( bound && bound->prune( parent_score ) ) continue;
+                float best_child_score = 9e9;
+                SearchPoint child = search_points[i];
+                uint64_t const nest_index0 = child.index.nest_index * implicit_children;
+                for ( uint64_t j = 0; j < implicit_children; j++ ) {
+                    child.index.nest_index = nest_index0 + j;
+                    score_point( child, tscene );
+                    best_child_score = std::min( best_child_score, child.score );
+                    if ( child.score < survivor_cut_ ) {
+                        thread_survivors[ithread].push_back( child );
+                        if ( bound ) bound->add_child( ithread, child.score );
+                    }
+                }
+                if ( bound ) bound->add_parent( parent_score, best_child_score );
+            } catch( std::exception const & ex ) {
+                #ifdef USE_OPENMP
+                #pragma omp critical
+                #endif
+                exception = std::current_exception();
+            }
         }
+        if ( implicit ) thread_grains[ithread].back().size = thread_survivors[ithread].size() - thread_grains[ithread].back().offset;
+    }
     }
     if( exception ) std::rethrow_exception(exception);
     end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> elapsed_seconds_rif = end-start;
-    pd.hsearch_rate = (double)search_points.size()/ elapsed_seconds_rif.count()/omp_max_threads();
+    if ( bound ) {
+        cout << endl << "skipped " << KMGT(bound->npruned()) << " of " << KMGT(n_parents) << " parents, beam cutoff "
+             << bound->cutoff() << " slack " << bound->slack();
+    }
+    int64_t const n_children_scored = bound ? ( n_parents - bound->npruned() ) * implicit_children : n_to_score;
+    pd.hsearch_rate = (double)n_children_scored/ elapsed_seconds_rif.count()/omp_max_threads();
     cout << endl;// << "done threaded sampling, partitioning data..." << endl;
 
+    shared_ptr<std::vector<SearchPoint>> scored_p = search_points_p;
+    if ( implicit ) {
+        std::vector<SurvivorGrain> grains;
+        for ( std::vector<SurvivorGrain> const & tg : thread_grains ) grains.insert( grains.end(), tg.begin(), tg.end() );
+        std::sort( grains.begin(), grains.end() );
+        size_t n_survivors = 0;
+        for ( SurvivorGrain const & grain : grains ) n_survivors += grain.size;
+
+        scored_p = make_shared<std::vector<SearchPoint>>( n_survivors );
+        size_t added = 0;
+        for ( SurvivorGrain const & grain : grains ) {
+            std::vector<SearchPoint> const & survivors = thread_survivors[grain.ithread];
+            std::copy( survivors.begin() + grain.offset, survivors.begin() + grain.offset + grain.size, scored_p->begin() + added );
+            added += grain.size;
+        }
+        std::vector<std::vector<SearchPoint>>().swap( thread_survivors );
+        cout << "kept " << KMGT(n_survivors) << " of " << KMGT(n_children_scored) << " children under " << survivor_cut_ << endl;
+    }
 
-    return search_points_p;
+    if ( shards && ! shards->is_coordinator() ) {
+        std::string const name = stage_name + "_scores" + std::to_string( shards->ishard() );
+        SearchPoint const * scored = implicit ? scored_p->data() : search_points.data() + score_begin;
+        size_t const n_scored = implicit ? scored_p->size() : n_parents;
+        runtime_assert_msg( shards->publish( name, (char const *)scored, n_scored*sizeof(SearchPoint) ),
+            "failed to publish the HSearch scores to " + shards->fname( name ) );
+        return search_points_p;
+    }
+    if ( shards && shards->is_coordinator() ) {
+        for ( int ishard = 1; ishard < shards->nshards(); ishard++ ) {
+            std::string const name = stage_name + "_scores" + std::to_string( ishard );
+            ::scheme::util::FlatCacheFile msg;
+            runtime_assert_msg( shards->wait_for( name, msg, "", rdd.opt.hsearch_shard_timeout ), "no HSearch scores from shard " + std::to_string( ishard ) );
+            if ( implicit ) {
+                // survivors of the shards, in shard order, follow those of this one
+                runtime_assert_msg( msg.size() % sizeof(SearchPoint) == 0, "bad HSearch scores from shard " + std::to_string( ishard ) );
+                size_t const n_before = scored_p->size();
+                scored_p->resize( n_before + msg.size() / sizeof(SearchPoint) );
+                std::memcpy( scored_p->data() + n_before, msg.data(), msg.size() );
+            } else {
+                int64_t shard_begin, shard_end;
+                ::scheme::util::shard_range( search_points.size(), shards->nshards(), ishard, shard_begin, shard_end );
+                runtime_assert_msg( msg.size() == ( shard_end - shard_begin )*sizeof(SearchPoint), "wrong number of HSearch scores from shard " + std::to_string( ishard ) );
+                std::memcpy( search_points.data() + shard_begin, msg.data(), msg.size() );
+            }
+            shards->remove( name );
+        }
+        // every worker has sent scores for this stage, so it has read the points and
+        //  is past the previous scaffolds, whose done messages can go too
+        shards->remove( stage_name + "_points" );
+        shards->remove( stage_name + "_children" );
+        for ( int iscaff = rdd.iscaff - 1; iscaff >= 0 && shards->remove( hsearch_shards_done_name( iscaff ) ); iscaff-- ) {}
+    }
+
+    if ( implicit ) search_points.clear();
+
+    return scored_p;
 }
 
 
@@ -292,28 +518,56 @@ HSearchScaleToReslTask::return_search_points(
             use_pow2 *= DIMPOW2_;
         }
 
-        __gnu_parallel::sort( search_points.begin(), search_points.end() );
-        size_t good_points = 0;
-        for ( good_points = 0; good_points < search_points.size(); good_points++ ) {
-            if ( search_points[good_points].score >= global_score_cut_ ) break;
+        // no need to sort, the next stage only needs the points under the cut.
+        // count them per chunk, then each chunk writes its children straight
+        // to its offset in the output, keeping the input order
+        int64_t const nchunks = std::min<int64_t>( search_points.size(), omp_max_threads() * 16 );
+        std::vector<uint64_t> chunk_good( nchunks + 1, 0 );
+
+        #ifdef USE_OPENMP
+        #pragma omp parallel for schedule(static,1)
+        #endif
+        for( int64_t ichunk = 0; ichunk < nchunks; ++ichunk ){
+            int64_t const begin = search_points.size() * ichunk / nchunks;
+            int64_t const end = search_points.size() * (ichunk+1) / nchunks;
+            uint64_t ngood = 0;
+            for( int64_t i = begin; i < end; ++i ) ngood += search_points[i].score < global_score_cut_;
+            chunk_good[ichunk+1] = ngood;
         }
+        for( int64_t ichunk = 0; ichunk < nchunks; ++ichunk ) chunk_good[ichunk+1] += chunk_good[ichunk];
+        size_t const good_points = chunk_good[nchunks];
 
         if( current_resl_ == 0 ) pd.non0_space_size += good_points;
 
+        if ( implicit_children_ ) {
+            pd.implicit_children = use_pow2;
+            use_pow2 = 1;
+        }
+
         out_points.resize( use_pow2 * good_points );
 
         #ifdef USE_OPENMP
-        #pragma omp parallel for schedule(dynamic,64)
+        #pragma omp parallel for schedule(static,1)
         #endif
-        for( int64_t i = 0; i < good_points; ++i ){
-            RifDockIndex rdi0 = search_points[i].index;
-            uint64_t isamp0 = use_pow2 * rdi0.nest_index;
-            uint64_t array_offset = i*use_pow2;
-
-            for( uint64_t j = 0; j < use_pow2; ++j ){
-                SearchPoint & rdi = out_points[array_offset+j];
-                rdi = rdi0;
-                rdi.index.nest_index = isamp0 + j;
+        for( int64_t ichunk = 0; ichunk < nchunks; ++ichunk ){
+            int64_t const begin = search_points.size() * ichunk / nchunks;
+            int64_t const end = search_points.size() * (ichunk+1) / nchunks;
+            uint64_t array_offset = chunk_good[ichunk] * use_pow2;
+            for( int64_t i = begin; i < end; ++i ){
+                if( search_points[i].score >= global_score_cut_ ) continue;
+                if ( implicit_children_ ) {
+                    out_points[array_offset++] = search_points[i];
+                    continue;
+                }
+                RifDockIndex rdi0 = search_points[i].index;
+                uint64_t isamp0 = use_pow2 * rdi0.nest_index;
+
+                for( uint64_t j = 0; j < use_pow2; ++j ){
+                    SearchPoint & rdi = out_points[array_offset+j];
+                    rdi = rdi0;
+                    rdi.index.nest_index = isamp0 + j;
+                }
+                array_offset += use_pow2;
             }
         }
 
@@ -359,13 +613,13 @@ HSearchFinishTask::return_search_points(
 
     std::vector<SearchPoint> & search_points = *search_points_p;
 
-    std::cout << "full sort of final samples" << std::endl;
-    __gnu_parallel::sort( search_points.begin(), search_points.end() );
+    // only points with score <= 0 are kept, so drop the rest before sorting
+    std::vector<SearchPoint>::iterator good_end = __gnu_parallel::partition( search_points.begin(), search_points.end(),
+        []( SearchPoint const & sp ){ return sp.score <= 0; } );
+    size_t good_points = good_end - search_points.begin();
 
-    size_t good_points = 0;
-    for( good_points; good_points < search_points.size(); ++good_points ){
-        if( search_points[good_points].score > 0 ) break;
-    }
+    std::cout << "sort of final samples, " << KMGT(good_points) << " of " << KMGT(search_points.size()) << std::endl;
+    __gnu_parallel::sort( search_points.begin(), good_end );
 
     search_points.resize(good_points);
 
@@ -410,4 +664,20 @@ DumpHSearchFramesTask::return_search_points(
 
 
 
+std::string
+hsearch_shards_done_name( int iscaff ) {
+    return "scaff" + std::to_string( iscaff ) + "_done";
+}
+
+void
+hsearch_shards_remove_scaffold( ::scheme::util::ShardExchange const & shards, int iscaff, int nresl ) {
+    for ( int resl = 0; resl < nresl; resl++ ) {
+        std::string const stage_name = "scaff" + std::to_string( iscaff ) + "_resl" + std::to_string( resl );
+        shards.remove( stage_name + "_points" );
+        shards.remove( stage_name + "_children" );
+        for ( int ishard = 1; ishard < shards.nshards(); ishard++ ) shards.remove( stage_name + "_scores" + std::to_string( ishard ) );
+    }
+}
+
+
 }}
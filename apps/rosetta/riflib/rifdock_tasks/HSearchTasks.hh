@@ -14,6 +14,7 @@
 #include <riflib/task/SearchPointTask.hh>
 #include <riflib/task/AnyPointTask.hh>
 
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -61,6 +62,42 @@ private:
 
 };
 
+// One copy of each point per scaffold at depth 0 of the ScaffoldProvider,
+//  so scaffolds batched into one provider share a single beam
+struct DiversifyByScaffoldsTask : public AnyPointTask {
+
+    DiversifyByScaffoldsTask(
+        ) 
+        {}
+
+    shared_ptr<std::vector<SearchPoint>> 
+    return_search_points( 
+        shared_ptr<std::vector<SearchPoint>> search_points, 
+        RifDockData & rdd, 
+        ProtocolData & pd ) override;
+
+    shared_ptr<std::vector<SearchPointWithRots>> 
+    return_search_point_with_rotss( 
+        shared_ptr<std::vector<SearchPointWithRots>> search_point_with_rotss, 
+        RifDockData & rdd, 
+        ProtocolData & pd ) override;
+
+    shared_ptr<std::vector<RifDockResult>> 
+    return_rif_dock_results( 
+        shared_ptr<std::vector<RifDockResult>> rif_dock_results, 
+        RifDockData & rdd, 
+        ProtocolData & pd ) override;
+
+private:
+    template<class AnyPoint>
+    shared_ptr<std::vector<AnyPoint>>
+    return_any_points( 
+        shared_ptr<std::vector<AnyPoint>> any_points, 
+        RifDockData & rdd, 
+        ProtocolData & pd ); // override
+
+};
+
 struct HSearchInit : public SearchPointTask {
 
     HSearchInit() {}
@@ -71,17 +108,34 @@ struct HSearchInit : public SearchPointTask {
         RifDockData & rdd, 
         ProtocolData & pd ) override;
 
+    // sets up the tables of pd.unique_scaffolds again
+    void
+    restore_state( RifDockData & rdd, ProtocolData & pd ) override;
+
+private:
+    void
+    setup_scaffolds_( RifDockData & rdd, ProtocolData & pd );
+
 };
 
 struct HSearchScoreAtReslTask : public SearchPointTask {
 
+    // survivor_cut only applies to implicit children, those scoring at or above
+    //  it are dropped as they are scored. beam_keep is the num_to_keep of the
+    //  HSearchFilterSortTask after this one, 0 if it keeps everything. With
+    //  -hsearch_bound_slack_scale, parents are expanded best first and those
+    //  that can't put a child in that beam are skipped, see ParentBound
     HSearchScoreAtReslTask(
         int director_resl,
         int rif_resl,
-        float tether_to_input_position_cut ) :
+        float tether_to_input_position_cut,
+        float survivor_cut = std::numeric_limits<float>::infinity(),
+        uint64_t beam_keep = 0 ) :
         director_resl_( director_resl ),
         rif_resl_( rif_resl ),
-        tether_to_input_position_cut_( tether_to_input_position_cut )
+        tether_to_input_position_cut_( tether_to_input_position_cut ),
+        survivor_cut_( survivor_cut ),
+        beam_keep_( beam_keep )
         {}
 
     shared_ptr<std::vector<SearchPoint>> 
@@ -94,6 +148,8 @@ private:
     int director_resl_;
     int rif_resl_;
     float tether_to_input_position_cut_;
+    float survivor_cut_;
+    uint64_t beam_keep_;
 
 };
 
@@ -126,16 +182,20 @@ private:
 
 struct HSearchScaleToReslTask : public SearchPointTask {
 
+    // with implicit_children, only the parents under global_score_cut are kept
+    //  and the next HSearchScoreAtReslTask makes their children as it scores them
     HSearchScaleToReslTask(
         int current_resl,
         int target_resl,
         int DIMPOW2,
-        float global_score_cut
+        float global_score_cut,
+        bool implicit_children = false
          ) :
         current_resl_( current_resl ),
         target_resl_( target_resl ),
         DIMPOW2_( DIMPOW2 ),
-        global_score_cut_( global_score_cut )
+        global_score_cut_( global_score_cut ),
+        implicit_children_( implicit_children )
         {}
 
     shared_ptr<std::vector<SearchPoint>> 
@@ -149,6 +209,7 @@ private:
     int target_resl_;
     int DIMPOW2_;
     float global_score_cut_;
+    bool implicit_children_;
 
 };
 
@@ -206,6 +267,18 @@ private:
 };
 
 
+// With -hsearch_n_shards, the coordinator publishes this once it is done
+//  with a scaffold, so workers waiting for a stage it never reached move on
+std::string
+hsearch_shards_done_name( int iscaff );
+
+// Removes the HSearch messages of a scaffold: its points, children and the
+//  scores of every shard, at each of nresl stages. For the coordinator once
+//  it is done with the scaffold
+void
+hsearch_shards_remove_scaffold( ::scheme::util::ShardExchange const & shards, int iscaff, int nresl );
+
+
 }}
 
 #endif
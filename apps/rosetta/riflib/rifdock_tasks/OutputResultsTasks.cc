@@ -15,6 +15,7 @@
 #include <riflib/rifdock_tasks/HackPackTasks.hh>
 #include <riflib/ScoreRotamerVsTarget.hh>
 #include <riflib/RifFactory.hh>
+#include <riflib/OutputWriter.hh>
 
 #include <core/chemical/ChemicalManager.hh>
 #include <core/chemical/ResidueTypeSet.hh>
@@ -432,29 +433,46 @@ dump_rif_result_(
     rdd.scaffold_provider->modify_pose_for_output(si, pose_to_dump);
 
 
-    // Dump the main output
-    utility::io::ozstream out1( pdboutfile );
-    out1 << expdb.str() << std::endl;
-    pose_to_dump.dump_pdb(out1);
-    if ( rdd.opt.dump_all_rif_rots_into_output ) {
-        if ( rdd.opt.rif_rots_as_chains ) out1 << "TER" << endl;
-        out1 << allout.str();
-    }
-    out1.close();
+    // The files are written by rdd.output_writer if there is one, so the job
+    //  gets its own copy of the pose and of the text that goes with it
+    core::pose::PoseOP pose_out = make_shared<core::pose::Pose>( pose_to_dump );
+    std::string const expdb_str = expdb.str();
+    std::string const resfile_str = resfile.str();
+    std::string const allout_str = allout.str();
+    bool const all_rif_rots_into_output = rdd.opt.dump_all_rif_rots_into_output;
+    bool const rif_rots_as_chains = rdd.opt.rif_rots_as_chains;
+    bool const dump_resfile = rdd.opt.dump_resfile;
+    bool const dump_all_rif_rots = rdd.opt.dump_all_rif_rots;
+
+    OutputWriter::Job write_files = [=]() {
+
+        // Dump the main output
+        utility::io::ozstream out1( pdboutfile );
+        out1 << expdb_str << std::endl;
+        pose_out->dump_pdb(out1);
+        if ( all_rif_rots_into_output ) {
+            if ( rif_rots_as_chains ) out1 << "TER" << endl;
+            out1 << allout_str;
+        }
+        out1.close();
 
-    // Dump a resfile
-    if( rdd.opt.dump_resfile ){
-        utility::io::ozstream out1res( resfileoutfile );
-        out1res << resfile.str();
-        out1res.close();
-    }
+        // Dump a resfile
+        if( dump_resfile ){
+            utility::io::ozstream out1res( resfileoutfile );
+            out1res << resfile_str;
+            out1res.close();
+        }
 
-    // Dump the rif rots
-    if( rdd.opt.dump_all_rif_rots ){
-        utility::io::ozstream out2( allrifrotsoutfile );
-        out2 << allout.str();
-        out2.close();
-    }
+        // Dump the rif rots
+        if( dump_all_rif_rots ){
+            utility::io::ozstream out2( allrifrotsoutfile );
+            out2 << allout_str;
+            out2.close();
+        }
+    };
+
+    if ( rdd.output_writer ) rdd.output_writer->submit( write_files, pdboutfile );
+    else write_files();
 
 
 }
@@ -44,6 +44,11 @@ SetFaModeTask::return_rif_dock_results(
     return return_any_points( rif_dock_results, rdd, pd );
 }
 
+void
+SetFaModeTask::restore_state( RifDockData & rdd, ProtocolData & pd ) {
+    global_set_fa_mode( fa_mode_, rdd );
+}
+
 template<class AnyPoint>
 shared_ptr<std::vector<AnyPoint>>
 SetFaModeTask::return_any_points( 
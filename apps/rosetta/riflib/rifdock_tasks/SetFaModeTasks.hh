@@ -47,6 +47,9 @@ struct SetFaModeTask : public AnyPointTask {
         RifDockData & rdd, 
         ProtocolData & pd ) override;
 
+    void
+    restore_state( RifDockData & rdd, ProtocolData & pd ) override;
+
 private:
     template<class AnyPoint>
     shared_ptr<std::vector<AnyPoint>>
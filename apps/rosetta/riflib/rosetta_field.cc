@@ -33,6 +33,7 @@
 
 	#include <Eigen/Dense>
 
+	#include <algorithm>
 	#include <exception>
 	#include <stdexcept>
 
@@ -527,6 +528,62 @@ get_rosetta_bounding_fields_from_fba(
 
 }
 
+size_t
+compact_bounding_fields(
+	std::vector< std::vector< ::scheme::objective::voxel::VoxelArray<3,float,float> * > > & bounding_by_atype,
+	std::vector< ::scheme::objective::voxel::VoxelArray<3,float,float> * > const & keep_float,
+	::scheme::objective::voxel::CompactVoxelArray::Precision precision,
+	std::vector< std::vector< ::scheme::objective::voxel::CompactVoxelArray * > > & compact_by_atype
+){
+	typedef ::scheme::objective::voxel::VoxelArray<3,float,float> VoxelArray;
+	typedef ::scheme::objective::voxel::CompactVoxelArray CompactVoxelArray;
+
+	// the same grid can be in several slots, convert each once
+	std::vector< VoxelArray * > grids;
+	for( auto const & v : bounding_by_atype ) for( VoxelArray * gp : v ) if( gp ) grids.push_back( gp );
+	std::sort( grids.begin(), grids.end() );
+	grids.erase( std::unique( grids.begin(), grids.end() ), grids.end() );
+
+	std::vector< CompactVoxelArray * > compact( grids.size(), nullptr );
+	std::exception_ptr exception = nullptr;
+	#ifdef USE_OPENMP
+	#pragma omp parallel for schedule(dynamic,1)
+	#endif
+	for( int i = 0; i < grids.size(); ++i ){
+		if( exception ) continue;
+		try {
+			compact[i] = new CompactVoxelArray( *grids[i], precision );
+		} catch( ... ) {
+			#ifdef USE_OPENMP
+			#pragma omp critical
+			#endif
+			exception = std::current_exception();
+		}
+	}
+	if( exception ) std::rethrow_exception(exception);
+
+	compact_by_atype.resize( bounding_by_atype.size() );
+	for( int iresl = 0; iresl < bounding_by_atype.size(); ++iresl ){
+		compact_by_atype[iresl].resize( bounding_by_atype[iresl].size(), nullptr );
+		for( int itype = 0; itype < bounding_by_atype[iresl].size(); ++itype ){
+			VoxelArray * gp = bounding_by_atype[iresl][itype];
+			if( !gp ) continue;
+			compact_by_atype[iresl][itype] = compact[ std::lower_bound( grids.begin(), grids.end(), gp ) - grids.begin() ];
+		}
+	}
+
+	size_t freed = 0, compact_bytes = 0;
+	for( int i = 0; i < grids.size(); ++i ){
+		compact_bytes += compact[i]->mem_use();
+		if( std::find( keep_float.begin(), keep_float.end(), grids[i] ) != keep_float.end() ) continue;
+		freed += grids[i]->num_elements() * sizeof(float);
+		grids[i]->resize( boost::extents[0][0][0] ); // at() is 0 everywhere now
+	}
+	std::cout << "compact_bounding_fields: " << grids.size() << " grids, released " << KMGT(freed)
+	          << " of float grids, compact grids use " << KMGT(compact_bytes) << std::endl;
+	return freed;
+}
+
 
 }}
 
@@ -14,6 +14,7 @@
 #include <utility/vector1.hh>
 #include <scheme/actor/Atom.hh>
 #include "scheme/objective/voxel/VoxelArray.hh"
+#include "scheme/objective/voxel/CompactVoxelArray.hh"
 #include <vector>
 #include <core/types.hh>
 #include <core/id/AtomID.hh>
@@ -103,6 +104,17 @@ get_rosetta_bounding_fields_from_fba(
 	std::vector<bool> only_load_these = std::vector<bool>(0)
 );
 
+// converts bounding grids to the compact format, in compact_by_atype with
+// the same layout. storage of the float grids is released except for those in
+// keep_float, which other code still reads. returns bytes freed
+size_t
+compact_bounding_fields(
+	std::vector< std::vector< ::scheme::objective::voxel::VoxelArray<3,float,float> * > > & bounding_by_atype,
+	std::vector< ::scheme::objective::voxel::VoxelArray<3,float,float> * > const & keep_float,
+	::scheme::objective::voxel::CompactVoxelArray::Precision precision,
+	std::vector< std::vector< ::scheme::objective::voxel::CompactVoxelArray * > > & compact_by_atype
+);
+
 void
 get_scheme_atoms(
 	core::pose::Pose const & target,
@@ -52,7 +52,9 @@
 
 #include <boost/multi_array.hpp>
 
+#include <cstring>
 #include <exception>
+#include <sstream>
 #include <stdexcept>
 
 namespace devel {
@@ -61,6 +63,124 @@ namespace scheme {
 using ObjexxFCL::format::I;
 using ObjexxFCL::format::F;
 
+// bump these when the way the tables are computed changes, old cache files then miss
+static std::string const ONEBODY_CACHE_KIND = "rifdock_1BE_v1";
+static std::string const TWOBODY_CACHE_KIND = "rifdock_2BE_v1";
+
+static void
+add_pose_to_cache_key( ::scheme::util::ContentHash & key, core::pose::Pose const & pose ){
+	key.add_pod( (uint64_t)pose.size() );
+	for( core::Size ir = 1; ir <= pose.size(); ++ir ){
+		core::conformation::Residue const & res = pose.residue(ir);
+		key.add( res.name() );
+		key.add_pod( (uint64_t)res.natoms() );
+		for( core::Size ia = 1; ia <= res.natoms(); ++ia ){
+			double const xyz[3] = { res.xyz(ia).x(), res.xyz(ia).y(), res.xyz(ia).z() };
+			key.add( xyz, sizeof(xyz) );
+		}
+	}
+}
+
+static void
+add_rot_index_to_cache_key( ::scheme::util::ContentHash & key, devel::scheme::RotamerIndex const & rot_index ){
+	key.add_pod( (uint64_t)rot_index.size() );
+	for( size_t irot = 0; irot < rot_index.size(); ++irot ){
+		key.add( rot_index.resname(irot) );
+		key.add_pod( (uint64_t)rot_index.nprotonchi(irot) );
+		key.add_pod( (uint64_t)rot_index.nchi(irot) );
+		for( size_t ichi = 0; ichi < rot_index.nchi(irot); ++ichi ) key.add_pod( rot_index.chi(irot,ichi) );
+	}
+}
+
+// the scorefunction from the command line, as compute_onebody_rotamer_energies uses it
+static void
+add_score_function_to_cache_key( ::scheme::util::ContentHash & key ){
+	core::scoring::ScoreFunctionOP score_func = core::scoring::get_score_function();
+	key.add( score_func->get_name() );
+	for( int st = 1; st < core::scoring::n_score_types; ++st ){
+		key.add_pod( (double)score_func->get_weight( core::scoring::ScoreType(st) ) );
+	}
+}
+
+::scheme::util::ContentHash
+onebody_energies_cache_key(
+	core::pose::Pose const & scaffold,
+	utility::vector1<core::Size> const & scaffold_res,
+	devel::scheme::RotamerIndex const & rot_index,
+	bool replace_with_ala
+){
+	::scheme::util::ContentHash key;
+	key.add( ONEBODY_CACHE_KIND );
+	add_pose_to_cache_key( key, scaffold );
+	key.add_pod( (uint64_t)scaffold_res.size() );
+	for( core::Size ir : scaffold_res ) key.add_pod( (uint64_t)ir );
+	add_rot_index_to_cache_key( key, rot_index );
+	add_score_function_to_cache_key( key );
+	key.add_pod( replace_with_ala );
+	return key;
+}
+
+::scheme::util::ContentHash
+twobody_tables_cache_key(
+	core::pose::Pose const & scaffold,
+	devel::scheme::RotamerIndex const & rot_index,
+	std::vector<std::vector<float> > const & onebody_energies,
+	RotamerRFTablesManager const & rotrfmanager,
+	MakeTwobodyOpts const & opts
+){
+	::scheme::util::ContentHash key;
+	key.add( TWOBODY_CACHE_KIND );
+	add_pose_to_cache_key( key, scaffold );
+	add_rot_index_to_cache_key( key, rot_index );
+	add_score_function_to_cache_key( key );
+	key.add_pod( (uint64_t)onebody_energies.size() );
+	for( auto const & row : onebody_energies ){
+		key.add_pod( (uint64_t)row.size() );
+		if( row.size() ) key.add( &row[0], row.size()*sizeof(float) );
+	}
+	key.add_pod( rotrfmanager.opts_.oversample );
+	key.add_pod( rotrfmanager.opts_.field_resl );
+	key.add_pod( rotrfmanager.opts_.field_spread );
+	key.add_pod( rotrfmanager.opts_.scale_atr );
+	key.add_pod( opts.onebody_threshold );
+	key.add_pod( opts.distance_cut );
+	key.add_pod( opts.hbond_weight );
+	return key;
+}
+
+// first file on path that is a complete cache file for kind and key
+static std::string
+open_flat_cache_on_path(
+	std::vector<std::string> const & cachepath,
+	std::string const & cachefile,
+	std::string const & kind,
+	::scheme::util::ContentHash const & key,
+	::scheme::util::FlatCacheFile & flat
+){
+	for( auto const & dir : cachepath ){
+		if( flat.open( dir+"/"+cachefile, kind, key ) ) return dir+"/"+cachefile;
+	}
+	return std::string();
+}
+
+// like open_for_write_on_path, the first directory the file can be written to
+static std::string
+save_flat_cache_on_path(
+	std::vector<std::string> const & cachepath,
+	std::string const & cachefile,
+	std::string const & kind,
+	::scheme::util::ContentHash const & key,
+	std::string const & payload
+){
+	for( auto const & dir : cachepath ){
+		if( !utility::file::file_exists( dir ) ) utility::file::create_directory_recursive( dir );
+		if( utility::file::file_exists( dir ) && ::scheme::util::save_flat_cache( dir+"/"+cachefile, kind, key, payload ) ){
+			return dir+"/"+cachefile;
+		}
+	}
+	return std::string();
+}
+
 void get_onebody_rotamer_energies(
 	core::pose::Pose const & scaffold,
 	utility::vector1<core::Size> const & scaffold_res,
@@ -71,11 +191,30 @@ void get_onebody_rotamer_energies(
 	bool replace_with_ala,
 	float favorable_1be_multiplier,
 	float favorable_1be_cutoff,
-	std::shared_ptr< std::vector< std::vector<float> > > extra_scores_p
+	std::shared_ptr< std::vector< std::vector<float> > > extra_scores_p,
+	::scheme::util::ContentHash const * flat_cache_key
 ){
+	::scheme::util::FlatCacheFile flat;
+	std::string flat_found;
+	if( flat_cache_key && cachefile.size() ){
+		flat_found = open_flat_cache_on_path( cachepath, cachefile, ONEBODY_CACHE_KIND, *flat_cache_key, flat );
+	}
 	utility::io::izstream in;
-	std::string cachefile_found = devel::scheme::open_for_read_on_path( cachepath, cachefile, in );
-	if( cachefile.size() && cachefile_found.size() ){
+	std::string cachefile_found;
+	if( !flat_cache_key ) cachefile_found = devel::scheme::open_for_read_on_path( cachepath, cachefile, in );
+	if( flat_found.size() ){
+		std::cout << "reading onebody energies from: " << flat_found << std::endl;
+		uint64_t s1, s2;
+		runtime_assert( flat.size() >= 2*sizeof(uint64_t) );
+		std::memcpy( &s1, flat.data(), sizeof(uint64_t) );
+		std::memcpy( &s2, flat.data()+sizeof(uint64_t), sizeof(uint64_t) );
+		runtime_assert_msg( flat.size() == 2*sizeof(uint64_t) + s1*s2*sizeof(float), "bad onebody cache file: "+flat_found );
+		scaffold_onebody_rotamer_energies.resize( s1, std::vector<float>(s2) );
+		char const * p = flat.data() + 2*sizeof(uint64_t);
+		for( size_t i = 0; i < s1; ++i ){
+			std::memcpy( &scaffold_onebody_rotamer_energies[i][0], p + i*s2*sizeof(float), s2*sizeof(float) );
+		}
+	} else if( !flat_cache_key && cachefile.size() && cachefile_found.size() ){
 		std::cout << "reading onebody energies from: " << cachefile << std::endl;
 		// utility::io::izstream in( cachefile );
 		size_t s1,s2;
@@ -106,7 +245,21 @@ void get_onebody_rotamer_energies(
 		);
 
 
-		if( cachefile.size() ){
+		if( cachefile.size() && flat_cache_key ){
+			uint64_t const s1 = scaffold_onebody_rotamer_energies.size();
+			uint64_t const s2 = scaffold_onebody_rotamer_energies.front().size();
+			std::string payload( 2*sizeof(uint64_t) + s1*s2*sizeof(float), 0 );
+			std::memcpy( &payload[0], &s1, sizeof(uint64_t) );
+			std::memcpy( &payload[sizeof(uint64_t)], &s2, sizeof(uint64_t) );
+			for( size_t i = 0; i < s1; ++i ){
+				runtime_assert( scaffold_onebody_rotamer_energies[i].size() == s2 );
+				std::memcpy( &payload[2*sizeof(uint64_t) + i*s2*sizeof(float)], &scaffold_onebody_rotamer_energies[i][0], s2*sizeof(float) );
+			}
+			// the cache is only an optimization, a cache dir we can't write to shouldn't kill the scaffold
+			std::string writefile = save_flat_cache_on_path( cachepath, cachefile, ONEBODY_CACHE_KIND, *flat_cache_key, payload );
+			if( writefile.size() ) std::cout << "saving onebody energies to: " << writefile << std::endl;
+			else std::cout << "WARNING: failed to save onebody energies cache " << cachefile << std::endl;
+		} else if( cachefile.size() ){
 			std::cout << "saving onebody energies to: " << cachefile << std::endl;
 			utility::io::ozstream out;//( cachefile );
 			std::string writefile = open_for_write_on_path( cachepath, cachefile, out, true );
@@ -571,6 +724,68 @@ void get_per_rotamer_rf_tables(
 
 
 
+// geometry of one rotamer used by make_twobody_tables, in the rotamer's frame
+struct TwobodyRotamerGeom {
+	Eigen::Matrix3Xf atoms; // heavy atoms beyond the CB, one per column
+	std::vector<int> atypes;
+	Eigen::Vector3f cen; // bounding sphere of atoms, donor horb_cens and acceptor Os
+	float rad;
+};
+
+static void
+get_twobody_rotamer_geom( devel::scheme::RotamerIndex const & rot_index, std::vector<TwobodyRotamerGeom> & geom )
+{
+	geom.resize( rot_index.size() );
+	for( int irot = 0; irot < rot_index.size(); ++irot ){
+		TwobodyRotamerGeom & g = geom[irot];
+		auto const & rot = rot_index.rotamers_[irot];
+		int const natoms = std::max( 0, (int)rot_index.nheavyatoms(irot) - 4 ); // use only heavy atoms beyond the CB (which is #3 here)
+		g.atoms.resize( 3, natoms );
+		g.atypes.resize( natoms );
+		std::vector<Eigen::Vector3f> pts;
+		for( int ia = 0; ia < natoms; ++ia ){
+			g.atoms.col(ia) = rot.atoms_[ia+4].position();
+			g.atypes[ia] = rot.atoms_[ia+4].type();
+			pts.push_back( g.atoms.col(ia) );
+		}
+		for( auto const & don : rot.donors_ ) pts.push_back( don.horb_cen );
+		for( auto const & acc : rot.acceptors_ ) pts.push_back( acc.horb_cen - acc.direction*::scheme::chemical::ORBLEN );
+		g.cen.setZero();
+		for( auto const & p : pts ) g.cen += p;
+		if( pts.size() ) g.cen /= pts.size();
+		g.rad = 0;
+		for( auto const & p : pts ) g.rad = std::max( g.rad, (p-g.cen).norm() );
+	}
+}
+
+// box outside of which all of a rotamer's rf tables are zero. VoxelArray::at
+// truncates toward zero, so pad by two cells
+template< class Fields >
+static void
+get_rotamer_rf_tables_bounds( Fields const & fields, Eigen::Vector3f & lb, Eigen::Vector3f & ub )
+{
+	lb.setConstant( 9e9 );
+	ub.setConstant( -9e9 );
+	for( int itype = 1; itype < fields.size(); ++itype ){
+		if( !fields[itype] ) continue;
+		for( int k = 0; k < 3; ++k ){
+			lb[k] = std::min( lb[k], fields[itype]->lb_[k] - 2.0f*fields[itype]->cs_[k] );
+			ub[k] = std::max( ub[k], fields[itype]->ub_[k] + 2.0f*fields[itype]->cs_[k] );
+		}
+	}
+}
+
+static bool
+sphere_hits_box( Eigen::Vector3f const & cen, float rad, Eigen::Vector3f const & lb, Eigen::Vector3f const & ub )
+{
+	float dis2 = 0;
+	for( int k = 0; k < 3; ++k ){
+		float const d = std::max( 0.0f, std::max( lb[k] - cen[k], cen[k] - ub[k] ) );
+		dis2 += d*d;
+	}
+	return dis2 <= rad*rad;
+}
+
 void
 make_twobody_tables(
 	core::pose::Pose const & scaffold,
@@ -613,150 +828,180 @@ make_twobody_tables(
 
 	double const dthresh2 = opts.distance_cut * opts.distance_cut;
 
+	// neighbor list of protein residue pairs with CA within distance_cut
+	std::vector<EigenXform> bbpos( scaffold.size() );
+	std::vector< std::pair<int,int> > pairs;
+	for( int ir = 0; ir < scaffold.size(); ++ir ){
+		if( !scaffold.residue(ir+1).is_protein() ) continue;
+		bbpos[ir] = BackboneActor( scaffold.residue(ir+1).xyz("N"), scaffold.residue(ir+1).xyz("CA"), scaffold.residue(ir+1).xyz("C") ).position();
+		for( int jr = 0; jr < ir; ++jr ){
+			if( !scaffold.residue(jr+1).is_protein() ) continue;
+			double dis2 = scaffold.residue(ir+1).xyz("CA").distance_squared( scaffold.residue(jr+1).xyz("CA") );
+			if( dis2 > dthresh2 ) continue;
+			pairs.push_back( std::make_pair( ir, jr ) );
+		}
+	}
+
+	std::vector<TwobodyRotamerGeom> geom;
+	get_twobody_rotamer_geom( rot_index, geom );
+	// hbond rays score zero past this distance, see score_hbond_rays
+	float const hbond_max_dis = 2.8f + 0.01f;
+
 	std::exception_ptr exception = nullptr;
 	#ifdef USE_OPENMP
 	#pragma omp parallel for schedule(dynamic,1)
 	#endif
-	for( int ir = 0; ir < scaffold.size(); ++ir ){
+	for( int ipair = 0; ipair < pairs.size(); ++ipair ){
 		if( exception ) continue;
 		try {
-			if( !scaffold.residue(ir+1).is_protein() ) continue;
-			BackboneActor bbi( scaffold.residue(ir+1).xyz("N"), scaffold.residue(ir+1).xyz("CA"), scaffold.residue(ir+1).xyz("C") );
+			int const ir = pairs[ipair].first;
+			int const jr = pairs[ipair].second;
 
 			// #ifdef USE_OPENMP
 			// #pragma omp critical
 			// #endif
 			// std::cout << "compute twobody for ir-* " << ir << std::endl;
 
-			for( int jr = 0; jr < ir; ++jr ){
-				if( !scaffold.residue(jr+1).is_protein() ) continue;
-
-				double dis2 = scaffold.residue(ir+1).xyz("CA").distance_squared( scaffold.residue(jr+1).xyz("CA") );
-				// double dthr = scaffold.residue(ir).nbr_radius() +                   scaffold.residue(jr+1).nbr_radius();
-
-				if( dis2 > dthresh2 ){
-					// twob.clear_twobody(ir,jr); // no need
-					continue;
+			twob.init_twobody(ir,jr);
+
+			EigenXform X2i = bbpos[ir].inverse() * bbpos[jr];
+			EigenXform X2j = bbpos[jr].inverse() * bbpos[ir];
+			auto const & to_sp( rot_index.to_structural_parent_frame_ );
+
+			// per selected rotamer of each residue: frame of the other residue's
+			// atoms in this rotamer's rf tables, and the bounds of those tables
+			std::vector<EigenXform> xi( twob.nsel_[ir] ), xj( twob.nsel_[jr] );
+			std::vector<Eigen::Vector3f> lbi( twob.nsel_[ir] ), ubi( twob.nsel_[ir] ), lbj( twob.nsel_[jr] ), ubj( twob.nsel_[jr] );
+			std::vector<char> havei( twob.nsel_[ir], 0 ), havej( twob.nsel_[jr], 0 );
+			for( int irotsel = 0; irotsel < twob.nsel_[ir]; ++irotsel ) xi[irotsel] = to_sp.at( twob.sel2all_[ir][irotsel] ) * X2i;
+			for( int jrotsel = 0; jrotsel < twob.nsel_[jr]; ++jrotsel ) xj[jrotsel] = to_sp.at( twob.sel2all_[jr][jrotsel] ) * X2j;
+			Eigen::Matrix3Xf pos;
+			std::vector<HBondRay> irot_acceptors, irot_donors;
+
+			float minscore=9e9, maxscore=-9e9;
+			std::vector<int> randirotsel( twob.nsel_[ir] );
+			for( int q=0; q<randirotsel.size(); ++q ) randirotsel[q] = randirotsel.size()-1-q;
+			// this is fucked somehow... random would be better, reversed helps some
+			// random_permutation( randirotsel, numeric::random::rg() );
+			for( int irotsel_irand = 0; irotsel_irand < twob.nsel_[ir]; ++irotsel_irand ){
+				int irotsel = randirotsel[ irotsel_irand ];
+				int irot = twob.sel2all_[ir][irotsel];
+				runtime_assert( irot >= 0 );
+
+				// irot hbond rays in the frame of jr
+				irot_acceptors = rot_index.rotamer(irot).acceptors_;
+				irot_donors    = rot_index.rotamer(irot).donors_;
+				for( HBondRay & hr : irot_acceptors ){
+					Eigen::Vector3f dirpos = hr.horb_cen + hr.direction;
+					hr.horb_cen  = X2j * hr.horb_cen;
+					hr.direction = X2j * dirpos - hr.horb_cen;
 				}
-
-				BackboneActor bbj( scaffold.residue(jr+1).xyz("N"), scaffold.residue(jr+1).xyz("CA"), scaffold.residue(jr+1).xyz("C") );
-
-				twob.init_twobody(ir,jr);
-
-				EigenXform X2i = bbi.position().inverse() * bbj.position();
-				EigenXform X2j = bbj.position().inverse() * bbi.position();
-				auto const & to_sp( rot_index.to_structural_parent_frame_ );
-
-				float minscore=9e9, maxscore=-9e9;
-				std::vector<int> randirotsel( twob.nsel_[ir] );
-				for( int q=0; q<randirotsel.size(); ++q ) randirotsel[q] = randirotsel.size()-1-q;
-				// this is fucked somehow... random would be better, reversed helps some
-				// random_permutation( randirotsel, numeric::random::rg() );
-				for( int irotsel_irand = 0; irotsel_irand < twob.nsel_[ir]; ++irotsel_irand ){
-					int irotsel = randirotsel[ irotsel_irand ];
-					int irot = twob.sel2all_[ir][irotsel];
-					runtime_assert( irot >= 0 );
-					for( int jrotsel = 0; jrotsel < twob.nsel_[jr]; ++jrotsel ){
-						int jrot = twob.sel2all_[jr][jrotsel];
-						runtime_assert( jrot >= 0 );
-
-						twob.twobody_[ir][jr][irotsel][jrotsel] = 0.0; // set to 0
-
-						// get lj, sol
-						if( rot_index.nheavyatoms(irot) > rot_index.nheavyatoms(jrot) ){ // irot is bigger
-							if( rotrfmanager.get_rotamer_rf_tables(irot)[ 1 ] ){
-								for( int ja = 4; ja < rot_index.nheavyatoms(jrot); ++ja ){ // use only heavy atoms beyond the CB (which is #3 here)
-									int jatype = rot_index.rotamers_[ jrot ].atoms_[ja].type();
+				for( HBondRay & hr : irot_donors ){
+					Eigen::Vector3f dirpos = hr.horb_cen + hr.direction;
+					hr.horb_cen  = X2j * hr.horb_cen;
+					hr.direction = X2j * dirpos - hr.horb_cen;
+				}
+				Eigen::Vector3f const irot_cen_in_j = X2j * geom[irot].cen;
+
+				for( int jrotsel = 0; jrotsel < twob.nsel_[jr]; ++jrotsel ){
+					int jrot = twob.sel2all_[jr][jrotsel];
+					runtime_assert( jrot >= 0 );
+
+					float score = 0.0;
+
+					// get lj, sol
+					// the smaller rotamer's atoms are looked up in the bigger one's rf tables,
+					// skipping pairs where they can't reach the tables
+					if( rot_index.nheavyatoms(irot) > rot_index.nheavyatoms(jrot) ){ // irot is bigger
+						auto const & fields = rotrfmanager.get_rotamer_rf_tables(irot);
+						if( fields[ 1 ] ){
+							if( !havei[irotsel] ){
+								get_rotamer_rf_tables_bounds( fields, lbi[irotsel], ubi[irotsel] );
+								havei[irotsel] = 1;
+							}
+							TwobodyRotamerGeom const & g = geom[jrot];
+							if( g.atoms.cols() && sphere_hits_box( xi[irotsel] * g.cen, g.rad, lbi[irotsel], ubi[irotsel] ) ){
+								pos.noalias() = xi[irotsel].linear() * g.atoms;
+								pos.colwise() += xi[irotsel].translation();
+								for( int ja = 0; ja < g.atoms.cols(); ++ja ){
+									int jatype = g.atypes[ja];
 									runtime_assert( jatype > 0 && jatype < 22 );
-									Eigen::Vector3f pos_ja = to_sp.at(irot) * X2i * rot_index.rotamers_[ jrot ].atoms_[ja].position();
-									// runtime_assert( rotrfmanager.get_rotamer_rf_tables(irot).size() );
-									float const atomscore = rotrfmanager.get_rotamer_rf_tables(irot).at( jatype )->at( pos_ja );
+									float const atomscore = fields[ jatype ]->at( pos.col(ja) );
 									runtime_assert_msg( atomscore < 9999.0, "very high atomscore" );
-									twob.twobody_[ir][jr][irotsel][jrotsel] += atomscore;
-								}
-							} else {
-								if( rot_index.resname(irot)!="ALA"&&rot_index.resname(irot)!="GLY" && rot_index.resname(irot)!="DAL"){
-									utility_exit_with_message( "no rotrf table for "+str(irot)+" / "+ str(ir)+rot_index.resname(irot)
-									    + " other is" + str(jr)+rot_index.resname(jrot) );
+									score += atomscore;
 								}
 							}
 						} else {
-							if( rotrfmanager.get_rotamer_rf_tables(jrot)[ 1 ] ){
-								for( int ia = 4; ia < rot_index.nheavyatoms(irot); ++ia ){ // use only heavy atoms beyond the CB (which is #3 here)
-									int iatype = rot_index.rotamers_[ irot ].atoms_[ia].type();
+							if( rot_index.resname(irot)!="ALA"&&rot_index.resname(irot)!="GLY" && rot_index.resname(irot)!="DAL"){
+								utility_exit_with_message( "no rotrf table for "+str(irot)+" / "+ str(ir)+rot_index.resname(irot)
+								    + " other is" + str(jr)+rot_index.resname(jrot) );
+							}
+						}
+					} else {
+						auto const & fields = rotrfmanager.get_rotamer_rf_tables(jrot);
+						if( fields[ 1 ] ){
+							if( !havej[jrotsel] ){
+								get_rotamer_rf_tables_bounds( fields, lbj[jrotsel], ubj[jrotsel] );
+								havej[jrotsel] = 1;
+							}
+							TwobodyRotamerGeom const & g = geom[irot];
+							if( g.atoms.cols() && sphere_hits_box( xj[jrotsel] * g.cen, g.rad, lbj[jrotsel], ubj[jrotsel] ) ){
+								pos.noalias() = xj[jrotsel].linear() * g.atoms;
+								pos.colwise() += xj[jrotsel].translation();
+								for( int ia = 0; ia < g.atoms.cols(); ++ia ){
+									int iatype = g.atypes[ia];
 									if( iatype > 21 ){
-										std::cout << iatype << " " << irot << " " << ia << " " << rot_index.rotamers_[irot].atoms_[ia].data().atomname << " "
+										std::cout << iatype << " " << irot << " " << ia+4 << " " << rot_index.rotamers_[irot].atoms_[ia+4].data().atomname << " "
 										          << rot_index.rotamers_[irot].resname_ << " " << rot_index.nheavyatoms(irot) << std::endl;
 									}
 									runtime_assert( iatype > 0 && iatype < 22 );
-									Eigen::Vector3f pos_ia = to_sp.at(jrot) * X2j * rot_index.rotamers_[ irot ].atoms_[ia].position();
-									// runtime_assert( rotrfmanager.get_rotamer_rf_tables(jrot).size() );
-									float const atomscore = rotrfmanager.get_rotamer_rf_tables(jrot).at( iatype )->at( pos_ia );
+									float const atomscore = fields[ iatype ]->at( pos.col(ia) );
 									runtime_assert_msg( atomscore < 9999.0, "very high atomscore" );
-									twob.twobody_[ir][jr][irotsel][jrotsel] += atomscore;
-								}
-							} else {
-								if( rot_index.resname(jrot)!="ALA"&&rot_index.resname(jrot)!="GLY" && rot_index.resname(jrot)!="DAL"){
-									utility_exit_with_message( "no rotrf table for "+str(jrot)+" / "+str(jr)+rot_index.resname(jrot)
-									    + " other is" + str(ir)+rot_index.resname(irot) );
+									score += atomscore;
 								}
 							}
+						} else {
+							if( rot_index.resname(jrot)!="ALA"&&rot_index.resname(jrot)!="GLY" && rot_index.resname(jrot)!="DAL"){
+								utility_exit_with_message( "no rotrf table for "+str(jrot)+" / "+str(jr)+rot_index.resname(jrot)
+								    + " other is" + str(ir)+rot_index.resname(irot) );
+							}
 						}
+					}
 
-						// this is basically a copy of what's in ScoreRotamerVsTarget, without the multidentate stuff
-						if( rot_index.rotamer(irot).acceptors_.size() > 0 ||
-							rot_index.rotamer(irot).donors_   .size() > 0 )
-						{
-							float hbscore = 0.0;
-							for( int i_hr_rot_acc = 0; i_hr_rot_acc < rot_index.rotamer(irot).acceptors_.size(); ++i_hr_rot_acc )
-							{
-								HBondRay hr_rot_acc = rot_index.rotamer(irot).acceptors_[i_hr_rot_acc];
-								Eigen::Vector3f dirpos = hr_rot_acc.horb_cen + hr_rot_acc.direction;
-								hr_rot_acc.horb_cen  = X2j * hr_rot_acc.horb_cen;
-								hr_rot_acc.direction = X2j * dirpos - hr_rot_acc.horb_cen;
-								for( int i_hr_tgt_don = 0; i_hr_tgt_don < rot_index.rotamer(jrot).donors_.size(); ++i_hr_tgt_don )
-								{
-									HBondRay const & hr_tgt_don = rot_index.rotamer(jrot).donors_[i_hr_tgt_don];
-									float const thishb = score_hbond_rays( hr_tgt_don, hr_rot_acc );
-									hbscore += thishb * opts.hbond_weight;
-								}
-							}
-							for( int i_hr_rot_don = 0; i_hr_rot_don < rot_index.rotamer(irot).donors_.size(); ++i_hr_rot_don )
-							{
-								HBondRay hr_rot_don = rot_index.rotamer(irot).donors_[i_hr_rot_don];
-								Eigen::Vector3f dirpos = hr_rot_don.horb_cen + hr_rot_don.direction;
-								hr_rot_don.horb_cen  = X2j * hr_rot_don.horb_cen;
-								hr_rot_don.direction = X2j * dirpos - hr_rot_don.horb_cen;
-								for( int i_hr_tgt_acc = 0; i_hr_tgt_acc < rot_index.rotamer(jrot).acceptors_.size(); ++i_hr_tgt_acc )
-								{
-									HBondRay const & hr_tgt_acc = rot_index.rotamer(jrot).acceptors_[i_hr_tgt_acc];
-									float const thishb = score_hbond_rays( hr_rot_don, hr_tgt_acc );
-									hbscore += thishb * opts.hbond_weight;
-								}
+					// this is basically a copy of what's in ScoreRotamerVsTarget, without the multidentate stuff
+					if( ( irot_acceptors.size() > 0 || irot_donors.size() > 0 ) &&
+					    ( irot_cen_in_j - geom[jrot].cen ).norm() <= geom[irot].rad + geom[jrot].rad + hbond_max_dis )
+					{
+						float hbscore = 0.0;
+						for( HBondRay const & hr_rot_acc : irot_acceptors ){
+							for( HBondRay const & hr_tgt_don : rot_index.rotamer(jrot).donors_ ){
+								float const thishb = score_hbond_rays( hr_tgt_don, hr_rot_acc );
+								hbscore += thishb * opts.hbond_weight;
 							}
-							twob.twobody_[ir][jr][irotsel][jrotsel] += hbscore;
 						}
-
-
-
-						if( twob.twobody_[ir][jr][irotsel][jrotsel] > 12345.0 ){
-							twob.twobody_[ir][jr][irotsel][jrotsel] = 12345.0;
+						for( HBondRay const & hr_rot_don : irot_donors ){
+							for( HBondRay const & hr_tgt_acc : rot_index.rotamer(jrot).acceptors_ ){
+								float const thishb = score_hbond_rays( hr_rot_don, hr_tgt_acc );
+								hbscore += thishb * opts.hbond_weight;
+							}
 						}
+						score += hbscore;
+					}
 
-						minscore = std::min( minscore, twob.twobody_[ir][jr][irotsel][jrotsel] );
-						maxscore = std::max( maxscore, twob.twobody_[ir][jr][irotsel][jrotsel] );
+					if( score > 12345.0 ){
+						score = 12345.0;
 					}
-				}
+					twob.twobody_[ir][jr][irotsel][jrotsel] = score;
 
-				if( minscore > -0.01 && maxscore < 0.01 ){
-					twob.clear_twobody( ir, jr );
-				} else {
-					// using namespace ObjexxFCL::format;
-					// #pragma omp critical
-					// std::cout << I(3,ir) << " " << I(3,jr) << " " << F(9,1,maxscore) << std::endl;
+					minscore = std::min( minscore, score );
+					maxscore = std::max( maxscore, score );
 				}
+			}
 
+			if( minscore > -0.01 && maxscore < 0.01 ){
+				twob.clear_twobody( ir, jr );
 			}
+
 		} catch( ... ) {
 			#ifdef USE_OPENMP
 			#pragma omp critical
@@ -778,12 +1023,24 @@ get_twobody_tables(
 	std::vector<std::vector<float> > const & onebody_energies,
 	RotamerRFTablesManager & rotrfmanager,
 	MakeTwobodyOpts opts,
-	::scheme::objective::storage::TwoBodyTable<float> & twob
+	::scheme::objective::storage::TwoBodyTable<float> & twob,
+	::scheme::util::ContentHash const * flat_cache_key
 ){
+	::scheme::util::FlatCacheFile flat;
+	std::string flat_found;
+	if( flat_cache_key && cachefile.size() ){
+		flat_found = open_flat_cache_on_path( cachepath, cachefile, TWOBODY_CACHE_KIND, *flat_cache_key, flat );
+	}
 	utility::io::izstream in;
 	std::string cachefile_found;
-	if( cachefile.size() ) cachefile_found = devel::scheme::open_for_read_on_path( cachepath, cachefile, in );
-	if( cachefile.size() && cachefile_found.size() ){
+	if( cachefile.size() && !flat_cache_key ) cachefile_found = devel::scheme::open_for_read_on_path( cachepath, cachefile, in );
+	if( flat_found.size() ){
+		std::cout << "reading twobody energies from: " << flat_found << std::endl;
+		::scheme::util::MemoryStreamBuf buf( flat.data(), flat.size() );
+		std::istream flat_in( &buf );
+		twob.load( flat_in, description );
+		runtime_assert_msg( flat_in.good(), "bad twobody cache file: "+flat_found );
+	} else if( cachefile.size() && cachefile_found.size() ){
 		std::cout << "reading twobody energies from: " << cachefile_found << std::endl;
 		twob.load( in, description );
 		in.close();
@@ -792,10 +1049,20 @@ get_twobody_tables(
 		make_twobody_tables( scaffold, rot_index, onebody_energies, rotrfmanager, opts, twob );
 		if( cachefile.size() ) std::cout << "created twobody energies and saving to: " << cachefile << std::endl;
 		if( description=="" ) description = "No description, Will sucks. Complain to willsheffler@gmail.com\n";
-		utility::io::ozstream out;//( cachefile );
-		devel::scheme::open_for_write_on_path( cachepath, cachefile, out, true );
-		twob.save( out, description );
-		out.close();
+		if( flat_cache_key ){
+			if( cachefile.size() ){
+				std::ostringstream out;
+				twob.save( out, description );
+				if( save_flat_cache_on_path( cachepath, cachefile, TWOBODY_CACHE_KIND, *flat_cache_key, out.str() ).empty() ){
+					std::cout << "WARNING: failed to save twobody energies cache " << cachefile << std::endl;
+				}
+			}
+		} else {
+			utility::io::ozstream out;//( cachefile );
+			devel::scheme::open_for_write_on_path( cachepath, cachefile, out, true );
+			twob.save( out, description );
+			out.close();
+		}
 	}
 
 
@@ -13,6 +13,7 @@
 #include <riflib/RotamerGenerator.hh>
 #include <scheme/objective/storage/TwoBodyTable.hh>
 #include <scheme/objective/voxel/VoxelArray.hh>
+#include <scheme/util/FlatCache.hh>
 namespace devel {
 namespace scheme {
 
@@ -29,7 +30,19 @@ void get_onebody_rotamer_energies(
 	bool replace_with_ala = true,
 	float favorable_1be_multiplier = 1,
 	float favorable_1be_cutoff = 0,
-	std::shared_ptr< std::vector< std::vector<float> > > extra_scores_p = nullptr
+	std::shared_ptr< std::vector< std::vector<float> > > extra_scores_p = nullptr,
+	::scheme::util::ContentHash const * flat_cache_key = nullptr // if set, cachefile is a flat cache file with this key
+);
+
+// Keys for the flat scaffold data cache. They hash everything the tables are
+//  computed from (scaffold coordinates, rotamer index, scoring options), so a
+//  cache file can never be stale, only missing
+::scheme::util::ContentHash
+onebody_energies_cache_key(
+	core::pose::Pose const & scaffold,
+	utility::vector1<core::Size> const & scaffold_res,
+	devel::scheme::RotamerIndex const & rot_index,
+	bool replace_with_ala
 );
 
 void
@@ -191,7 +204,17 @@ get_twobody_tables(
 	std::vector<std::vector<float> > const & onebody_energies,
 	RotamerRFTablesManager & rotrfmanager,
 	MakeTwobodyOpts opts,
-	::scheme::objective::storage::TwoBodyTable<float> & twob
+	::scheme::objective::storage::TwoBodyTable<float> & twob,
+	::scheme::util::ContentHash const * flat_cache_key = nullptr // if set, cachefile is a flat cache file with this key
+);
+
+::scheme::util::ContentHash
+twobody_tables_cache_key(
+	core::pose::Pose const & scaffold,
+	devel::scheme::RotamerIndex const & rot_index,
+	std::vector<std::vector<float> > const & onebody_energies,
+	RotamerRFTablesManager const & rotrfmanager,
+	MakeTwobodyOpts const & opts
 );
 
 
@@ -184,6 +184,7 @@ MorphingScaffoldProvider::test_make_children(TreeIndex ti) {
                     // one-body
                     temp_data_cache_->scaffold_onebody_glob0_p = data_cache->scaffold_onebody_glob0_p;
                     temp_data_cache_->local_onebody_p = data_cache->local_onebody_p;
+                    temp_data_cache_->local_onebody_min_p = data_cache->local_onebody_min_p;
                     // two-body
                     temp_data_cache_->scaffold_twobody_p = data_cache->scaffold_twobody_p;
                     temp_data_cache_->local_twobody_p = data_cache->local_twobody_p;
@@ -271,6 +272,7 @@ MorphingScaffoldProvider::test_make_children(TreeIndex ti) {
                 // one-body
                 temp_data_cache_->scaffold_onebody_glob0_p = data_cache->scaffold_onebody_glob0_p;
                 temp_data_cache_->local_onebody_p = data_cache->local_onebody_p;
+                temp_data_cache_->local_onebody_min_p = data_cache->local_onebody_min_p;
                 // two-body
                 temp_data_cache_->scaffold_twobody_p = data_cache->scaffold_twobody_p;
                 temp_data_cache_->local_twobody_p = data_cache->local_twobody_p;
@@ -388,11 +390,6 @@ void
 MorphingScaffoldProvider::setup_twobody_tables( ::scheme::scaffold::TreeIndex i ) {
     get_data_cache_slow( i )->setup_twobody_tables( rot_index_p, opt, make2bopts, rotrf_table_manager);
 }
-void 
-MorphingScaffoldProvider::setup_twobody_tables_per_thread( ::scheme::scaffold::TreeIndex i ) {
-    get_data_cache_slow( i )->setup_twobody_tables_per_thread( );
-}
-
 
 void 
 MorphingScaffoldProvider::modify_pose_for_output( ::scheme::scaffold::TreeIndex i, core::pose::Pose & pose ) {
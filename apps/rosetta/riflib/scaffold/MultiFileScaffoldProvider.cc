@@ -0,0 +1,113 @@
+// -*- mode:c++;tab-width:2;indent-tabs-mode:t;show-trailing-whitespace:t;rm-trailing-spaces:t -*-
+// vi: set ts=2 noet:
+//
+// (c) Copyright Rosetta Commons Member Institutions.
+// (c) This file is part of the Rosetta software suite and is made available under license.
+// (c) The Rosetta software is developed by the contributing members of the Rosetta Commons.
+// (c) For more information, see http://wsic_dockosettacommons.org. Questions about this casic_dock
+// (c) addressed to University of Waprotocolsgton UW TechTransfer, email: license@u.washington.eprotocols
+
+#include <riflib/scaffold/MultiFileScaffoldProvider.hh>
+#include <riflib/scaffold/util.hh>
+
+#include <riflib/types.hh>
+#include <scheme/numeric/rand_xform.hh>
+#include <core/import_pose/import_pose.hh>
+#include <utility/file/file_sys_util.hh>
+#include <riflib/HSearchConstraints.hh>
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <boost/any.hpp>
+
+
+
+namespace devel {
+namespace scheme {
+
+
+MultiFileScaffoldProvider::MultiFileScaffoldProvider( 
+    uint64_t iscaff_begin,
+    uint64_t num_scaffolds,
+    shared_ptr< RotamerIndex > rot_index_p_in, 
+    RifDockOpt const & opt_in,
+    MakeTwobodyOpts const & make2bopts_in,
+    ::devel::scheme::RotamerRFTablesManager & rotrf_table_manager_in ) :
+
+    rot_index_p( rot_index_p_in), 
+    opt(opt_in),
+    make2bopts(make2bopts_in),
+    rotrf_table_manager(rotrf_table_manager_in) {
+
+    runtime_assert( num_scaffolds > 0 );
+    runtime_assert( num_scaffolds <= std::numeric_limits<uint16_t>::max() );
+
+    for ( uint64_t iscaff = iscaff_begin; iscaff < iscaff_begin + num_scaffolds; iscaff++ ) {
+
+        std::string scafftag;
+        core::pose::Pose scaffold;
+        utility::vector1<core::Size> scaffold_res;
+        EigenXform scaffold_perturb;
+        MorphRules morph_rules;
+        ExtraScaffoldData extra_data;
+
+        get_info_for_iscaff( iscaff, opt, scafftag, scaffold, scaffold_res, scaffold_perturb, morph_rules, extra_data, rot_index_p);
+
+        ScaffoldDataCacheOP temp_data_cache = make_shared<ScaffoldDataCache>(
+            scaffold,
+            scaffold_res,
+            scafftag,
+            scaffold_perturb,
+            rot_index_p,
+            opt,
+            extra_data);
+
+        conformations_.push_back( make_conformation_from_data_cache(temp_data_cache, false) );
+    }
+
+}
+
+
+ScaffoldDataCacheOP 
+MultiFileScaffoldProvider::get_data_cache_slow(::scheme::scaffold::TreeIndex i) {
+
+    return get_scaffold(i)->cache_data_;
+
+}
+
+
+ParametricSceneConformationCOP 
+MultiFileScaffoldProvider::get_scaffold(::scheme::scaffold::TreeIndex i) {
+    if ( i.depth != 0 || i.member >= conformations_.size() ) {
+        utility_exit_with_message("MultiFileScaffoldProvider: scaffold index out of range!!");
+    }
+    return conformations_[i.member];
+}
+
+
+::scheme::scaffold::TreeLimits 
+MultiFileScaffoldProvider::get_scaffold_index_limits() const {
+    return ::scheme::scaffold::TreeLimits(1, conformations_.size());
+}
+
+
+void 
+MultiFileScaffoldProvider::set_fa_mode( bool fa ) {
+    for ( ParametricSceneConformationCOP & conformation : conformations_ ) {
+        ScaffoldDataCacheOP cache = conformation->cache_data_;
+        if ( cache->conformation_is_fa != fa ) {
+            conformation = make_conformation_from_data_cache(cache, fa);
+        }
+    }
+}
+
+void 
+MultiFileScaffoldProvider::setup_twobody_tables( ::scheme::scaffold::TreeIndex i ) {
+    get_data_cache_slow( i )->setup_twobody_tables( rot_index_p, opt, make2bopts, rotrf_table_manager);
+}
+
+
+
+}}
+
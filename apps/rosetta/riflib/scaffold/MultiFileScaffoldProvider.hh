@@ -0,0 +1,74 @@
+// -*- mode:c++;tab-width:2;indent-tabs-mode:t;show-trailing-whitespace:t;rm-trailing-spaces:t -*-
+// vi: set ts=2 noet:
+//
+// (c) Copyright Rosetta Commons Member Institutions.
+// (c) This file is part of the Rosetta software suite and is made available under license.
+// (c) The Rosetta software is developed by the contributing members of the Rosetta Commons.
+// (c) For more information, see http://wsic_dockosettacommons.org. Questions about this casic_dock
+// (c) addressed to University of Waprotocolsgton UW TechTransfer, email: license@u.washington.eprotocols
+
+#ifndef INCLUDED_riflib_scaffold_MultiFileScaffoldProvider_hh
+#define INCLUDED_riflib_scaffold_MultiFileScaffoldProvider_hh
+
+#include <riflib/types.hh>
+#include <riflib/rifdock_typedefs.hh>
+#include <scheme/scaffold/ScaffoldProviderBase.hh>
+#include <riflib/scaffold/ScaffoldDataCache.hh>
+
+#include <string>
+#include <vector>
+#include <boost/any.hpp>
+
+#include <scheme/kinematics/Scene.hh>
+
+#include <core/pose/Pose.hh>
+
+
+namespace devel {
+namespace scheme {
+
+
+
+
+// Loads scaffolds iscaff_begin .. iscaff_begin+num_scaffolds-1 of -scaffolds as
+//  the members of depth 0, TreeIndex(0,i), so that they can be docked together
+//  in one HSearch. Each member behaves exactly like a SingleFileScaffoldProvider.
+struct MultiFileScaffoldProvider :
+    public ::scheme::scaffold::TreeScaffoldProvider<ParametricSceneConformation> {
+
+    MultiFileScaffoldProvider( 
+        uint64_t iscaff_begin,
+        uint64_t num_scaffolds,
+        shared_ptr< RotamerIndex > rot_index_p_in, 
+        RifDockOpt const & opt_in,
+        MakeTwobodyOpts const & make2bopts_in,
+        ::devel::scheme::RotamerRFTablesManager & rotrf_table_manager_in );
+
+
+    ParametricSceneConformationCOP get_scaffold(::scheme::scaffold::TreeIndex i) override;
+
+    ::scheme::scaffold::TreeLimits get_scaffold_index_limits() const override;
+
+    ScaffoldDataCacheOP get_data_cache_slow(::scheme::scaffold::TreeIndex i) override;
+
+    void set_fa_mode( bool fa ) override;
+    
+    void setup_twobody_tables( ::scheme::scaffold::TreeIndex i ) override;
+
+    
+    std::vector<ParametricSceneConformationCOP> conformations_;
+
+
+    shared_ptr< RotamerIndex > rot_index_p;
+    RifDockOpt const & opt;
+    MakeTwobodyOpts const & make2bopts;
+    ::devel::scheme::RotamerRFTablesManager & rotrf_table_manager ;
+
+
+};
+
+
+
+}}
+
+#endif
@@ -82,14 +82,13 @@ struct ScaffoldDataCache {
 // not setup during constructor
     shared_ptr<std::vector<std::vector<float> > > scaffold_onebody_glob0_p;    //onebodies in global numbering
     shared_ptr<std::vector<std::vector<float> > > local_onebody_p;       //onebodies in local numbering
+    shared_ptr<std::vector<float> > local_onebody_min_p;                 //best onebody of any rotamer, local numbering
 
     typedef ::scheme::objective::storage::TwoBodyTable<float> TBT;
 
     shared_ptr<TBT> scaffold_twobody_p;                                        // twobody_rotamer_energies using global_seqpos
     shared_ptr<TBT> local_twobody_p;                                           // twobody_rotamer_energies using local_seqpos
 
-    std::vector<shared_ptr<TBT>> local_twobody_per_thread;                     // Used with BuriedUnsats, these can momentarily change but must be reset
-
 
     MultithreadPoseCloner mpc_both_pose;                                       // scaffold_centered_p + target
     MultithreadPoseCloner mpc_both_full_pose;                                  // scaffold_full_centered_p + target
@@ -320,6 +319,7 @@ struct ScaffoldDataCache {
             for( int i = 0; i < scaffres_l2g_p->size(); ++i ){
                 local_onebody_p->push_back( scaffold_onebody_glob0_p->at( scaffres_l2g_p->at(i) ) );
             }
+            setup_local_onebody_min();
 
             for( int i = 0; i < scaffres_g2l_p->size(); ++i ){
                 if( (*scaffres_g2l_p)[i] < 0 ){
@@ -330,6 +330,15 @@ struct ScaffoldDataCache {
        
     }
 
+    // setup local_onebody_min_p from local_onebody_p, for bound-only rif scoring
+    void
+    setup_local_onebody_min() {
+        local_onebody_min_p = make_shared<std::vector<float> >();
+        for( std::vector<float> const & onebody : *local_onebody_p ){
+            local_onebody_min_p->push_back( onebody.size() ? *std::min_element( onebody.begin(), onebody.end() ) : 0.0f );
+        }
+    }
+
     // setup scaffold_onebody_glob0_p and local_onebody_p
     void
     setup_onebody_tables(
@@ -341,6 +350,12 @@ struct ScaffoldDataCache {
         scaffold_onebody_glob0_p = make_shared<std::vector<std::vector<float> >>();
 
         std::string cachefile_1be = "__1BE_"+scafftag+(opt.replace_all_with_ala_1bre?"_ALLALA":"")+"_reshash"+scaff_res_hashstr+".bin.gz";
+        shared_ptr< ::scheme::util::ContentHash > flat_key_1be;
+        if ( opt.scaffold_cache_format == "flat" ) {
+            flat_key_1be = make_shared< ::scheme::util::ContentHash >( onebody_energies_cache_key(
+                *scaffold_centered_p, *scaffold_res_p, *rot_index_p, opt.replace_all_with_ala_1bre ) );
+            cachefile_1be = "__1BE_" + scafftag + "_" + flat_key_1be->hex() + ".flat";
+        }
         if( ! opt.cache_scaffold_data ) cachefile_1be = "";
         std::cout << "rifdock: get_onebody_rotamer_energies" << std::endl;
         get_onebody_rotamer_energies(
@@ -353,7 +368,8 @@ struct ScaffoldDataCache {
                 opt.replace_all_with_ala_1bre,
                 opt.favorable_1body_multiplier,
                 opt.favorable_1body_multiplier_cutoff,
-                rotboltz_data_p
+                rotboltz_data_p,
+                flat_key_1be.get()
             );
 
 
@@ -382,6 +398,7 @@ struct ScaffoldDataCache {
         for( int i = 0; i < scaffres_l2g_p->size(); ++i ){
             local_onebody_p->push_back( scaffold_onebody_glob0_p->at( scaffres_l2g_p->at(i) ) );
         }
+        setup_local_onebody_min();
 
         for( int i = 0; i < scaffres_g2l_p->size(); ++i ){
             if( (*scaffres_g2l_p)[i] < 0 ){
@@ -404,7 +421,14 @@ struct ScaffoldDataCache {
 
         std::cout << "rifdock: get_twobody_tables" << std::endl;
         std::string cachefile2b = "__2BE_" + scafftag + "_reshash" + scaff_res_hashstr + ".bin.gz";
-        if( ! opt.cache_scaffold_data || opt.extra_rotamers ) cachefile2b = "";
+        shared_ptr< ::scheme::util::ContentHash > flat_key_2be;
+        if ( opt.scaffold_cache_format == "flat" ) {
+            // keyed on the final onebody energies, so it can't go stale when they change
+            flat_key_2be = make_shared< ::scheme::util::ContentHash >( twobody_tables_cache_key(
+                *scaffold_centered_p, *rot_index_p, *scaffold_onebody_glob0_p, rotrf_table_manager, make2bopts ) );
+            cachefile2b = "__2BE_" + scafftag + "_" + flat_key_2be->hex() + ".flat";
+        }
+        if( ! opt.cache_scaffold_data || ( opt.extra_rotamers && ! flat_key_2be ) ) cachefile2b = "";
         std::string dscrtmp;
         get_twobody_tables(
                 opt.data_cache_path,
@@ -415,7 +439,8 @@ struct ScaffoldDataCache {
                 *scaffold_onebody_glob0_p,
                 rotrf_table_manager,
                 make2bopts,
-                *scaffold_twobody_p
+                *scaffold_twobody_p,
+                flat_key_2be.get()
             );
 
 
@@ -436,35 +461,6 @@ struct ScaffoldDataCache {
 
 
 
-    // setup scaffold_twobody_p and local_twobody_p
-    void
-    setup_twobody_tables_per_thread( ) {
-        runtime_assert( local_twobody_p );
-
-        if ( local_twobody_per_thread.size() > 0 ) return;
-
-        local_twobody_per_thread.resize(::devel::scheme::omp_max_threads_1());
-
-        for ( int i = 0; i < local_twobody_per_thread.size(); i++ ) {
-            local_twobody_per_thread[i] = local_twobody_p->clone();
-        }
-    }
-
-    bool
-    check_twobody_tables_per_thread_integrity( ) {
-        runtime_assert( local_twobody_per_thread.size() > 0 );
-
-        local_twobody_per_thread.resize(::devel::scheme::omp_max_threads_1());
-
-        for ( int i = 0; i < local_twobody_per_thread.size(); i++ ) {
-            if ( ! local_twobody_per_thread[i]->check_equal( *local_twobody_p) ) {
-                return false;
-            }
-        }
-        return true;
-    }
-
-
     float
     get_redundancy_filter_rg( float target_redundancy_filter_rg ) {
         return std::min( target_redundancy_filter_rg, scaff_redundancy_filter_rg );
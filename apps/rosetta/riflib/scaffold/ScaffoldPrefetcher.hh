@@ -0,0 +1,152 @@
+// -*- mode:c++;tab-width:2;indent-tabs-mode:t;show-trailing-whitespace:t;rm-trailing-spaces:t -*-
+// vi: set ts=2 noet:
+//
+// (c) Copyright Rosetta Commons Member Institutions.
+// (c) This file is part of the Rosetta software suite and is made available under license.
+// (c) The Rosetta software is developed by the contributing members of the Rosetta Commons.
+// (c) For more information, see http://www.rosettacommons.org. Questions about this can be
+// (c) addressed to University of Washington UW TechTransfer, email: license@u.washington.edu.
+
+
+
+#ifndef INCLUDED_riflib_scaffold_ScaffoldPrefetcher_hh
+#define INCLUDED_riflib_scaffold_ScaffoldPrefetcher_hh
+
+
+#include <riflib/rifdock_typedefs.hh>
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#ifdef USE_OPENMP
+#include <omp.h>
+#endif
+
+
+namespace devel {
+namespace scheme {
+
+// Prepares scaffolds ahead of the one being docked.
+//
+// A background thread runs prepare(iscaff) for the scaffolds in order
+//  (loading the pose, the data cache, the one and two body tables) while
+//  the main thread docks. At most max_ahead scaffolds past the one last
+//  taken with get() are prepared and held, which bounds the memory used
+//  by scaffolds in flight.
+//
+// The first scaffold is prepared on the main thread with all cores. The
+//  background thread starts after that and runs with one OpenMP thread,
+//  so it only uses what HSearch leaves idle. It calls into Rosetta
+//  concurrently with the main thread, as RosettaScoreTask already does
+//  from its OpenMP threads.
+
+struct ScaffoldPrefetcher {
+
+    struct Prepared {
+        ScaffoldProviderOP scaffold_provider;
+        bool needs_scaffold_director = false;
+        std::exception_ptr error;
+    };
+
+    typedef std::function<void( int iscaff, Prepared & prepared )> PrepareFunction;
+
+    ScaffoldPrefetcher( int n_scaffolds, int max_ahead, PrepareFunction prepare )
+      : n_scaffolds_( n_scaffolds ),
+        max_ahead_( max_ahead ),
+        prepare_( prepare ),
+        next_taken_( 0 ),
+        stop_( false )
+    {
+        if ( max_ahead_ > 0 ) worker_ = std::thread( [this](){ run(); } );
+    }
+
+    ~ScaffoldPrefetcher() {
+        {
+            std::lock_guard<std::mutex> guard( mutex_ );
+            stop_ = true;
+        }
+        cond_.notify_all();
+        if ( worker_.joinable() ) worker_.join();
+    }
+
+    // Scaffolds must be taken in order. Errors from prepare() are
+    //  rethrown here, so they are reported for the right scaffold
+    Prepared
+    get( int iscaff ) {
+        Prepared prepared;
+        if ( max_ahead_ <= 0 || iscaff == 0 ) {
+            try {
+                prepare_( iscaff, prepared );
+            } catch ( ... ) {
+                prepared.error = std::current_exception();
+            }
+            if ( max_ahead_ > 0 ) {
+                {
+                    std::lock_guard<std::mutex> guard( mutex_ );
+                    next_taken_ = 1;
+                }
+                cond_.notify_all();
+            }
+        } else {
+            std::unique_lock<std::mutex> lock( mutex_ );
+            runtime_assert( iscaff == next_taken_ );
+            cond_.wait( lock, [&](){ return ready_.count( iscaff ) > 0; } );
+            prepared = ready_[iscaff];
+            ready_.erase( iscaff );
+            next_taken_ = iscaff + 1;
+            lock.unlock();
+            cond_.notify_all();
+        }
+        if ( prepared.error ) std::rethrow_exception( prepared.error );
+        return prepared;
+    }
+
+private:
+
+    void
+    run() {
+        #ifdef USE_OPENMP
+            omp_set_num_threads( 1 );
+        #endif
+        for ( int iscaff = 1; iscaff < n_scaffolds_; iscaff++ ) {
+            {
+                std::unique_lock<std::mutex> lock( mutex_ );
+                cond_.wait( lock, [&](){ return stop_ || ( next_taken_ > 0 && iscaff < next_taken_ + max_ahead_ ); } );
+                if ( stop_ ) return;
+            }
+            Prepared prepared;
+            try {
+                prepare_( iscaff, prepared );
+            } catch ( ... ) {
+                prepared.error = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> guard( mutex_ );
+                ready_[iscaff] = prepared;
+            }
+            cond_.notify_all();
+        }
+    }
+
+    int n_scaffolds_;
+    int max_ahead_;
+    PrepareFunction prepare_;
+
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::map<int, Prepared> ready_;
+    int next_taken_;
+    bool stop_;
+    std::thread worker_;
+};
+
+
+}}
+
+
+
+#endif
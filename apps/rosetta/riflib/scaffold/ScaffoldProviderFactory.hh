@@ -14,6 +14,7 @@
 #include <scheme/types.hh>
 #include <riflib/scaffold/Baseline9AScaffoldProvider.hh>
 #include <riflib/scaffold/MorphingScaffoldProvider.hh>
+#include <riflib/scaffold/MultiFileScaffoldProvider.hh>
 #include <riflib/scaffold/SingleFileScaffoldProvider.hh>
 #include <riflib/rifdock_typedefs.hh>
 
@@ -31,7 +32,18 @@ get_scaffold_provider(
         bool & needs_scaffold_director ) {
 
 
-    if (opt.scaff_search_mode == "default") {
+    if (opt.scaff_search_mode == "default" && opt.scaffold_batch_size > 1) {
+
+        needs_scaffold_director = true;
+        return make_shared<MultiFileScaffoldProvider>(
+                iscaff,
+                std::min<uint64_t>( opt.scaffold_batch_size, opt.scaffold_fnames.size() - iscaff ),
+                rot_index_p,
+                opt,
+                make2bopts,
+                rotrf_table_manager);
+
+    } else if (opt.scaff_search_mode == "default") {
 
         needs_scaffold_director = false;
         return make_shared<SingleFileScaffoldProvider>(
@@ -50,6 +50,11 @@ struct Task {
 
     virtual TaskType get_task_type() const = 0;
 
+    // Tasks that set up state outside the points and ProtocolData (fa mode, scaffold
+    //  tables, ...) redo it here. TaskProtocol calls this for each task it skips when
+    //  resuming from a checkpoint, in order.
+    virtual void restore_state( RifDockData & rdd, ProtocolData & pd ) {}
+
 
 };
 
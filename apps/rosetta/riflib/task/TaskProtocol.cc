@@ -14,7 +14,11 @@
 #include <riflib/types.hh>
 
 
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <string>
+#include <typeinfo>
 #include <vector>
 
 
@@ -23,6 +27,292 @@ namespace devel {
 namespace scheme {
 
 
+// Checkpoint files are the header below, the ProtocolData counters, the working
+//  points and the magic again, so a file cut short doesn't load. They are written
+//  to fname.tmp and renamed over fname, so there is always one complete file.
+
+static char const CHECKPOINT_MAGIC[16] = "RifDockCheckpt";
+static uint64_t const CHECKPOINT_VERSION = 2;
+
+template<class T>
+static void
+write_pod( std::ostream & out, T const & t ) {
+    out.write( (char const *)&t, sizeof(T) );
+}
+
+template<class T>
+static bool
+read_pod( std::istream & in, T & t ) {
+    in.read( (char *)&t, sizeof(T) );
+    return (bool)in;
+}
+
+template<class T>
+static void
+write_pod_vector( std::ostream & out, std::vector<T> const & v ) {
+    write_pod( out, (uint64_t)v.size() );
+    if ( v.size() ) out.write( (char const *)v.data(), v.size()*sizeof(T) );
+}
+
+template<class T>
+static bool
+read_pod_vector( std::istream & in, std::vector<T> & v ) {
+    uint64_t n;
+    if ( ! read_pod( in, n ) ) return false;
+    v.resize( n );
+    if ( n ) in.read( (char *)v.data(), n*sizeof(T) );
+    return (bool)in;
+}
+
+typedef shared_ptr< std::vector< std::pair<intRot,intRot> > > RotamersOP;
+
+static void
+write_rotamers( std::ostream & out, RotamersOP const & rotamers ) {
+    write_pod( out, (uint8_t)( rotamers != nullptr ) );
+    if ( rotamers ) write_pod_vector( out, *rotamers );
+}
+
+static bool
+read_rotamers( std::istream & in, RotamersOP & rotamers ) {
+    uint8_t has_rotamers;
+    if ( ! read_pod( in, has_rotamers ) ) return false;
+    rotamers = nullptr;
+    if ( ! has_rotamers ) return true;
+    rotamers = make_shared< std::vector< std::pair<intRot,intRot> > >();
+    return read_pod_vector( in, *rotamers );
+}
+
+static void
+write_point( std::ostream & out, SearchPoint const & p ) {
+    write_pod( out, p );
+}
+
+static bool
+read_point( std::istream & in, SearchPoint & p ) {
+    return read_pod( in, p );
+}
+
+static void
+write_point( std::ostream & out, SearchPointWithRots const & p ) {
+    write_pod( out, p.score );
+    write_pod( out, p.sasa );
+    write_pod( out, p.prepack_rank );
+    write_pod( out, p.index );
+    write_rotamers( out, p.rotamers_ );
+}
+
+static bool
+read_point( std::istream & in, SearchPointWithRots & p ) {
+    read_pod( in, p.score );
+    read_pod( in, p.sasa );
+    read_pod( in, p.prepack_rank );
+    read_pod( in, p.index );
+    return read_rotamers( in, p.rotamers_ );
+}
+
+static void
+write_point( std::ostream & out, RifDockResult const & p ) {
+    write_pod( out, p.dist0 );
+    write_pod( out, p.nopackscore );
+    write_pod( out, p.rifscore );
+    write_pod( out, p.stericscore );
+    write_pod( out, p.score );
+    write_pod( out, p.scaff_bb_hbond );
+    write_pod( out, p.sasa );
+    write_pod( out, p.isamp );
+    write_pod( out, p.index );
+    write_pod( out, p.prepack_rank );
+    write_pod( out, p.cluster_score );
+    write_rotamers( out, p.rotamers_ );
+}
+
+static bool
+read_point( std::istream & in, RifDockResult & p ) {
+    read_pod( in, p.dist0 );
+    read_pod( in, p.nopackscore );
+    read_pod( in, p.rifscore );
+    read_pod( in, p.stericscore );
+    read_pod( in, p.score );
+    read_pod( in, p.scaff_bb_hbond );
+    read_pod( in, p.sasa );
+    read_pod( in, p.isamp );
+    read_pod( in, p.index );
+    read_pod( in, p.prepack_rank );
+    read_pod( in, p.cluster_score );
+    return read_rotamers( in, p.rotamers_ );
+}
+
+template<class Point>
+static void
+write_points( std::ostream & out, shared_ptr<std::vector<Point>> const & points ) {
+    write_pod( out, (uint8_t)( points != nullptr ) );
+    if ( ! points ) return;
+    write_pod( out, (uint64_t)points->size() );
+    for ( Point const & p : *points ) write_point( out, p );
+}
+
+template<class Point>
+static bool
+read_points( std::istream & in, shared_ptr<std::vector<Point>> & points ) {
+    uint8_t has_points;
+    uint64_t n;
+    if ( ! read_pod( in, has_points ) ) return false;
+    points = nullptr;
+    if ( ! has_points ) return true;
+    if ( ! read_pod( in, n ) ) return false;
+    points = make_shared<std::vector<Point>>( n );
+    for ( Point & p : *points ) {
+        if ( ! read_point( in, p ) ) return false;
+    }
+    return true;
+}
+
+template<class Point>
+static bool
+holds_poses( shared_ptr<std::vector<Point>> const & points ) {
+    if ( ! points ) return false;
+    for ( Point const & p : *points ) {
+        if ( p.pose_ ) return true;
+    }
+    return false;
+}
+
+static void
+write_protocol_data( std::ostream & out, ProtocolData const & pd ) {
+    write_pod( out, pd.non0_space_size );
+    write_pod( out, pd.total_search_effort );
+    write_pod( out, pd.npack );
+    write_pod( out, pd.time_rif );
+    write_pod( out, pd.time_pck );
+    write_pod( out, pd.time_ros );
+    write_pod( out, pd.hsearch_rate );
+    write_pod( out, pd.beam_multiplier );
+    write_pod( out, pd.implicit_children );
+    write_pod_vector( out, pd.unique_scaffolds );
+    write_pod( out, (uint64_t)pd.seeding_tags.size() );
+    for ( std::string const & tag : pd.seeding_tags ) {
+        write_pod( out, (uint64_t)tag.size() );
+        out.write( tag.data(), tag.size() );
+    }
+}
+
+static bool
+read_protocol_data( std::istream & in, ProtocolData & pd ) {
+    read_pod( in, pd.non0_space_size );
+    read_pod( in, pd.total_search_effort );
+    read_pod( in, pd.npack );
+    read_pod( in, pd.time_rif );
+    read_pod( in, pd.time_pck );
+    read_pod( in, pd.time_ros );
+    read_pod( in, pd.hsearch_rate );
+    read_pod( in, pd.beam_multiplier );
+    read_pod( in, pd.implicit_children );
+    read_pod_vector( in, pd.unique_scaffolds );
+    uint64_t ntags;
+    if ( ! read_pod( in, ntags ) ) return false;
+    pd.seeding_tags.resize( ntags );
+    for ( std::string & tag : pd.seeding_tags ) {
+        uint64_t len;
+        if ( ! read_pod( in, len ) ) return false;
+        tag.resize( len );
+        if ( len ) in.read( &tag[0], len );
+    }
+    return (bool)in;
+}
+
+
+void
+TaskProtocol::set_checkpoint( std::string const & fname, ::scheme::util::ContentHash const & key ) {
+    ::scheme::util::ContentHash full_key = key;
+    full_key.add_pod( CHECKPOINT_VERSION );
+    full_key.add_pod( (uint64_t)tasks_.size() );
+    for ( shared_ptr<Task> const & task : tasks_ ) {
+        full_key.add( std::string( typeid( *task ).name() ) );
+        full_key.add_pod( (int32_t)task->get_task_type() );
+    }
+    full_key.digest( checkpoint_key_[0], checkpoint_key_[1] );
+    checkpoint_fname_ = fname;
+}
+
+bool
+TaskProtocol::load_checkpoint_(
+    ThreePointVectors & working,
+    size_t & taskno,
+    TaskType & last_task_type,
+    ProtocolData & pd ) const {
+
+    std::ifstream in( checkpoint_fname_, std::ios::binary );
+    if ( ! in ) return false;
+
+    char magic[16];
+    uint64_t version, key[2], saved_taskno;
+    int32_t saved_task_type;
+    read_pod( in, magic );
+    read_pod( in, version );
+    read_pod( in, key );
+    read_pod( in, saved_taskno );
+    read_pod( in, saved_task_type );
+    if ( ! in || std::memcmp( magic, CHECKPOINT_MAGIC, 16 ) != 0 || version != CHECKPOINT_VERSION
+            || key[0] != checkpoint_key_[0] || key[1] != checkpoint_key_[1] || saved_taskno >= tasks_.size() ) {
+        std::cout << "Checkpoint " << checkpoint_fname_ << " is from a different run, ignoring it" << std::endl;
+        return false;
+    }
+
+    ProtocolData saved_pd;
+    ThreePointVectors saved;
+    bool ok = read_protocol_data( in, saved_pd );
+    ok = ok && read_points( in, saved.search_points );
+    ok = ok && read_points( in, saved.search_point_with_rotss );
+    ok = ok && read_points( in, saved.rif_dock_results );
+    ok = ok && read_pod( in, magic ) && std::memcmp( magic, CHECKPOINT_MAGIC, 16 ) == 0;
+    if ( ! ok ) {
+        std::cout << "Checkpoint " << checkpoint_fname_ << " is incomplete, ignoring it" << std::endl;
+        return false;
+    }
+
+    saved_pd.start_rif = pd.start_rif;
+    pd = saved_pd;
+    working = saved;
+    taskno = saved_taskno;
+    last_task_type = (TaskType)saved_task_type;
+    return true;
+}
+
+void
+TaskProtocol::save_checkpoint_(
+    ThreePointVectors const & working,
+    size_t taskno,
+    TaskType last_task_type,
+    ProtocolData const & pd ) const {
+
+    if ( holds_poses( working.search_point_with_rotss ) || holds_poses( working.rif_dock_results ) ) {
+        std::cout << "Not checkpointing after task " << taskno << ", the results hold rosetta poses" << std::endl;
+        return;
+    }
+
+    std::string tmpname = checkpoint_fname_ + ".tmp";
+    std::ofstream out( tmpname, std::ios::binary );
+    write_pod( out, CHECKPOINT_MAGIC );
+    write_pod( out, CHECKPOINT_VERSION );
+    write_pod( out, checkpoint_key_ );
+    write_pod( out, (uint64_t)taskno );
+    write_pod( out, (int32_t)last_task_type );
+    write_protocol_data( out, pd );
+    write_points( out, working.search_points );
+    write_points( out, working.search_point_with_rotss );
+    write_points( out, working.rif_dock_results );
+    write_pod( out, CHECKPOINT_MAGIC );
+    out.close();
+
+    if ( ! out || std::rename( tmpname.c_str(), checkpoint_fname_.c_str() ) != 0 ) {
+        std::cout << "WARNING: failed to write checkpoint " << checkpoint_fname_ << std::endl;
+        std::remove( tmpname.c_str() );
+        return;
+    }
+    std::cout << "Checkpoint after task " << taskno << " of " << tasks_.size() << " written to " << checkpoint_fname_ << std::endl;
+}
+
+
 ThreePointVectors
 TaskProtocol::run( ThreePointVectors input, RifDockData & rdd, ProtocolData & pd ) {
 
@@ -45,6 +335,17 @@ TaskProtocol::run( ThreePointVectors input, RifDockData & rdd, ProtocolData & pd
 
     size_t current_taskno = 0;
 
+    if ( checkpoint_fname_.size() ) {
+        ThreePointVectors restored;
+        if ( load_checkpoint_( restored, current_taskno, last_task_type, pd ) ) {
+            working_search_points = restored.search_points;
+            working_search_point_with_rotss = restored.search_point_with_rotss;
+            working_rif_dock_results = restored.rif_dock_results;
+            std::cout << "Resuming from checkpoint " << checkpoint_fname_ << " after task " << current_taskno << " of " << tasks_.size() << std::endl;
+            for ( size_t taskno = 0; taskno < current_taskno; taskno++ ) tasks_[taskno]->restore_state( rdd, pd );
+        }
+    }
+
 
     while ( current_taskno < tasks_.size() ) {
 
@@ -205,6 +506,11 @@ TaskProtocol::run( ThreePointVectors input, RifDockData & rdd, ProtocolData & pd
             return ThreePointVectors();
         }
 
+        if ( checkpoint_fname_.size() && current_taskno < tasks_.size() ) {
+            ThreePointVectors working { working_search_points, working_search_point_with_rotss, working_rif_dock_results };
+            save_checkpoint_( working, current_taskno, last_task_type, pd );
+        }
+
     }
 
     ThreePointVectors to_return {
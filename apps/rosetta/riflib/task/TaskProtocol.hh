@@ -13,6 +13,8 @@
 #include <riflib/types.hh>
 #include <riflib/task/Task.hh>
 
+#include <scheme/util/FlatCache.hh>
+
 #include <string>
 #include <vector>
 
@@ -30,19 +32,46 @@ struct ThreePointVectors {
 struct TaskProtocol {
 
     TaskProtocol( std::vector<shared_ptr<Task>> const & tasks ) :
-    tasks_( tasks )
+    tasks_( tasks ),
+    checkpoint_key_()
     {}
 
 
     ThreePointVectors
     run( ThreePointVectors input, RifDockData & rdd, ProtocolData & pd );
 
+    // With a checkpoint file, run() saves the working points and the ProtocolData
+    //  counters after each task and, if the file is there from a run with the same
+    //  key and tasks, starts after the last task it saved. Tasks must pass everything
+    //  they need on through these, or redo the rest in Task::restore_state(), which
+    //  is called for every skipped task. Nothing is saved after the last task, or
+    //  while the points hold rosetta poses.
+    void
+    set_checkpoint( std::string const & fname, ::scheme::util::ContentHash const & key );
+
 
 private:
 
+    bool
+    load_checkpoint_(
+        ThreePointVectors & working,
+        size_t & taskno,
+        TaskType & last_task_type,
+        ProtocolData & pd ) const;
+
+    void
+    save_checkpoint_(
+        ThreePointVectors const & working,
+        size_t taskno,
+        TaskType last_task_type,
+        ProtocolData const & pd ) const;
+
 
     std::vector<shared_ptr<Task>> tasks_;
 
+    std::string checkpoint_fname_;
+    uint64_t checkpoint_key_[2];
+
 
 
 };
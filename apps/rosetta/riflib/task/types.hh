@@ -14,6 +14,7 @@
 #include <riflib/rifdock_typedefs.hh>
 #include <riflib/rotamer_energy_tables.hh>
 #include <scheme/search/HackPack.hh>
+#include <scheme/util/ShardExchange.hh>
 #include <riflib/RifBase.hh>
 #include <riflib/RifFactory.hh>
 
@@ -43,6 +44,8 @@ struct tmplSearchPointWithRots;
 template<class _DirectorBigIndex>
 struct tmplRifDockResult;
 
+struct OutputWriter;
+
 
 #pragma pack (push, 4) // allows size to be 12 rather than 16
 template<class _DirectorBigIndex>
@@ -218,6 +221,8 @@ struct RifDockData {
     shared_ptr<BurialManager> burial_manager;
     shared_ptr<UnsatManager> unsat_manager;
     shared_ptr<HydrophobicManager> hydrophobic_manager;
+    shared_ptr<OutputWriter> output_writer;
+    shared_ptr< ::scheme::util::ShardExchange > hsearch_shards;
 
 #ifdef USEGRIDSCORE
     shared_ptr<protocols::ligand_docking::ga_ligand_dock::GridScorer> grid_scorer;
@@ -243,6 +248,7 @@ struct ProtocolData {
 
 // for hsearch
     double beam_multiplier;
+    uint64_t implicit_children; // > 1 if each SearchPoint stands for this many children, see HSearchScoreAtReslTask
 
 // for seeding positions
     std::vector<std::string> seeding_tags;
@@ -257,7 +263,8 @@ struct ProtocolData {
     time_pck(0),
     time_ros(0),
     hsearch_rate(0),
-    beam_multiplier(1)
+    beam_multiplier(1),
+    implicit_children(1)
 
 
 
@@ -26,6 +26,8 @@
 
 #include <ObjexxFCL/format.hh>
 
+#include <chrono>
+
 
 namespace devel {
 namespace scheme {
@@ -564,6 +566,66 @@ prepare_donor_acceptor_cache(
 
 }
 
+// Scores random rotamers at random positions around the target hbonders on
+//  one thread and reports calls/sec with the DonorAcceptorCache and with a
+//  plain scan over all target hbonders. The two must give the same answers
+void
+benchmark_score_rotamer_v_target(
+    RifScoreRotamerVsTarget const & rot_tgt_scorer,
+    int ncalls
+) {
+	RifScoreRotamerVsTarget no_cache_scorer = rot_tgt_scorer;
+	no_cache_scorer.target_donor_cache_ = nullptr;
+	no_cache_scorer.target_acceptor_cache_ = nullptr;
+
+	size_t const nhbonders = rot_tgt_scorer.target_donors_.size() + rot_tgt_scorer.target_acceptors_.size();
+	if ( nhbonders == 0 ) {
+		std::cout << "benchmark_score_rotamer_v_target: target has no hbonders" << std::endl;
+		return;
+	}
+	Eigen::Vector3f center( 0, 0, 0 );
+	for ( HBondRay const & ray : rot_tgt_scorer.target_donors_ ) center += ray.horb_cen;
+	for ( HBondRay const & ray : rot_tgt_scorer.target_acceptors_ ) center += ray.horb_cen;
+	center /= nhbonders;
+	float max_distance = 0;
+	for ( HBondRay const & ray : rot_tgt_scorer.target_donors_ ) max_distance = std::max<float>( max_distance, ( ray.horb_cen - center ).norm() );
+	for ( HBondRay const & ray : rot_tgt_scorer.target_acceptors_ ) max_distance = std::max<float>( max_distance, ( ray.horb_cen - center ).norm() );
+
+	std::mt19937 rng( 0 );
+	std::vector<int> irots( ncalls );
+	std::vector<EigenXform> positions( ncalls );
+	for ( int i = 0; i < ncalls; i++ ) {
+		irots[i] = rng() % rot_tgt_scorer.rot_index_p_->size();
+		::scheme::numeric::rand_xform( rng, positions[i], 2.0f*max_distance );
+		positions[i].translation() += center;
+	}
+
+	std::vector<float> scores[2];
+	std::vector<int> sats[2];
+	for ( int icache = 0; icache < 2; icache++ ) {
+		RifScoreRotamerVsTarget const & scorer = icache ? rot_tgt_scorer : no_cache_scorer;
+		scores[icache].resize( ncalls );
+		sats[icache].resize( 2*ncalls );
+		std::chrono::time_point<std::chrono::high_resolution_clock> start = std::chrono::high_resolution_clock::now();
+		for ( int i = 0; i < ncalls; i++ ) {
+			int sat1 = -1, sat2 = -1, hbcount = 0;
+			scores[icache][i] = scorer.score_rotamer_v_target_sat( irots[i], positions[i], sat1, sat2, true, hbcount );
+			sats[icache][2*i] = sat1;
+			sats[icache][2*i+1] = sat2;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+		std::cout << "score_rotamer_v_target_sat " << ( icache ? "with DonorAcceptorCache: " : "scanning all hbonders: " )
+		          << ncalls / elapsed.count() << " calls/sec" << std::endl;
+	}
+	if ( ! rot_tgt_scorer.target_donor_cache_ && ! rot_tgt_scorer.target_acceptor_cache_ ) return;
+
+	int nbad = 0;
+	for ( int i = 0; i < ncalls; i++ ) {
+		if ( scores[0][i] != scores[1][i] || sats[0][2*i] != sats[1][2*i] || sats[0][2*i+1] != sats[1][2*i+1] ) nbad++;
+	}
+	if ( nbad ) std::cout << "benchmark_score_rotamer_v_target: " << nbad << " of " << ncalls << " scores differ with the DonorAcceptorCache" << std::endl;
+}
+
 
 
 }
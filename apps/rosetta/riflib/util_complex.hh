@@ -78,6 +78,12 @@ prepare_donor_acceptor_cache(
     shared_ptr<DonorAcceptorCache> & target_acceptor_cache
 );
 
+void
+benchmark_score_rotamer_v_target(
+    RifScoreRotamerVsTarget const & rot_tgt_scorer,
+    int ncalls
+);
+
 
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
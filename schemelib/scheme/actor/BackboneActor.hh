@@ -191,6 +191,14 @@ void write_pdb( std::ostream & out, BackboneActor<P> const & a, MetaData const &
 
 
 
+///@brief same as dst = BackboneActor( rotated, translation ) for a pure translation.
+///       Scene uses this with its cache of rotated actors
+template<class P>
+void translate_moved_actor( BackboneActor<P> & dst, BackboneActor<P> const & rotated, P const & translation ){
+	dst = rotated;
+	dst.position_.translation() += translation.translation();
+}
+
 template<class X>
 std::ostream & operator<<(std::ostream & out,BackboneActor<X> const& a){
 	return out << "BackboneActor " << a.ss_ << " " << a.aa_ << " " << a.index_;
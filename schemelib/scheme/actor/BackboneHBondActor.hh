@@ -120,6 +120,19 @@ void write_pdb( std::ostream & out, BackboneHBondActor const & a, MetaData const
 }
 
 
+///@brief same as dst = BackboneHBondActor( rotated, translation ) for a pure translation,
+///       up to rounding of the ray directions, which a translation doesn't change.
+///       Scene uses this with its cache of rotated actors
+inline
+void translate_moved_actor( BackboneHBondActor & dst, BackboneHBondActor const & rotated, BackboneHBondActor::Position const & translation ){
+	dst.is_donor_ = rotated.is_donor_;
+	dst.index_ = rotated.index_;
+	dst.hbond_rays_ = rotated.hbond_rays_;
+	for ( ::scheme::chemical::HBondRay & hbray : dst.hbond_rays_ ) {
+		hbray.horb_cen += translation.translation();
+	}
+}
+
 inline
 std::ostream & operator<<(std::ostream & out,BackboneHBondActor const& a){
 	return out << "BackboneHBondActor " << (a.is_donor_ ? "donor" : "acceptor" ) << " " << a.index_;
@@ -105,6 +105,28 @@ void write_pdb( std::ostream & out, BackboneSasaActor const & a, MetaData const
 }
 
 
+///@brief same as dst = BackboneSasaActor( src, pos ), but reuses dst's point storage.
+///       Scene uses this when refreshing its cache of moved actors
+inline
+void set_moved_actor( BackboneSasaActor & dst, BackboneSasaActor const & src, BackboneSasaActor::Position const & pos ){
+	dst.index_ = src.index_;
+	dst.sasa_points_.resize( src.sasa_points_.size() );
+	for ( size_t ipos = 0; ipos < src.sasa_points_.size(); ipos++ ) {
+		dst.sasa_points_[ipos] = pos * src.sasa_points_[ipos];
+	}
+}
+
+///@brief same as dst = BackboneSasaActor( rotated, translation ) for a pure translation.
+///       Scene uses this with its cache of rotated actors
+inline
+void translate_moved_actor( BackboneSasaActor & dst, BackboneSasaActor const & rotated, BackboneSasaActor::Position const & translation ){
+	dst.index_ = rotated.index_;
+	dst.sasa_points_.resize( rotated.sasa_points_.size() );
+	for ( size_t ipos = 0; ipos < rotated.sasa_points_.size(); ipos++ ) {
+		dst.sasa_points_[ipos] = rotated.sasa_points_[ipos] + translation.translation();
+	}
+}
+
 inline
 std::ostream & operator<<(std::ostream & out,BackboneSasaActor const& a){
 	return out << "BackboneSasaActor " << a.index_;
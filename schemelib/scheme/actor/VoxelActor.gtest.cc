@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+
+#include "scheme/actor/VoxelActor.hh"
+#include "scheme/actor/Atom.hh"
+#include "scheme/kinematics/Scene.hh"
+#include "scheme/objective/ObjectiveFunction.hh"
+
+#include <Eigen/Geometry>
+
+#include <memory>
+#include <random>
+
+namespace scheme { namespace actor { namespace test_voxactor {
+
+using std::cout;
+using std::endl;
+
+typedef Eigen::Transform<float,3,Eigen::AffineCompact> Xform;
+typedef VoxelActor<Xform,float> VActor;
+typedef SimpleAtom<Eigen::Vector3f> Atom;
+typedef VActor::VoxelArray VoxelArray;
+typedef util::SimpleArray<3,float> F3;
+
+struct Grids {
+	std::vector< std::unique_ptr<VoxelArray> > store;
+	VActor::Voxels voxels;
+	Grids( std::mt19937 & rng, int nresl, int ntypes ){
+		std::uniform_real_distribution<float> runif;
+		voxels.resize( nresl );
+		for( int r = 0; r < nresl; ++r ){
+			for( int t = 0; t < ntypes; ++t ){
+				float const cs = 0.5f + r + t*0.1f;
+				store.push_back( std::unique_ptr<VoxelArray>( new VoxelArray( F3(-5-t*0.3f,-4,-6), F3(5,6+t*0.2f,4), cs ) ) );
+				VoxelArray & a = *store.back();
+				for( size_t i = 0; i < a.num_elements(); ++i ) a.data()[i] = runif(rng)*4.0f - 2.0f;
+				voxels[r].push_back( &a );
+			}
+		}
+	}
+};
+
+std::vector<Atom> random_atoms( std::mt19937 & rng, int n, int ntypes ){
+	std::uniform_real_distribution<float> runif;
+	std::vector<Atom> atoms;
+	for( int i = 0; i < n; ++i ){
+		// some well outside the grids, some just below lb where index truncates to 0
+		float const w = i%3 ? 9.0f : 7.0f;
+		Eigen::Vector3f p( runif(rng)*2*w-w, runif(rng)*2*w-w, runif(rng)*2*w-w );
+		if( i%7 == 0 ) p[0] = -5.0f - ( i % ntypes )*0.3f - runif(rng)*0.4f;
+		atoms.push_back( Atom( p, i % ntypes ) );
+	}
+	return atoms;
+}
+
+TEST( VoxelActor, batch_matches_per_atom ){
+	std::mt19937 rng( 3847 );
+	int const NTYPES = 21;
+	Grids grids( rng, 2, NTYPES );
+	VActor vactor( grids.voxels );
+	for( int n : { 0, 1, 15, 16, 17, 1000 } ){
+		std::vector<Atom> atoms = random_atoms( rng, n, NTYPES );
+		for( int resl = 0; resl < 2; ++resl ){
+			Score_Voxel_vs_Atom<VActor,Atom,false> score;
+			Score_Voxel_vs_Atom<VActor,Atom,true> score_repl;
+			float ref = 0, ref_repl = 0;
+			for( auto const & a : atoms ){
+				ref += score( vactor, a, resl );
+				ref_repl += score_repl( vactor, a, resl );
+			}
+			ASSERT_FLOAT_EQ( ref, score.batch( vactor, atoms.data(), atoms.size(), resl ) );
+			ASSERT_FLOAT_EQ( ref_repl, score_repl.batch( vactor, atoms.data(), atoms.size(), resl ) );
+		}
+	}
+}
+
+TEST( VoxelActor, compact_grids ){
+	std::mt19937 rng( 9874 );
+	int const NTYPES = 21;
+	Grids grids( rng, 2, NTYPES );
+	std::vector< std::unique_ptr<objective::voxel::CompactVoxelArray> > store;
+	VActor::CompactVoxels compact( grids.voxels.size() );
+	for( size_t r = 0; r < grids.voxels.size(); ++r ){
+		for( auto g : grids.voxels[r] ){
+			store.push_back( std::unique_ptr<objective::voxel::CompactVoxelArray>(
+				new objective::voxel::CompactVoxelArray( *g, objective::voxel::CompactVoxelArray::FP16 ) ) );
+			compact[r].push_back( store.back().get() );
+		}
+	}
+	VActor vfloat( grids.voxels ), vcompact( grids.voxels, compact );
+	std::vector<Atom> atoms = random_atoms( rng, 1000, NTYPES );
+	Score_Voxel_vs_Atom<VActor,Atom,false> score;
+	for( int resl = 0; resl < 2; ++resl ){
+		float ref = 0, ref_compact = 0;
+		for( auto const & a : atoms ){
+			ref += score( vfloat, a, resl );
+			ref_compact += score( vcompact, a, resl );
+		}
+		ASSERT_FLOAT_EQ( ref_compact, score.batch( vcompact, atoms.data(), atoms.size(), resl ) );
+		ASSERT_NEAR( ref, ref_compact, 0.01 );
+	}
+}
+
+TEST( VoxelActor, batch_through_scene_visit ){
+	namespace m = boost::mpl;
+	typedef Score_Voxel_vs_Atom<VActor,Atom,false> Clash;
+	typedef objective::ObjectiveFunction< m::vector< Clash >, int > ObjFun;
+	typedef kinematics::Scene< kinematics::impl::Conformation< m::vector<VActor,Atom> >, Xform > Scene;
+
+	std::mt19937 rng( 1234 );
+	int const NTYPES = 21;
+	Grids grids( rng, 2, NTYPES );
+	std::vector<Atom> atoms = random_atoms( rng, 300, NTYPES );
+
+	Scene scene( 2 );
+	scene.add_actor( 0, VActor( grids.voxels ) );
+	for( auto const & a : atoms ) scene.add_actor( 1, a );
+
+	ObjFun objective;
+	for( int i = 0; i < 4; ++i ){
+		Xform x = Xform::Identity();
+		x.rotate( Eigen::AngleAxisf( i*0.7f, Eigen::Vector3f(1,2,3).normalized() ) );
+		x.translation() = Eigen::Vector3f( i*0.5f, -i*0.3f, 1.0f );
+		scene.set_position( 1, x );
+		for( int resl = 0; resl < 2; ++resl ){
+			float ref = 0;
+			for( auto const & a : atoms ) ref += Clash()( VActor( grids.voxels ), Atom( a, x ), resl );
+			ASSERT_NEAR( ref, objective( scene, resl ).get<Clash>(), 1e-3 );
+		}
+	}
+}
+
+}}}
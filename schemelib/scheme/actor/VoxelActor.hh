@@ -2,6 +2,12 @@
 #define INCLUDED_actor_VoxelActor_HH
 
 #include "scheme/objective/voxel/VoxelArray.hh"
+#include "scheme/objective/voxel/CompactVoxelArray.hh"
+
+#include <boost/mpl/bool.hpp>
+
+#include <algorithm>
+#include <vector>
 
 namespace scheme {
 namespace actor {
@@ -19,14 +25,18 @@ namespace actor {
 		typedef objective::voxel::VoxelArray<3,Float,Float> VoxelArray;
 		// typedef std::vector<std::vector<shared_ptr< VoxelArray > > > Voxels;
 		typedef std::vector<std::vector< VoxelArray * > > Voxels;
+		typedef std::vector<std::vector< objective::voxel::CompactVoxelArray * > > CompactVoxels;
 
 		// Position position_;
 		Voxels voxels_;
+		CompactVoxels compact_voxels_; // if not empty, scoring uses these instead of voxels_
 
 		VoxelActor() {}
 
 		VoxelActor( Voxels const & v ) :  voxels_(v) {}
 
+		VoxelActor( Voxels const & v, CompactVoxels const & cv ) :  voxels_(v), compact_voxels_(cv) {}
+
 		// VoxelActor( Position const & p, Voxels const * v ) :  voxels_(v) {}
 
 		// VoxelActor(
@@ -47,6 +57,8 @@ namespace actor {
 
 		Voxels const & voxels() const { return voxels_; }
 
+		CompactVoxels const & compact_voxels() const { return compact_voxels_; }
+
 		// bool operator==(THIS const & o) const { return o.position_==position_ && o.voxels_==voxels_; }
 
 		// ///@brief necessary for testing only
@@ -87,7 +99,9 @@ struct Score_Voxel_vs_Atom {
 		// std::cout << "   pos  " << a.position().transpose() << std::endl;
 		// std::cout << "     LB " << v.voxels()[c][a.type()]->lb_ << std::endl;
 		// std::cout << "     UB " << v.voxels()[c][a.type()]->ub_ << std::endl;
-		float score = v.voxels()[c][a.type()]->at( a.position()[0], a.position()[1], a.position()[2] );
+		float score = v.compact_voxels().size()
+			? v.compact_voxels()[c][a.type()]->at( a.position()[0], a.position()[1], a.position()[2] )
+			: v.voxels()[c][a.type()]->at( a.position()[0], a.position()[1], a.position()[2] );
 		// std::cout << "  score " << score << std::endl;
 		if( REPL_ONLY ) return std::max(0.0f,score);
 		else return a.type() > 17 ? std::max(0.0f,score) : score;
@@ -96,6 +110,69 @@ struct Score_Voxel_vs_Atom {
 	Result operator()(Pair const & p, Config const& c) const {
 		return this->operator()(p.first,p.second,c);
 	}
+
+	///@brief sum of operator() over n atoms, called by ObjectivesVisitor::visit_batch
+	typedef boost::mpl::true_ HasBatch;
+	template<class Config>
+	Result batch( VoxelActor const & v, Atom const * atoms, size_t n, Config const & c ) const {
+		if( v.compact_voxels().size() ) return batch_grids( v.compact_voxels()[c], atoms, n );
+		return batch_grids( v.voxels()[c], atoms, n );
+	}
+
+private:
+	template<class Grid>
+	Result batch_grids( std::vector<Grid*> const & grids, Atom const * atoms, size_t n ) const {
+		typedef float F;
+		int const BLOCK = 16;
+		// atoms are done in blocks: first gather grid params per atom into
+		// lanes, then the index math runs over the lanes without branches so
+		// it vectorizes, then the loads. uses the same division as
+		// floats_to_index so every atom lands in the same voxel as at() puts it
+		F pos[3][BLOCK], lb[3][BLOCK], cs[3][BLOCK], ext[3][BLOCK];
+		int64_t idx[3][BLOCK];
+		Grid const * grid[BLOCK];
+		bool clamp[BLOCK];
+		int valid[BLOCK];
+		Result total = 0;
+		for( size_t i0 = 0; i0 < n; i0 += BLOCK ){
+			int const m = n-i0 < (size_t)BLOCK ? n-i0 : BLOCK;
+			for( int k = 0; k < m; ++k ){
+				Atom const & a = atoms[i0+k];
+				grid[k] = grids[ a.type() ];
+				for( int d = 0; d < 3; ++d ){
+					pos[d][k] = a.position()[d];
+					lb[d][k] = grid[k]->lb_[d];
+					cs[d][k] = grid[k]->cs_[d];
+					ext[d][k] = grid[k]->shape()[d];
+				}
+				clamp[k] = REPL_ONLY || a.type() > 17;
+			}
+			for( int k = 0; k < m; ++k ){
+				F const t0 = ( pos[0][k] - lb[0][k] ) / cs[0][k];
+				F const t1 = ( pos[1][k] - lb[1][k] ) / cs[1][k];
+				F const t2 = ( pos[2][k] - lb[2][k] ) / cs[2][k];
+				// (-1,0) truncates to index 0, same as the size_t conversion in at()
+				int const ok = t0 > -1 & t0 < ext[0][k] & t1 > -1 & t1 < ext[1][k] & t2 > -1 & t2 < ext[2][k];
+				idx[0][k] = ok ? (int64_t)t0 : 0;
+				idx[1][k] = ok ? (int64_t)t1 : 0;
+				idx[2][k] = ok ? (int64_t)t2 : 0;
+				valid[k] = ok;
+			}
+			for( int k = 0; k < m; ++k ){
+				if( !valid[k] ) continue;
+				float const score = voxel_value( *grid[k], idx[0][k], idx[1][k], idx[2][k] );
+				total += clamp[k] ? std::max(0.0f,score) : score;
+			}
+		}
+		return total;
+	}
+	template<class VoxelArray>
+	static float voxel_value( VoxelArray const & g, int64_t i, int64_t j, int64_t k ){
+		return g.data()[ i*g.strides()[0] + j*g.strides()[1] + k*g.strides()[2] ];
+	}
+	static float voxel_value( objective::voxel::CompactVoxelArray const & g, int64_t i, int64_t j, int64_t k ){
+		return g.value( i, j, k );
+	}
 };
 template< class A, class B >
 std::ostream & operator<<( std::ostream & out, Score_Voxel_vs_Atom<A,B> const& si ){ return out << si.name(); }
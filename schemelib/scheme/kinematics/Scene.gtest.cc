@@ -149,6 +149,34 @@ TEST(Scene,test_visit_against_iteration){
 
 }
 
+TEST(Scene,moved_actor_cache_follows_changes){
+	typedef m::vector< ADI, FixedActor > Actors;
+	typedef Scene<impl::Conformation<Actors>,X1dim,size_t> Scene;
+	typedef std::pair<FixedActor,ADI> I;
+
+	Scene scene(3);
+	scene.add_actor( 0, FixedActor(1.0) );
+	scene.add_actor( 1, ADI(1,0) );
+	scene.add_actor( 1, ADI(2,0) );
+	scene.add_actor( 2, ADI(3,0) );
+	test_iterator_visitor_agree_for_interaction<I>(scene);
+	test_iterator_visitor_agree_for_interaction<I>(scene); // from cache
+
+	scene.set_position( 1, X1dim(10) );
+	test_iterator_visitor_agree_for_interaction<I>(scene);
+
+	scene.add_actor( 2, ADI(4,0) );
+	test_iterator_visitor_agree_for_interaction<I>(scene);
+
+	scene.set_position( 0, X1dim(-3) ); // moves the fixed frame, so all relative positions
+	test_iterator_visitor_agree_for_interaction<I>(scene);
+
+	scene.replace_body( 2, scene.conformation_ptr(1) );
+	test_iterator_visitor_agree_for_interaction<I>(scene);
+	AsymSetVisitor<I> v;
+	scene.visit(v);
+	ASSERT_EQ( v.set_.size(), 4 );
+}
 
 struct Config {};
 
@@ -19,6 +19,9 @@
 #include <boost/fusion/include/mpl.hpp>
 #include <boost/iterator/iterator_facade.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/mpl/find.hpp>
+#include <boost/mpl/distance.hpp>
+#include <boost/mpl/begin_end.hpp>
 
 #ifdef CEREAL
 #include <cereal/access.hpp>
@@ -27,6 +30,8 @@
 // #include <boost/serialization/access.hpp>
 // #include <boost/serialization/shared_ptr.hpp>
 
+#include <algorithm>
+#include <cstring>
 #include <vector>
 
 namespace scheme {
@@ -124,6 +129,7 @@ namespace impl {
 	using m::false_;
 	SCHEME_MEMBER_TYPE_DEFAULT_TEMPLATE(Symmetric,true_)
 	SCHEME_MEMBER_TYPE_DEFAULT_TEMPLATE(RequireAbsolutePositioning,false_)
+	SCHEME_MEMBER_TYPE_DEFAULT_TEMPLATE(AcceptsBatch,false_)
 
 	template<class _Interaction>
 	struct AccessVisitor {
@@ -153,6 +159,59 @@ namespace impl {
 		typedef m::true_ RequireAbsolutePositioning;
 	};
 
+	///@brief dst = Actor( src, p ). actors holding heap storage overload this
+	///       in their own namespace (found by ADL) to reuse dst's storage
+	template< class Actor, class Position >
+	void set_moved_actor( Actor & dst, Actor const & src, Position const & p ){ dst = Actor( src, p ); }
+
+	///@brief dst = Actor( rotated, translation ), where rotated was moved by a pure rotation
+	///       and translation is a pure translation. actors overload this to only add the
+	///       translation, which is what makes the rotation cache worth having
+	template< class Actor, class Position >
+	void translate_moved_actor( Actor & dst, Actor const & rotated, Position const & translation ){
+		set_moved_actor( dst, rotated, translation );
+	}
+
+	///@brief pos = translation * rotation, for positions that have a translation(). false
+	///       for other positions, which don't use the rotation cache
+	template< class Position >
+	auto split_rotation( Position const & pos, Position & rotation, Position & translation, int )
+		-> decltype( pos.translation(), bool() )
+	{
+		rotation = pos;
+		rotation.translation().setZero();
+		translation = Position::Identity();
+		translation.translation() = pos.translation();
+		return true;
+	}
+	template< class Position >
+	bool split_rotation( Position const &, Position &, Position &, long ){ return false; }
+
+	///@brief one body's actors moved by a pure rotation
+	template< class Actor, class Position >
+	struct RotatedActors {
+		std::vector<Actor> actors;
+		Position rotation;
+		uint64_t last_used = 0;
+	};
+
+	///@brief transformed copies of one body's actors of one type, valid while
+	///       source, body version and position are unchanged. rotated holds the
+	///       actors under the last few rotations, least recently used first to go,
+	///       so a move that only changes the translation skips rotating them
+	template< class Actor, class Position >
+	struct MovedActorCache {
+		std::vector<Actor> actors;
+		void const * source = nullptr;
+		uint64_t version = 0;
+		Position position;
+		bool valid = false;
+		std::vector< RotatedActors<Actor,Position> > rotated;
+		uint64_t clock = 0;
+	};
+	template< class Position >
+	struct moved_actor_cache_mfc { template<class Actor> struct apply { typedef MovedActorCache<Actor,Position> type; }; };
+
 	template<class T,class I> struct get_placeholder_type {
 		typedef typename std::pair<I,I> type; };
 	template<class T1, class T2,class I> struct get_placeholder_type<std::pair<T1,T2>,I> {
@@ -339,12 +398,23 @@ namespace impl {
 
 		Bodies bodies_;
 
-		Scene(Index nbodies=0) : SceneBase<Position,Index>() {
+		// per body (including symmetric copies), the actors moved into the frame
+		// of the fixed actors they're visited against. reused across visits and
+		// only redone, in place, when the body moves or changes, so visiting
+		// doesn't construct an actor per interaction. scenes are used one per
+		// thread, so this isn't locked
+		typedef util::meta::InstanceMap< Actors, impl::moved_actor_cache_mfc<Position> > MovedActors;
+		mutable std::vector< MovedActors > moved_actors_;
+		std::vector< uint64_t > body_versions_; // bumped whenever a body's actors may change
+		size_t rotation_cache_size_; // rotations kept per body and actor type, 0 is off
+
+		Scene(Index nbodies=0) : SceneBase<Position,Index>(), rotation_cache_size_(0) {
 			for(Index i=0; i<nbodies; ++i) add_body();
 			this->update_symmetry( (Index)bodies_.size() );
 		}
 
-		Scene( This const & o, bool deep = 1, std::vector<Index> const & deep_bodies = std::vector<Index>() ) : Base(o) {
+		Scene( This const & o, bool deep = 1, std::vector<Index> const & deep_bodies = std::vector<Index>() )
+			: Base(o), rotation_cache_size_( o.rotation_cache_size_ ) {
 			if( deep ){
 				bodies_.resize(o.bodies_.size());
 				if ( deep_bodies.size() == 0) {
@@ -408,6 +478,22 @@ namespace impl {
 	    }
 
 
+		///@brief keep the actors of each moving body under its last n rotations, so
+		///       moves that share a rotation, like samples that only differ in
+		///       translation, don't rotate every actor again. off (0) by default,
+		///       it uses n copies of the moving actors
+		virtual void set_rotation_cache_size( size_t n ){
+			rotation_cache_size_ = n;
+			moved_actors_.clear();
+		}
+		size_t rotation_cache_size() const { return rotation_cache_size_; }
+
+		uint64_t body_version( Index i ) const { return i < body_versions_.size() ? body_versions_[i] : 0; }
+		void bump_body_version( Index i ){
+			if( body_versions_.size() <= i ) body_versions_.resize( i+1, 0 );
+			++body_versions_[i];
+		}
+
 		/// mutators
 		void add_body(){
 			bodies_.push_back( make_shared<ConformationConst>() );
@@ -423,6 +509,7 @@ namespace impl {
 		}
 		// Replaces a body with an empty one without modifying it
 		void reset_body(Index i) {
+			bump_body_version( i );
 			bodies_.at(i).replace_conformation(make_shared<ConformationConst>());
 			this->positions_.at(i) = Position::Identity();
 			this->update_symmetry( (Index)bodies_.size() );
@@ -430,6 +517,7 @@ namespace impl {
 		// Replaces a body with another one
 		// Does not reset position
 		void replace_body(Index i, shared_ptr<ConformationConst> conformation) {
+			if( bodies_.at(i).conformation_ptr() != conformation ) bump_body_version( i );
 			bodies_.at(i).replace_conformation(conformation);
 			this->update_symmetry( (Index)bodies_.size() );
 		}
@@ -446,7 +534,10 @@ namespace impl {
 		// }
 		// void set_body(Index i, shared_ptr<ConformationConst> const & c){ bodies_[i] = c; }
 		// void set_body(Index i, Body const & b){ bodies_[i] = b; }
-		Conformation & mutable_conformation_asym(Index i) { return const_cast<Conformation&>(bodies_.at(i).conformation()); }
+		Conformation & mutable_conformation_asym(Index i) {
+			bump_body_version( i );
+			return const_cast<Conformation&>(bodies_.at(i).conformation());
+		}
 
 
 		Conformation const & conformation(Index i) const { return bodies_.at(i%bodies_.size()).conformation(); }
@@ -658,13 +749,19 @@ namespace impl {
 					Container2 const & container2 = c2.template get<Actor2>();
 					Position const rel_pos = inverse(__position_unsafe__(i1))*( __position_unsafe__(i2) );
 					ContInter::get_interaction_range( rel_pos, container1, container2, range );
+					std::vector<Actor2> const * moved2 = get_moved_actors2<Visitor,Actor1,Actor2>( i2, container2, rel_pos );
+					if( moved2 && visit_2b_batch<Actor1,Actor2>( visitor, container1, *moved2, range, i1<NBOD&&i2<NBOD?1.0:0.5 ) ) continue;
 					for( iter = get_cbegin(range),end  = get_cend(range); iter != end; ++iter){
 						double const w = i1<NBOD&&i2<NBOD?1.0:0.5;
 						Index j1,j2;
 						boost::tie(j1,j2) = *iter;
 						Actor1 const & a1_0( c1.template get<Actor1>()[j1] );
-						Actor2 const & a2_0( c2.template get<Actor2>()[j2] );
-						visit_2b_inner(visitor,a1_0,a2_0,p1,p2,rel_pos,w);
+						if( moved2 ){
+							visitor.template operator()< std::pair<Actor1,Actor2> >( a1_0, (*moved2)[j2], w );
+						} else {
+							Actor2 const & a2_0( c2.template get<Actor2>()[j2] );
+							visit_2b_inner(visitor,a1_0,a2_0,p1,p2,rel_pos,w);
+						}
 					}
 
 				}
@@ -672,6 +769,112 @@ namespace impl {
 
 		}
 
+		///@brief actors of body ib moved by pos, from the cache, refreshed in place if stale
+		template<class Actor, class Container>
+		std::vector<Actor> const &
+		moved_actors( Index ib, Container const & container, Position const & pos ) const {
+			if( moved_actors_.size() <= ib ) moved_actors_.resize( ib+1 );
+			impl::MovedActorCache<Actor,Position> & cache = moved_actors_[ib].template get<Actor>();
+			uint64_t const version = body_version( ib % bodies_.size() );
+			if( cache.valid && cache.source == (void const*)&container && cache.version == version
+				&& cache.actors.size() == container.size()
+				&& std::memcmp( (void const*)&cache.position, (void const*)&pos, sizeof(Position) ) == 0 )
+			{
+				return cache.actors;
+			}
+			cache.actors.resize( container.size() );
+			using impl::set_moved_actor;
+			Position rotation, translation;
+			if( rotation_cache_size_ && impl::split_rotation( pos, rotation, translation, 0 ) ){
+				if( cache.source != (void const*)&container || cache.version != version ) cache.rotated.clear();
+				impl::RotatedActors<Actor,Position> const & rotated = rotated_actors<Actor>( cache, container, rotation );
+				using impl::translate_moved_actor;
+				for( Index j = 0; j < container.size(); ++j ) translate_moved_actor( cache.actors[j], rotated.actors[j], translation );
+			} else {
+				Index j = 0;
+				BOOST_FOREACH( Actor const & a_0, container ) set_moved_actor( cache.actors[j++], a_0, pos );
+			}
+			cache.source = &container;
+			cache.version = version;
+			cache.position = pos;
+			cache.valid = true;
+			return cache.actors;
+		}
+
+		///@brief the actors moved by rotation, from the cache's lru or made in place of
+		///       its least recently used entry
+		template<class Actor, class Container>
+		impl::RotatedActors<Actor,Position> const &
+		rotated_actors( impl::MovedActorCache<Actor,Position> & cache, Container const & container, Position const & rotation ) const {
+			impl::RotatedActors<Actor,Position> * found = nullptr;
+			for( auto & r : cache.rotated ){
+				if( std::memcmp( (void const*)&r.rotation, (void const*)&rotation, sizeof(Position) ) == 0 ){ found = &r; break; }
+			}
+			if( !found ){
+				if( cache.rotated.size() < rotation_cache_size_ ){
+					cache.rotated.resize( cache.rotated.size()+1 );
+					found = &cache.rotated.back();
+				} else {
+					found = &*std::min_element( cache.rotated.begin(), cache.rotated.end(),
+						[]( impl::RotatedActors<Actor,Position> const & a, impl::RotatedActors<Actor,Position> const & b ){
+							return a.last_used < b.last_used; } );
+				}
+				found->rotation = rotation;
+				found->actors.resize( container.size() );
+				using impl::set_moved_actor;
+				Index j = 0;
+				BOOST_FOREACH( Actor const & a_0, container ) set_moved_actor( found->actors[j++], a_0, rotation );
+			}
+			found->last_used = ++cache.clock;
+			return *found;
+		}
+
+		///@brief the case visit_2b_inner handles by moving Actor2 into Actor1's frame
+		///       gets its moved actors from the cache, other cases return nullptr
+		template<class Visitor, class Actor1, class Actor2, class Container2>
+		typename boost::enable_if<
+			m::and_<
+				m::not_<impl::get_RequireAbsolutePositioning_false_<Visitor> >,
+				impl::has_type_Position<Actor2>
+			>, std::vector<Actor2> const * >::type
+		get_moved_actors2( Index i2, Container2 const & container2, Position const & rel_pos ) const {
+			return &moved_actors<Actor2>( i2, container2, rel_pos );
+		}
+		template<class Visitor, class Actor1, class Actor2, class Container2>
+		typename boost::disable_if<
+			m::and_<
+				m::not_<impl::get_RequireAbsolutePositioning_false_<Visitor> >,
+				impl::has_type_Position<Actor2>
+			>, std::vector<Actor2> const * >::type
+		get_moved_actors2( Index , Container2 const & , Position const & ) const {
+			return nullptr;
+		}
+
+		///@brief if the visitor takes batches and the range is all pairs, hand each actor1
+		///       to the visitor with the whole moved actor2 array. false if not done
+		template<class Actor1, class Actor2, class Visitor, class Container1, class ContRange>
+		typename boost::enable_if< typename impl::get_AcceptsBatch_false_<Visitor>::type, bool >::type
+		visit_2b_batch(
+			Visitor & visitor,
+			Container1 const & container1,
+			std::vector<Actor2> const & moved2,
+			ContRange const &,
+			double w
+		) const {
+			typedef util::container::ContainerInteractionsIter<Index> AllPairsIter;
+			if( !boost::is_same< ContRange, std::pair<AllPairsIter,AllPairsIter> >::value ) return false;
+			if( moved2.empty() ) return true;
+			for( Index j1 = 0; j1 < container1.size(); ++j1 ){
+				visitor.template visit_batch< std::pair<Actor1,Actor2> >( container1[j1], &moved2[0], moved2.size(), w );
+			}
+			return true;
+		}
+		template<class Actor1, class Actor2, class Visitor, class Container1, class ContRange>
+		typename boost::disable_if< typename impl::get_AcceptsBatch_false_<Visitor>::type, bool >::type
+		visit_2b_batch( Visitor &, Container1 const &, std::vector<Actor2> const &, ContRange const &, double ) const {
+			return false;
+		}
+
 		///@brief visit_2b_inner specialization handles case where both actors are positionable (not fixed)
 		template<class Visitor, class Actor1, class Actor2>
 		typename boost::enable_if<
@@ -113,6 +113,8 @@ struct SceneBase {
 
 	virtual void replace_body( Index ib, shared_ptr<ConformationBase const> cb) {}
 
+	virtual void set_rotation_cache_size( size_t n ) {}
+
 };
 
 
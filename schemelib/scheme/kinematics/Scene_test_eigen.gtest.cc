@@ -176,6 +176,38 @@ TEST(Scene_eigen,relative_relations_preserved){
 	// ASSERT_TRUE( xa.isApprox(xr) );
 }
 
+TEST(Scene_eigen,rotation_cache_same_scores){
+	typedef	objective::ObjectiveFunction< m::vector< ScoreXX >, Config > ObjFun;
+	ObjFun score;
+
+	typedef m::vector< Xactor > Actors;
+	typedef Scene<impl::Conformation<Actors>,Xform> Scene;
+
+	Scene plain(2);
+	plain.set_position(0,Xform(Vec(1,2,3),0.3,UZ));
+	plain.mutable_conformation_asym(0).add_actor( Xactor(Xform(Vec(1,3,1),1,UY),7) );
+	plain.mutable_conformation_asym(0).add_actor( Xactor(Xform(Vec(-2,0,1),2,UX),7) );
+	for( int i = 0; i < 5; ++i ){
+		plain.mutable_conformation_asym(1).add_actor( Xactor(Xform(Vec(i,4,7-i),0.5*i,UZ),7) );
+	}
+	for( size_t cache_size : { 1, 2, 8 } ){
+		Scene cached( plain );
+		cached.set_rotation_cache_size( cache_size );
+		ASSERT_EQ( cache_size, Scene( cached ).rotation_cache_size() );
+		// translations cycling within each of a few rotations, interleaved like nest children
+		for( int k = 0; k < 30; ++k ){
+			if( k == 20 ){
+				plain .mutable_conformation_asym(1).add_actor( Xactor(Xform(Vec(9,9,9),1,UX),7) );
+				cached.mutable_conformation_asym(1).add_actor( Xactor(Xform(Vec(9,9,9),1,UX),7) );
+			}
+			Xform x( Vec( k/3, 2*(k/3), 1 ), 0.7*(k%3), UY );
+			plain .set_position(1,x);
+			cached.set_position(1,x);
+			ASSERT_NEAR( score(plain).sum(), score(cached).sum(), 1e-9 );
+		}
+	}
+}
+
 // TEST(Scene_eigen,symmetry){
 // 	typedef	objective::ObjectiveFunction<
 // 		m::vector<
@@ -180,6 +180,50 @@ namespace impl {
 	SCHEME_MEMBER_TYPE_DEFAULT_TEMPLATE(UseVisitor,false_)
 	SCHEME_MEMBER_TYPE_DEFAULT_TEMPLATE(HasPre,false_)
 	SCHEME_MEMBER_TYPE_DEFAULT_TEMPLATE(HasPost,false_)
+	SCHEME_MEMBER_TYPE_DEFAULT_TEMPLATE(HasBatch,false_)
+
+	///@brief helper functor to call objective for one actor1 against a contiguous array of actor2
+	///@detail objectives with HasBatch get one call to batch( actor1, actor2s, n, config ), which must
+	///        return the sum over the array, the rest are called per pair as in EvalObjectiveSplitPair
+	template<
+		class Interaction,
+		class Results,
+		class Scratches,
+		class Config
+	>
+	struct EvalObjectiveBatch {
+		typename Interaction::first_type const & actor_1;
+		typename Interaction::second_type const * actor_2s;
+		size_t n;
+		Results & results;
+		Scratches & scratches;
+		Config const & config;
+		double weight;
+		EvalObjectiveBatch(
+			typename Interaction::first_type const & i,
+			typename Interaction::second_type const * js,
+			size_t nj,
+			Results & r,
+			Scratches & s,
+			Config const & c,
+			double w
+		) : actor_1(i),actor_2s(js),n(nj),results(r),scratches(s),config(c),weight(w) {}
+
+		template<class Objective>
+		typename boost::enable_if<typename get_HasBatch_false_<Objective>::type>::type
+		operator()(Objective const & objective) const {
+			BOOST_STATIC_ASSERT(( f::result_of::has_key<typename Results::FusionType,Objective>::value ));
+			results.template get<Objective>() += weight*objective.batch( actor_1, actor_2s, n, config );
+		}
+		template<class Objective>
+		typename boost::disable_if<typename get_HasBatch_false_<Objective>::type>::type
+		operator()(Objective const & objective) const {
+			for( size_t j = 0; j < n; ++j ){
+				EvalObjectiveSplitPair< Interaction, Results, Scratches, Config >
+					( actor_1, actor_2s[j], results, scratches, config, weight )( objective );
+			}
+		}
+	};
 
 	template<class InteractionSource, class Placeholder>
 	typename boost::disable_if<typename get_DefinesInteractionWeight_false_<InteractionSource>::type,double>::type
@@ -438,6 +482,7 @@ namespace impl {
 
 		typedef _Interaction Interaction;
 		typedef m::false_ Symmetric;
+		typedef m::true_ AcceptsBatch;
 
 		Objectives const & objectives_;
 		Results & results_;
@@ -476,6 +521,25 @@ namespace impl {
 					         ( a1, a2, results_, scratches_, config_, weight )
 			);
 		}
+		///@brief a1 against each of a2s[0..n), same as calling the pair operator() n times
+		#ifdef CXX11
+			template< class I = Interaction >
+		#else
+			template< class I >
+		#endif
+		typename boost::enable_if< util::meta::is_pair<I> , void >::type
+		visit_batch(
+			typename I::first_type const & a1,
+			typename I::second_type const * a2s,
+			size_t n,
+			double weight=1.0
+		) {
+			f::for_each(
+				objectives_,
+				EvalObjectiveBatch< I, Results, Scratches, Config >
+					         ( a1, a2s, n, results_, scratches_, config_, weight )
+			);
+		}
 
 	};
 
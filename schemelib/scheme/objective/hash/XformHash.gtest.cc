@@ -309,6 +309,58 @@ TEST( XformHash, XformHash_Quat_BCC7_Zorder_cart_shift ){
 
 }
 
+template< class X >
+void check_batch_get_keys_match( double cart_resl, double ang_resl, int N, unsigned int seed ){
+	typedef typename X::Scalar F;
+	XformHash_Quat_BCC7_Zorder<X> h( (F)cart_resl, (F)ang_resl, (F)512.0 );
+	std::mt19937 rng( seed );
+	std::vector<X> xs( N );
+	for( int i = 0; i < N; ++i ){
+		Xform tmp;
+		numeric::rand_xform( rng, tmp, 256.0 );
+		xs[i] = tmp.cast<typename X::Scalar>();
+	}
+	// identity and 180 degree rotations exercise the trace <= 0 branches and the half cell ties
+	for( int i = 0; i < 4; ++i ){
+		X x = X::Identity();
+		if( i ) x.linear() = Eigen::AngleAxis<typename X::Scalar>( M_PI, Eigen::Matrix<typename X::Scalar,3,1>::Unit(i-1) ).toRotationMatrix();
+		xs.push_back( x );
+		xs.push_back( x.inverse() );
+	}
+	std::vector<uint64_t> keys( xs.size() );
+	for( size_t n : { xs.size(), (size_t)1, (size_t)17 } ){
+		h.get_keys( &xs[0], &keys[0], n );
+		for( size_t i = 0; i < n; ++i ) ASSERT_EQ( h.get_key( xs[i] ), keys[i] ) << i;
+	}
+	h.get_keys( &xs[0], &keys[0], xs.size() );
+	for( size_t i = 0; i < xs.size(); ++i ) ASSERT_EQ( h.get_key( xs[i] ), keys[i] ) << i;
+}
+
+TEST( XformHash, XformHash_Quat_BCC7_Zorder_batch_get_keys ){
+	int N = 10*1000;
+	#ifdef SCHEME_BENCHMARK
+	N = 1*1000*1000;
+	#endif
+	typedef Eigen::Transform<float,3,Eigen::AffineCompact> Xformf;
+	check_batch_get_keys_match< Xform  >( 1.0, 15.0, N, 1 );
+	check_batch_get_keys_match< Xform  >( 0.25, 5.0, N, 2 );
+	check_batch_get_keys_match< Xformf >( 1.0, 15.0, N, 3 );
+	check_batch_get_keys_match< Xformf >( 0.25, 5.0, N, 4 );
 
+	#ifdef SCHEME_BENCHMARK
+	XformHash_Quat_BCC7_Zorder<Xform> h( 0.5, 10.0, 512.0 );
+	std::mt19937 rng( 5 );
+	std::vector<Xform> xs( N );
+	for( auto & x : xs ) numeric::rand_xform( rng, x, 256.0 );
+	std::vector<uint64_t> keys( N );
+	util::Timer<> t1;
+	for( int i = 0; i < N; ++i ) keys[i] = h.get_key( xs[i] );
+	double time_single = t1.elapsed();
+	util::Timer<> t2;
+	h.get_keys( &xs[0], &keys[0], N );
+	double time_batch = t2.elapsed();
+	cout << "get_key " << time_single/N*1e9 << "ns, get_keys " << time_batch/N*1e9 << "ns" << endl;
+	#endif
+}
 
 }}}}
@@ -124,6 +124,102 @@ struct XformHash_Quat_BCC7_Zorder {
 		return key;
 	}
 
+	// Batched get_key, bit-identical to it. Each block of BATCH xforms is
+	// transposed to structure-of-arrays and every stage (rotation->quaternion,
+	// half cell, bcc rounding, dilation) runs as a branch-free loop over the
+	// block, so the compiler can vectorize across xforms when built with
+	// -march=native or similar; otherwise this is a plain scalar loop.
+	static int const BATCH = 16;
+	void get_keys( Xform const * xs, Key * out, size_t n ) const {
+		for( size_t b = 0; b < n; b += BATCH ){
+			int const nb = std::min( (size_t)BATCH, n-b );
+			get_keys_block( xs+b, out+b, nb );
+		}
+	}
+
+	void get_keys_block( Xform const * xs, Key * out, int const nb ) const {
+		Float m[9][BATCH], f7[7][BATCH];
+		for( int l = 0; l < nb; ++l ){
+			for( int i = 0; i < 9; ++i ) m[i][l] = xs[l].data()[i];
+			for( int i = 0; i < 3; ++i ) f7[i][l] = xs[l].translation()[i];
+		}
+		for( int l = nb; l < BATCH; ++l ){
+			for( int i = 0; i < 9; ++i ) m[i][l] = i%4==0 ? 1 : 0;
+			for( int i = 0; i < 3; ++i ) f7[i][l] = 0;
+		}
+		// same arithmetic, in the same order, as Eigen::Quaternion( Matrix3 ),
+		// all four branches are evaluated and the right one selected per lane
+		for( int l = 0; l < BATCH; ++l ){
+			Float const m00 = m[0][l], m10 = m[1][l], m20 = m[2][l];
+			Float const m01 = m[3][l], m11 = m[4][l], m21 = m[5][l];
+			Float const m02 = m[6][l], m12 = m[7][l], m22 = m[8][l];
+			Float const tr = m00 + ( m11 + m22 );
+			Float const t = std::sqrt( tr + Float(1.0) );
+			Float const s = Float(0.5) / t;
+			Float const t0 = std::sqrt( m00 - m11 - m22 + Float(1.0) );
+			Float const s0 = Float(0.5) / t0;
+			Float const t1 = std::sqrt( m11 - m22 - m00 + Float(1.0) );
+			Float const s1 = Float(0.5) / t1;
+			Float const t2 = std::sqrt( m22 - m00 - m11 + Float(1.0) );
+			Float const s2 = Float(0.5) / t2;
+			bool const pos = tr > Float(0);
+			bool const i1 = m11 > m00;
+			bool const i2 = m22 > ( i1 ? m11 : m00 );
+			bool const i0 = !i1 && !i2;
+			Float w, x, y, z;
+			if( pos ){
+				w = Float(0.5)*t; x = (m21-m12)*s; y = (m02-m20)*s; z = (m10-m01)*s;
+			} else if( i2 ){
+				w = (m10-m01)*s2; x = (m02+m20)*s2; y = (m12+m21)*s2; z = Float(0.5)*t2;
+			} else if( i0 ){
+				w = (m21-m12)*s0; x = Float(0.5)*t0; y = (m10+m01)*s0; z = (m20+m02)*s0;
+			} else {
+				w = (m02-m20)*s1; x = (m01+m10)*s1; y = Float(0.5)*t1; z = (m21+m12)*s1;
+			}
+			// numeric::to_half_cell
+			bool const flip = numeric::is_not_0(w) ? !(w>0) : (
+			                  numeric::is_not_0(x) ? !(x>0) : (
+			                  numeric::is_not_0(y) ? !(y>0) : !(z>0) ) );
+			f7[3][l] = flip ? -w : w;
+			f7[4][l] = flip ? -x : x;
+			f7[5][l] = flip ? -y : y;
+			f7[6][l] = flip ? -z : z;
+		}
+		// BCC::get_indices
+		uint64_t i7[7][BATCH], c7[7][BATCH];
+		Float sum[BATCH];
+		for( int l = 0; l < BATCH; ++l ) sum[l] = 0;
+		for( int d = 0; d < 7; ++d ){
+			Float const lower = grid_.lower_[d], width = grid_.width_[d];
+			for( int l = 0; l < BATCH; ++l ){
+				Float v = ( f7[d][l] - lower ) / width;
+				uint64_t const idx = v;
+				v = v - (Float)idx;
+				v -= 0.5;
+				i7[d][l] = idx;
+				c7[d][l] = idx - ( v < 0 );
+				Float const sign = v > 0 ? 1.0 : -1.0;
+				sum[l] += sign * v;
+			}
+		}
+		for( int l = 0; l < nb; ++l ){
+			bool const odd = (0.25 * 7) < fabs( sum[l] );
+			Key key = odd;
+			for( int d = 0; d < 7; ++d ) if( odd ) i7[d][l] = c7[d][l];
+			key = key | (i7[0][l]>>6)<<57;
+			key = key | (i7[1][l]>>6)<<50;
+			key = key | (i7[2][l]>>6)<<43;
+			key = key | util::dilate<7>( i7[0][l] & 63 ) << 1;
+			key = key | util::dilate<7>( i7[1][l] & 63 ) << 2;
+			key = key | util::dilate<7>( i7[2][l] & 63 ) << 3;
+			key = key | util::dilate<7>( i7[3][l]      ) << 4;
+			key = key | util::dilate<7>( i7[4][l]      ) << 5;
+			key = key | util::dilate<7>( i7[5][l]      ) << 6;
+			key = key | util::dilate<7>( i7[6][l]      ) << 7;
+			out[l] = key;
+		}
+	}
+
 	I7 get_indices(Key key, bool & odd) const {
 		odd = key & (Key)1;
 		I7 i7;
@@ -1051,6 +1147,16 @@ struct XformHash_Quatgrid_Cubic {
 
 
 
+// batched key computation for any hasher; hashers with a faster batch path overload this
+template< class Hasher, class Xform >
+void get_keys( Hasher const & hasher, Xform const * xs, uint64_t * keys, size_t n ){
+	for( size_t i = 0; i < n; ++i ) keys[i] = hasher.get_key( xs[i] );
+}
+template< class Xform >
+void get_keys( XformHash_Quat_BCC7_Zorder<Xform> const & hasher, Xform const * xs, uint64_t * keys, size_t n ){
+	hasher.get_keys( xs, keys, n );
+}
+
 }}}
 
 #endif
@@ -78,6 +78,100 @@ TEST( XformMap, stores_correctly ){
 
 }
 
+TEST( XformMap, flat_mmap_matches_hashmap ){
+	int NSAMP = 100000;
+
+	std::mt19937 rng((unsigned int)time(0) + 8734234);
+	std::uniform_real_distribution<> runif;
+
+	typedef XformMap< Xform, double, XformHash_bt24_BCC6 > XMap;
+	XMap xmap( 0.5, 10.0 );
+	std::vector< std::pair<Xform,double> > dat;
+	for(int i = 0; i < NSAMP; ++i){
+		Xform x;
+		numeric::rand_xform( rng, x, 256.0 );
+		double val = runif(rng);
+		xmap.insert(x,val);
+		dat.push_back( std::make_pair(x,val) );
+	}
+
+	{
+		std::ofstream out( "test_flat.sxm", std::ios::binary );
+		out.write( "pre", 3 ); // flat tables need not start at the beginning of the file
+		ASSERT_TRUE( xmap.save_flat( out, "flat foo" ) );
+		out.close();
+	}
+
+	XMap xmap_flat;
+	std::string description;
+	ASSERT_TRUE( xmap_flat.load_flat( "test_flat.sxm", description, 3 ) );
+	ASSERT_TRUE( xmap_flat.is_flat() );
+	ASSERT_EQ( description, "flat foo" );
+	ASSERT_EQ( xmap.cart_resl_, xmap_flat.cart_resl_ );
+	ASSERT_EQ( xmap.ang_resl_, xmap_flat.ang_resl_ );
+	ASSERT_EQ( xmap.size(), xmap_flat.size() );
+	ASSERT_EQ( xmap_flat.map_.size(), 0 );
+
+	util::Timer<> t;
+	for(int i = 0; i < dat.size(); ++i){
+		ASSERT_EQ( xmap_flat[dat[i].first], xmap[dat[i].first] );
+	}
+	cout << "XformMap flat " << NSAMP << " lookup rate: " << (double)NSAMP / t.elapsed() << " /sec " << endl;
+
+	// misses
+	for(int i = 0; i < NSAMP; ++i){
+		Xform x;
+		numeric::rand_xform( rng, x, 256.0 );
+		ASSERT_EQ( xmap_flat[x], xmap[x] );
+	}
+
+	size_t nflat = 0;
+	xmap_flat.for_each_entry( [&]( XMap::Key k, double v ){ ++nflat; ASSERT_EQ( xmap[k], v ); } );
+	ASSERT_EQ( nflat, xmap.size() );
+
+	XformMap< Xform, double > wrong_hasher;
+	std::cout << "following failure message is expected" << std::endl;
+	ASSERT_FALSE( wrong_hasher.load_flat( "test_flat.sxm", description, 3 ) );
+}
+
+TEST( XformMap, batch_lookup_matches_single ){
+	int NSAMP = 10000;
+
+	std::mt19937 rng((unsigned int)time(0) + 2349870);
+	std::uniform_real_distribution<> runif;
+
+	typedef XformMap< Xform, double, XformHash_bt24_BCC6 > XMap;
+	XMap xmap( 0.5, 10.0 );
+	std::vector<Xform> xs;
+	for(int i = 0; i < NSAMP; ++i){
+		Xform x;
+		numeric::rand_xform( rng, x, 64.0 );
+		if( i%2 ) xmap.insert( x, runif(rng) ); // half misses
+		xs.push_back( x );
+	}
+
+	std::vector<XMap::Key> keys( NSAMP );
+	std::vector<double> vals( NSAMP );
+	xmap.lookup( &xs[0], NSAMP, &keys[0], &vals[0] );
+	for(int i = 0; i < NSAMP; ++i){
+		ASSERT_EQ( keys[i], xmap.get_key( xs[i] ) );
+		ASSERT_EQ( vals[i], xmap[ xs[i] ] );
+	}
+
+	{
+		std::ofstream out( "test_batch_flat.sxm", std::ios::binary );
+		ASSERT_TRUE( xmap.save_flat( out, "" ) );
+	}
+	XMap xmap_flat;
+	std::string description;
+	ASSERT_TRUE( xmap_flat.load_flat( "test_batch_flat.sxm", description ) );
+	std::vector<double> flat_vals( NSAMP );
+	xmap_flat.lookup( &keys[0], NSAMP, &flat_vals[0] );
+	for(int i = 0; i < NSAMP; ++i){
+		ASSERT_EQ( flat_vals[i], vals[i] );
+	}
+}
+
 double get_ident_lever_dis( Xform x, double lever_dis ){
 	util::SimpleArray<7,double> x_lever_coord;
 	x_lever_coord[0] = x.translation()[0];
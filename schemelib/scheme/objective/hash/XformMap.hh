@@ -15,6 +15,17 @@
 
 #include <sparsehash/dense_hash_map>
 
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #ifdef USE_OPENMP
 #include <omp.h>
 #endif
@@ -42,6 +53,32 @@ struct XfromMapSerializer {
 };
 
 
+// fixed size header for the flat (mmap-able) XformMap format
+// the bucket table is an open-addressing array of XformMap::FlatEntry
+// starting at table_offset (absolute, page aligned) in the file
+struct XformMapFlatHeader {
+	char     magic[16];
+	uint64_t version;
+	char     hasher_name[64];
+	double   cart_resl, ang_resl, cart_bound;
+	uint64_t sizeof_key, sizeof_value, sizeof_entry;
+	uint64_t n_entries, n_buckets;
+	uint64_t description_size;
+	uint64_t table_offset;
+	static char const * MAGIC() { return "SchemeXMapFlat"; }
+	static uint64_t VERSION() { return 1; }
+};
+
+// stateless 64 bit mixer so probe sequences are identical in every process
+inline uint64_t xform_map_flat_hash( uint64_t k ){
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+	return k;
+}
+
 template<
 	class _Xform,
 	// class Value=numeric::FixedPoint<-17>,
@@ -70,6 +107,13 @@ struct XformMap {
  //    omp_lock_t insert_lock;
 	// #endif
 
+	// read-only flat table, set by load_flat, map_ is unused when this is set
+	struct FlatEntry { Key first; Value second; };
+	std::shared_ptr<void const> flat_mapping_;
+	FlatEntry const * flat_table_ = nullptr;
+	uint64_t flat_mask_ = 0;
+	size_t flat_size_ = 0;
+
 	XformMap( Float cart_resl=-1.0, Float ang_resl=-1.0, Float cart_bound=512.0 ){
 		init( cart_resl, ang_resl, cart_bound );
 	}
@@ -94,7 +138,9 @@ struct XformMap {
 		// #endif
 	}
 
-	void clear() { map_.clear(); }
+	void clear() { map_.clear(); unmap_flat(); }
+
+	bool is_flat() const { return flat_table_ != nullptr; }
 
 	bool insert( Key k, Value val ){
 		map_.insert( std::make_pair(k,val) );
@@ -130,6 +176,7 @@ struct XformMap {
 		// typename Map::const_iterator iter = map_.find(k0);
 		// if( iter == map_.end() ){ return Value(); }
 		// return iter->second[k1];
+		if( flat_table_ ) return flat_find( k );
 		typename Map::const_iterator iter = map_.find(k);
 		if( iter == map_.end() ){ return Value(); }
 		return iter->second;
@@ -142,6 +189,39 @@ struct XformMap {
         return hasher_.get_key(x);
     }
 
+	// address of the first bucket probed when looking up k
+	// for the dense_hash_map this leans on sparsehash internals: the table is
+	// one contiguous array that end().pos points one past, and probing starts
+	// at hash & (bucket_count-1). the check below catches a change of map type,
+	// a sparsehash upgrade that moves the table would need this revisited
+	void const * bucket_address( Key k ) const {
+		static_assert( std::is_same< typename std::decay< decltype( std::declval<typename Map::const_iterator>().pos ) >::type,
+		                             typename Map::value_type const * >::value,
+		               "bucket_address assumes a sparsehash dense_hash_map const_iterator with a raw pos pointer" );
+		if( flat_table_ ) return &flat_table_[ xform_map_flat_hash( k ) & flat_mask_ ];
+		size_t const nbuckets = map_.bucket_count();
+		typename Map::value_type const * table = map_.end().pos - nbuckets;
+		return table + ( map_.hash_funct()( k ) & (nbuckets-1) );
+	}
+	void prefetch( Key k ) const { __builtin_prefetch( bucket_address( k ) ); }
+
+	// batched lookup: hash everything, prefetch every bucket, then resolve,
+	// so the cache misses overlap instead of being paid one after another
+	void get_keys( Xform const * xs, size_t n, Key * keys ) const {
+		hash::get_keys( hasher_, xs, keys, n );
+	}
+	void prefetch( Key const * keys, size_t n ) const {
+		for( size_t i = 0; i < n; ++i ) prefetch( keys[i] );
+	}
+	void lookup( Key const * keys, size_t n, Value * out ) const {
+		prefetch( keys, n );
+		for( size_t i = 0; i < n; ++i ) out[i] = this->operator[]( keys[i] );
+	}
+	void lookup( Xform const * xs, size_t n, Key * keys, Value * out ) const {
+		get_keys( xs, n, keys );
+		lookup( keys, n, out );
+	}
+
     Xform get_center( Key k ) const {
         return hasher_.get_center(k);
     }
@@ -196,10 +276,38 @@ struct XformMap {
 
 	}
 
-	size_t size() const { return map_.size(); }//*(1<<ArrayBits); }
+	size_t size() const { return flat_table_ ? flat_size_ : map_.size(); }//*(1<<ArrayBits); }
 	// size_t total_size() const { return map_.size(); }//*(1<<ArrayBits); }
 
-	size_t mem_use() const { return map_.bucket_count()*(sizeof(Key)+sizeof(Value)); } //*sizeof(ValArray); }
+	size_t bucket_count() const { return flat_table_ ? flat_mask_+1 : map_.bucket_count(); }
+
+	size_t mem_use() const { return bucket_count()*(sizeof(Key)+sizeof(Value)); } //*sizeof(ValArray); }
+
+	// calls f( key, value ) for every stored entry, flat or not
+	template< class F >
+	void for_each_entry( F f ) const {
+		if( flat_table_ ){
+			for( uint64_t i = 0; i <= flat_mask_; ++i ){
+				if( flat_table_[i].first != std::numeric_limits<Key>::max() ){
+					f( flat_table_[i].first, flat_table_[i].second );
+				}
+			}
+		} else {
+			for(typename Map::const_iterator i = map_.begin(); i != map_.end(); ++i){
+				f( i->first, i->second );
+			}
+		}
+	}
+
+	Value flat_find( Key k ) const {
+		uint64_t i = xform_map_flat_hash( k ) & flat_mask_;
+		while( true ){
+			FlatEntry const & e = flat_table_[i];
+			if( e.first == k ) return e.second;
+			if( e.first == std::numeric_limits<Key>::max() ) return Value();
+			i = (i+1) & flat_mask_;
+		}
+	}
 
 	size_t count( Value val ) const {
 		// int count = 0;
@@ -210,17 +318,14 @@ struct XformMap {
 		// }
 		// retrn count;
 
-		int count = 0;
-		for(typename Map::const_iterator i = map_.begin(); i != map_.end(); ++i){
-			if( i->second == val ) ++count;
-		}
+		size_t count = 0;
+		for_each_entry( [&]( Key, Value const & v ){ if( v == val ) ++count; } );
 		return count;
 
 	}
-	size_t count_not( Value val ) const {		int count = 0;
-		for(typename Map::const_iterator i = map_.begin(); i != map_.end(); ++i){
-			if( i->second != val ) ++count;
-		}
+	size_t count_not( Value val ) const {
+		size_t count = 0;
+		for_each_entry( [&]( Key, Value const & v ){ if( v != val ) ++count; } );
 		return count;
 	}
 
@@ -324,6 +429,147 @@ struct XformMap {
 		return load(in,dummy);
 	}
 
+	// Flat format: XformMapFlatHeader, description, then an open-addressing bucket
+	// table at a page aligned offset. Must be written to an uncompressed, seekable
+	// stream; the table can then be mmaped by load_flat and queried in place, so
+	// every process on a node shares the same physical pages through the page cache
+	bool save_flat( std::ostream & out, std::string const & description ) const {
+		if( cart_resl_ == -1 || ang_resl_ == -1 || cart_bound_ == -1 ){
+			std::cerr << "XformMap::save_flat: bad cart_resl_, ang_resl_, or cart_bound_ " << cart_resl_ << " " << ang_resl_ << " " << cart_bound_ << std::endl;
+			return false;
+		}
+		if( hasher_.name().size() >= 64 ){
+			std::cerr << "XformMap::save_flat: hasher name too long " << hasher_.name() << std::endl;
+			return false;
+		}
+		// same max load as dense_hash_map so mem use is unchanged
+		uint64_t n_buckets = 64;
+		while( n_buckets < 2*size() ) n_buckets *= 2;
+
+		std::streamoff const start = out.tellp();
+		if( start < 0 ){
+			std::cerr << "XformMap::save_flat: stream is not seekable" << std::endl;
+			return false;
+		}
+		XformMapFlatHeader header;
+		std::memset( &header, 0, sizeof(XformMapFlatHeader) );
+		std::strncpy( header.magic, XformMapFlatHeader::MAGIC(), 15 );
+		std::strncpy( header.hasher_name, hasher_.name().c_str(), 63 );
+		header.version = XformMapFlatHeader::VERSION();
+		header.cart_resl = cart_resl_;
+		header.ang_resl = ang_resl_;
+		header.cart_bound = cart_bound_;
+		header.sizeof_key = sizeof(Key);
+		header.sizeof_value = sizeof(Value);
+		header.sizeof_entry = sizeof(FlatEntry);
+		header.n_entries = size();
+		header.n_buckets = n_buckets;
+		header.description_size = description.size();
+		uint64_t const page = 4096;
+		uint64_t const desc_end = start + sizeof(XformMapFlatHeader) + description.size();
+		header.table_offset = ( desc_end + page - 1 ) / page * page;
+
+		out.write( (char*)&header, sizeof(XformMapFlatHeader) );
+		out.write( description.c_str(), description.size() );
+		for( uint64_t i = desc_end; i < header.table_offset; ++i ) out.put(0);
+
+		std::vector<FlatEntry> table( n_buckets );
+		for( auto & e : table ){
+			e.first = std::numeric_limits<Key>::max();
+			e.second = Value();
+		}
+		uint64_t const mask = n_buckets-1;
+		for_each_entry( [&]( Key k, Value const & v ){
+			uint64_t i = xform_map_flat_hash( k ) & mask;
+			while( table[i].first != std::numeric_limits<Key>::max() ) i = (i+1) & mask;
+			table[i].first = k;
+			table[i].second = v;
+		});
+		out.write( (char*)&table[0], n_buckets*sizeof(FlatEntry) );
+		if( !out.good() ){
+			std::cerr << "XformMap::save_flat: write failed" << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	// mmap a table written by save_flat, header starts at byte offset in fname
+	bool load_flat( std::string const & fname, std::string & description, size_t offset=0 ) {
+		int fd = ::open( fname.c_str(), O_RDONLY );
+		if( fd < 0 ){
+			std::cerr << "XformMap::load_flat, can't open " << fname << std::endl;
+			return false;
+		}
+		struct stat st;
+		if( ::fstat( fd, &st ) != 0 || (size_t)st.st_size < offset+sizeof(XformMapFlatHeader) ){
+			std::cerr << "XformMap::load_flat, file too small " << fname << std::endl;
+			::close( fd );
+			return false;
+		}
+		size_t const file_size = st.st_size;
+		void * addr = ::mmap( nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0 );
+		::close( fd );
+		if( addr == MAP_FAILED ){
+			std::cerr << "XformMap::load_flat, mmap failed " << fname << std::endl;
+			return false;
+		}
+		std::shared_ptr<void const> mapping( addr, [file_size]( void const * p ){ ::munmap( const_cast<void*>(p), file_size ); } );
+		char const * base = static_cast<char const *>( addr );
+
+		XformMapFlatHeader header;
+		std::memcpy( &header, base+offset, sizeof(XformMapFlatHeader) );
+		if( std::strncmp( header.magic, XformMapFlatHeader::MAGIC(), 16 ) != 0 ){
+			std::cerr << "XformMap::load_flat, not a flat XformMap file " << fname << std::endl;
+			return false;
+		}
+		if( header.version != XformMapFlatHeader::VERSION() ){
+			std::cerr << "XformMap::load_flat, version mismatch, expected " << XformMapFlatHeader::VERSION() << " got " << header.version << std::endl;
+			return false;
+		}
+		if( hasher_.name() != std::string( header.hasher_name ) ){
+			std::cerr << "XformMap::load_flat, hasher type mismatch, expected " << hasher_.name() << " got "  << header.hasher_name << std::endl;
+			return false;
+		}
+		if( header.sizeof_key != sizeof(Key) || header.sizeof_value != sizeof(Value) || header.sizeof_entry != sizeof(FlatEntry) ){
+			std::cerr << "XformMap::load_flat, value type mismatch, expected sizeof(Value) " << sizeof(Value) << " got " << header.sizeof_value << std::endl;
+			return false;
+		}
+		if( header.n_buckets == 0 || ( header.n_buckets & (header.n_buckets-1) ) != 0 ||
+		    header.table_offset + header.n_buckets*sizeof(FlatEntry) > file_size ){
+			std::cerr << "XformMap::load_flat, corrupt or truncated table " << fname << std::endl;
+			return false;
+		}
+		Float cart_resl = header.cart_resl, ang_resl = header.ang_resl;
+		if( cart_resl_ != -1 && cart_resl_ != cart_resl ){
+			std::cerr << "XformMap::load_flat, hasher cart_resl mismatch, expected " << cart_resl_ << " got "  << cart_resl << std::endl;
+			return false;
+		}
+		if( ang_resl_ != -1 && ang_resl_ != ang_resl ){
+			std::cerr << "XformMap::load_flat, hasher ang_resl mismatch, expected " << ang_resl_ << " got "  << ang_resl << std::endl;
+			return false;
+		}
+		cart_resl_ = cart_resl;
+		ang_resl_ = ang_resl;
+		cart_bound_ = header.cart_bound;
+		hasher_.init( cart_resl_, ang_resl_, cart_bound_ );
+		description = std::string( base+offset+sizeof(XformMapFlatHeader), header.description_size );
+
+		map_.clear();
+		map_.resize(0);
+		flat_mapping_ = mapping;
+		flat_table_ = reinterpret_cast<FlatEntry const *>( base+header.table_offset );
+		flat_mask_ = header.n_buckets-1;
+		flat_size_ = header.n_entries;
+		return true;
+	}
+
+	void unmap_flat() {
+		flat_table_ = nullptr;
+		flat_mask_ = 0;
+		flat_size_ = 0;
+		flat_mapping_.reset();
+	}
+
 	// void super_print( std::ostream & out, shared_ptr< RotamerIndex > rot_index_p ) const {
 	// 	for(typename Map::const_iterator i = map_.begin(); i != map_.end(); ++i){
 	// 		// out << get_center(i->first).translation().transpose() << std::endl;
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+
+#include "scheme/objective/hash/XformMapBound.hh"
+#include "scheme/objective/storage/RotamerScores.hh"
+#include "scheme/numeric/rand_xform.hh"
+#include <Eigen/Geometry>
+
+#include <random>
+
+namespace scheme { namespace objective { namespace hash { namespace xmbtest {
+
+using std::cout;
+using std::endl;
+
+typedef Eigen::Transform<double,3,Eigen::AffineCompact> Xform;
+
+TEST( MinimalPerfectHash, is_permutation ){
+	std::mt19937_64 rng( 2384 );
+	for( int n : { 0, 1, 2, 63, 64, 1000, 100000 } ){
+		std::vector<uint64_t> keys( n );
+		for( auto & k : keys ) k = rng();
+		MinimalPerfectHash mph;
+		mph.build( keys );
+		ASSERT_EQ( mph.size(), n );
+		std::vector<bool> used( n, false );
+		for( uint64_t k : keys ){
+			int64_t i = mph.index( k );
+			ASSERT_GE( i, 0 );
+			ASSERT_LT( i, n );
+			ASSERT_FALSE( used[i] );
+			used[i] = true;
+		}
+		if( n >= 1000 ) ASSERT_LT( (double)mph.mem_use()*8 / n, 16.0 ); // bits per key
+	}
+}
+
+template< class RotScore >
+void check_matches_best_score( int max_rotamer ){
+	typedef storage::RotamerScores< 8, RotScore > RotScores;
+	typedef XformMap< Xform, RotScores, XformHash_bt24_BCC6 > XMap;
+
+	std::mt19937 rng( 8734 );
+	std::uniform_real_distribution<> runif;
+	XMap xmap( 2.0, 16.0, 128.0 );
+	int const NSAMP = 50000;
+	for( int i = 0; i < NSAMP; ++i ){
+		Xform x;
+		numeric::rand_xform( rng, x, 64.0 );
+		uint64_t const key = xmap.get_key( x );
+		RotScores rs = xmap[ key ];
+		int nrot = 1 + runif(rng)*5;
+		for( int j = 0; j < nrot; ++j ) rs.add_rotamer( runif(rng)*max_rotamer, -0.5-runif(rng)*8.0 );
+		rs.sort_rotamers();
+		xmap.map_[ key ] = rs;
+	}
+
+	XformMapBound<XMap> bound( xmap );
+	ASSERT_EQ( bound.size(), xmap.size() );
+	cout << "XformMapBound " << xmap.size() << " cells, " << (double)bound.mem_use()/bound.size()
+	     << " bytes/cell vs " << (double)xmap.mem_use()/xmap.size() << " for XformMap" << endl;
+
+	int nbad = 0;
+	xmap.for_each_entry( [&]( uint64_t k, RotScores const & rs ){
+		float best = 9e9;
+		for( int i = 0; i < RotScores::N; ++i ){
+			if( rs.empty(i) ) break;
+			best = std::min( best, rs.score(i) );
+		}
+		float score;
+		if( !bound.lookup( k, score ) ){ ++nbad; return; }
+		if( score > best ) ++nbad; // must remain a bound
+		if( score < best - bound.score_step_ ) ++nbad;
+	});
+	ASSERT_EQ( nbad, 0 );
+
+	// keys not in the map are rejected by the fingerprint, nearly always
+	int nfalse = 0, ntest = 0;
+	for( int i = 0; i < NSAMP; ++i ){
+		Xform x;
+		numeric::rand_xform( rng, x, 64.0 );
+		uint64_t const key = xmap.get_key( x );
+		if( xmap.map_.find( key ) != xmap.map_.end() ) continue;
+		float score;
+		nfalse += bound.lookup( key, score );
+		++ntest;
+	}
+	ASSERT_LE( nfalse, ntest / 100000 + 1 );
+}
+
+TEST( XformMapBound, matches_best_score ){
+	check_matches_best_score< storage::RotamerScore<> >( 500 );
+}
+
+TEST( XformMapBound, any_rotamer_index ){
+	// extra rotamer libraries go past 1024 rotamers, only the score is kept
+	check_matches_best_score< storage::RotamerScore< uint32_t, 13, -13 > >( 5000 );
+}
+
+}}}}
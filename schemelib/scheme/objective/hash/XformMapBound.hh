@@ -0,0 +1,190 @@
+#ifndef INCLUDED_objective_hash_XformMapBound_HH
+#define INCLUDED_objective_hash_XformMapBound_HH
+
+#include "scheme/objective/hash/XformMap.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace scheme { namespace objective { namespace hash {
+
+// minimal perfect hash over a fixed key set (BBHash style): each level is a
+// bit array of size ~gamma*nkeys, keys landing alone in a bit are placed at
+// that level, colliding keys go on to the next level. index is the rank of
+// the bit over all levels. non-member keys also get an index (or -1), so
+// callers must verify membership themselves, e.g. with a fingerprint
+struct MinimalPerfectHash {
+
+	struct Level {
+		uint64_t nbits;
+		std::vector<uint64_t> bits;
+		std::vector<uint64_t> rank; // global index of first set bit in each word
+	};
+
+	static int const MAX_LEVELS = 24;
+	std::vector<Level> levels_;
+	std::vector<uint64_t> fallback_keys_; // keys still colliding after MAX_LEVELS, sorted
+	uint64_t fallback_base_ = 0;
+	uint64_t size_ = 0;
+
+	static uint64_t level_hash( uint64_t k, int level ){
+		return xform_map_flat_hash( k + (uint64_t)(level+1) * 0x9e3779b97f4a7c15ULL );
+	}
+
+	void build( std::vector<uint64_t> keys, double gamma = 2.0 ){
+		levels_.clear();
+		fallback_keys_.clear();
+		size_ = keys.size();
+		uint64_t nplaced = 0;
+		for( int ilevel = 0; ilevel < MAX_LEVELS && keys.size(); ++ilevel ){
+			Level lvl;
+			uint64_t const nwords = std::max( (uint64_t)1, (uint64_t)( gamma * keys.size() + 63 ) / 64 );
+			lvl.nbits = nwords * 64;
+			std::vector<uint64_t> seen( nwords, 0 ), collide( nwords, 0 );
+			for( uint64_t k : keys ){
+				uint64_t const h = level_hash( k, ilevel ) % lvl.nbits;
+				uint64_t const bit = (uint64_t)1 << (h&63);
+				if( seen[h>>6] & bit ) collide[h>>6] |= bit;
+				else                   seen  [h>>6] |= bit;
+			}
+			lvl.bits.resize( nwords );
+			lvl.rank.resize( nwords );
+			for( uint64_t w = 0; w < nwords; ++w ){
+				lvl.bits[w] = seen[w] & ~collide[w];
+				lvl.rank[w] = nplaced;
+				nplaced += __builtin_popcountll( lvl.bits[w] );
+			}
+			std::vector<uint64_t> next;
+			for( uint64_t k : keys ){
+				uint64_t const h = level_hash( k, ilevel ) % lvl.nbits;
+				if( collide[h>>6] & ( (uint64_t)1 << (h&63) ) ) next.push_back( k );
+			}
+			keys.swap( next );
+			levels_.push_back( lvl );
+		}
+		fallback_base_ = nplaced;
+		fallback_keys_ = keys;
+		std::sort( fallback_keys_.begin(), fallback_keys_.end() );
+	}
+
+	// index in [0,size()) for members, arbitrary index or -1 for non-members
+	int64_t index( uint64_t k ) const {
+		for( int ilevel = 0; ilevel < (int)levels_.size(); ++ilevel ){
+			Level const & lvl = levels_[ilevel];
+			uint64_t const h = level_hash( k, ilevel ) % lvl.nbits;
+			uint64_t const word = lvl.bits[h>>6];
+			uint64_t const bit = (uint64_t)1 << (h&63);
+			if( word & bit ) return lvl.rank[h>>6] + __builtin_popcountll( word & (bit-1) );
+		}
+		std::vector<uint64_t>::const_iterator i = std::lower_bound( fallback_keys_.begin(), fallback_keys_.end(), k );
+		if( i == fallback_keys_.end() || *i != k ) return -1;
+		return fallback_base_ + ( i - fallback_keys_.begin() );
+	}
+
+	void prefetch( uint64_t k ) const {
+		if( levels_.empty() ) return;
+		uint64_t const h = level_hash( k, 0 ) % levels_[0].nbits;
+		__builtin_prefetch( &levels_[0].bits[h>>6] );
+		__builtin_prefetch( &levels_[0].rank[h>>6] );
+	}
+
+	uint64_t size() const { return size_; }
+
+	size_t mem_use() const {
+		size_t m = fallback_keys_.size() * sizeof(uint64_t);
+		for( Level const & l : levels_ ) m += ( l.bits.size() + l.rank.size() ) * sizeof(uint64_t);
+		return m;
+	}
+};
+
+
+// compact, read-only companion to an XformMap< Xform, RotamerScores<...> >
+// keeping only the best score per cell, quantized to 8 bits. meant for
+// bounding passes at coarse resolution where only the best score is needed;
+// each cell costs one uint32 plus a few bits of hash index, instead of a
+// full RotamerScores bucket
+template< class XMap >
+struct XformMapBound {
+	typedef typename XMap::Xform Xform;
+	typedef typename XMap::Hasher Hasher;
+	typedef typename XMap::Key Key;
+	typedef typename XMap::Float Float;
+
+	// entry layout: | 24 bit key fingerprint | 8 bit score |
+	static int const SCORE_BITS = 8;
+	static int const CHECK_BITS = 32 - SCORE_BITS;
+
+	Hasher hasher_;
+	Float cart_resl_ = -1, ang_resl_ = -1, cart_bound_ = -1;
+	MinimalPerfectHash index_;
+	std::vector<uint32_t> entries_;
+	float score_step_ = 1.0;
+
+	XformMapBound() {}
+	XformMapBound( XMap const & xmap ){ init( xmap ); }
+
+	static uint32_t fingerprint( Key k ){
+		return xform_map_flat_hash( k ^ 0x5bd1e9955bd1e995ULL ) >> ( 64 - CHECK_BITS );
+	}
+
+	void init( XMap const & xmap ){
+		hasher_ = xmap.hasher_;
+		cart_resl_ = xmap.cart_resl_;
+		ang_resl_ = xmap.ang_resl_;
+		cart_bound_ = xmap.cart_bound_;
+
+		std::vector<Key> keys;
+		std::vector<float> best;
+		keys.reserve( xmap.size() );
+		best.reserve( xmap.size() );
+		xmap.for_each_entry( [&]( Key k, typename XMap::Value const & v ){
+			float b = 9e9;
+			bool any = false;
+			for( int i = 0; i < XMap::Value::N; ++i ){
+				if( v.empty(i) ) continue;
+				b = std::min( b, v.score(i) );
+				any = true;
+			}
+			if( !any ) return;
+			keys.push_back( k );
+			best.push_back( b );
+		});
+
+		// scores are quantized to multiples of score_step_, rounding down so
+		// the stored value is never worse than the real one
+		float worst = 0;
+		for( float b : best ) worst = std::min( worst, b );
+		// (a hair coarser than needed so the worst score doesn't round past the last step)
+		score_step_ = worst < 0 ? -worst / ( (1<<SCORE_BITS) - 1 ) * 1.00001f : 1.0;
+
+		index_.build( keys );
+		entries_.assign( keys.size(), 0 );
+		for( size_t i = 0; i < keys.size(); ++i ){
+			uint32_t const q = std::min( (float)( (1<<SCORE_BITS) - 1 ), std::max( 0.0f, std::ceil( -best[i] / score_step_ ) ) );
+			entries_[ index_.index( keys[i] ) ] = fingerprint( keys[i] ) << SCORE_BITS | q;
+		}
+	}
+
+	// false if k is not in the map
+	bool lookup( Key k, float & score ) const {
+		int64_t const i = index_.index( k );
+		if( i < 0 || i >= (int64_t)entries_.size() ) return false;
+		uint32_t const e = entries_[i];
+		if( e >> SCORE_BITS != fingerprint( k ) ) return false;
+		score = -score_step_ * (float)( e & ( (1<<SCORE_BITS) - 1 ) );
+		return true;
+	}
+
+	Key get_key( Xform const & x ) const { return hasher_.get_key( x ); }
+
+	void prefetch( Key k ) const { index_.prefetch( k ); }
+
+	size_t size() const { return entries_.size(); }
+
+	size_t mem_use() const { return index_.mem_use() + entries_.size() * sizeof(uint32_t); }
+};
+
+}}}
+
+#endif
@@ -0,0 +1,77 @@
+#include <gtest/gtest.h>
+
+#include "scheme/objective/hash/XformMapRuns.hh"
+#include "scheme/objective/storage/RotamerScores.hh"
+
+#include <sparsehash/dense_hash_map>
+
+#include <cstdio>
+#include <random>
+
+namespace scheme { namespace objective { namespace hash { namespace xmrtest {
+
+using std::cout;
+using std::endl;
+
+TEST( XformMapRuns, kway_merge_matches_sequential_merge ){
+	typedef storage::RotamerScores< 4, storage::RotamerScore<> > RotScores;
+	typedef google::dense_hash_map<uint64_t,RotScores> Map;
+
+	std::mt19937 rng( 9283 );
+	std::vector<std::string> fnames;
+	std::vector<bool> force;
+	Map expected;
+	expected.set_empty_key( std::numeric_limits<uint64_t>::max() );
+
+	int const NRUNS = 7;
+	for( int irun = 0; irun < NRUNS; ++irun ){
+		Map run;
+		run.set_empty_key( std::numeric_limits<uint64_t>::max() );
+		int n = irun == 3 ? 0 : rng() % 5000; // include an empty run
+		for( int i = 0; i < n; ++i ){
+			uint64_t key = rng() % 20000;
+			run[key].add_rotamer( rng() % 500, -0.5 - ( rng() % 100 ) / 20.0 );
+		}
+		force.push_back( irun == 5 );
+		for( auto const & v : run ){
+			Map::iterator iter = expected.find( v.first );
+			if( iter == expected.end() ) expected.insert( v );
+			else iter->second.merge( v.second, force.back() );
+		}
+		std::vector< std::pair<uint64_t,RotScores> > entries( run.begin(), run.end() );
+		fnames.push_back( "test_xmap_run_" + std::to_string(irun) + ".run" );
+		ASSERT_TRUE( write_xform_map_run( fnames.back(), entries ) );
+	}
+
+	XformMapRunMerger<uint64_t,RotScores> merger;
+	ASSERT_TRUE( merger.open( fnames, 4096 ) );
+	uint64_t key, prev = 0;
+	RotScores value;
+	size_t count = 0;
+	auto merge = [&]( RotScores & a, RotScores const & b, int irun ){ a.merge( b, force[irun] ); };
+	while( merger.next( key, value, merge ) ){
+		if( count ) ASSERT_LT( prev, key );
+		prev = key;
+		++count;
+		Map::iterator iter = expected.find( key );
+		ASSERT_TRUE( iter != expected.end() );
+		ASSERT_EQ( 0, std::memcmp( &iter->second, &value, sizeof(RotScores) ) );
+	}
+	ASSERT_EQ( count, expected.size() );
+
+	// reopening must not keep the previous buffers alive
+	ASSERT_TRUE( merger.open( fnames, 4096 ) );
+	count = 0;
+	while( merger.next( key, value, merge ) ){
+		ASSERT_TRUE( merger.first_run() >= 0 && merger.first_run() < (int)fnames.size() );
+		++count;
+	}
+	ASSERT_EQ( count, expected.size() );
+
+	for( auto const & f : fnames ) std::remove( f.c_str() );
+
+	XformMapRunMerger<uint64_t,double> bad;
+	ASSERT_FALSE( bad.open( std::vector<std::string>( 1, "nonexistent_xmap_run.run" ) ) );
+}
+
+}}}}
@@ -0,0 +1,136 @@
+#ifndef INCLUDED_objective_hash_XformMapRuns_HH
+#define INCLUDED_objective_hash_XformMapRuns_HH
+
+// sorted (key,value) run files for building XformMaps larger than memory:
+// partial maps are spilled as runs sorted by key, then streamed back
+// through a k-way merge that combines values of equal keys in run order
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+namespace scheme { namespace objective { namespace hash {
+
+struct XformMapRunHeader {
+	char     magic[16];
+	uint64_t sizeof_key, sizeof_value;
+	uint64_t n_entries;
+	static char const * MAGIC() { return "SchemeXMapRun"; }
+};
+
+// sorts entries by key and writes them; keys must be unique
+template< class Key, class Value >
+bool write_xform_map_run( std::string const & fname, std::vector< std::pair<Key,Value> > & entries ){
+	std::sort( entries.begin(), entries.end(),
+		[]( std::pair<Key,Value> const & a, std::pair<Key,Value> const & b ){ return a.first < b.first; } );
+	std::ofstream out( fname, std::ios::binary );
+	if( !out.good() ){
+		std::cerr << "write_xform_map_run: can't open " << fname << std::endl;
+		return false;
+	}
+	XformMapRunHeader header;
+	std::memset( &header, 0, sizeof(header) );
+	std::strncpy( header.magic, XformMapRunHeader::MAGIC(), sizeof(header.magic)-1 );
+	header.sizeof_key = sizeof(Key);
+	header.sizeof_value = sizeof(Value);
+	header.n_entries = entries.size();
+	out.write( (char*)&header, sizeof(header) );
+	for( auto const & e : entries ){
+		out.write( (char*)&e.first, sizeof(Key) );
+		out.write( (char*)&e.second, sizeof(Value) );
+	}
+	out.close();
+	if( !out.good() ){
+		std::cerr << "write_xform_map_run: write failed " << fname << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// k-way merge over run files. next() yields each key once, with the values
+// from all runs holding it combined by merge( value, other, irun ), called
+// in increasing irun order, so the result matches merging runs one by one
+template< class Key, class Value >
+struct XformMapRunMerger {
+
+	struct Run {
+		std::shared_ptr<std::ifstream> in;
+		uint64_t remaining = 0;
+		Key key;
+		Value value;
+		bool advance(){
+			if( remaining == 0 ) return false;
+			in->read( (char*)&key, sizeof(Key) );
+			in->read( (char*)&value, sizeof(Value) );
+			--remaining;
+			return in->good();
+		}
+	};
+	typedef std::pair<Key,int> HeapItem;
+
+	std::vector<Run> runs_;
+	std::priority_queue< HeapItem, std::vector<HeapItem>, std::greater<HeapItem> > heap_;
+
+	bool open( std::vector<std::string> const & fnames, size_t bufsize = 1<<20 ){
+		runs_.clear(); // drop the streams before the buffers they point into
+		buffers_.clear();
+		buffers_.reserve( fnames.size() );
+		heap_ = decltype(heap_)();
+		runs_.resize( fnames.size() );
+		for( int i = 0; i < (int)fnames.size(); ++i ){
+			Run & run = runs_[i];
+			run.in = std::make_shared<std::ifstream>();
+			// one buffer per run, the merge reads them all round robin
+			buffers_.push_back( std::vector<char>( bufsize ) );
+			run.in->rdbuf()->pubsetbuf( &buffers_.back()[0], bufsize );
+			run.in->open( fnames[i], std::ios::binary );
+			XformMapRunHeader header;
+			run.in->read( (char*)&header, sizeof(header) );
+			if( !run.in->good() || std::strncmp( header.magic, XformMapRunHeader::MAGIC(), sizeof(header.magic) ) ){
+				std::cerr << "XformMapRunMerger: bad run file " << fnames[i] << std::endl;
+				return false;
+			}
+			if( header.sizeof_key != sizeof(Key) || header.sizeof_value != sizeof(Value) ){
+				std::cerr << "XformMapRunMerger: key/value size mismatch in " << fnames[i] << std::endl;
+				return false;
+			}
+			run.remaining = header.n_entries;
+			if( run.advance() ) heap_.push( HeapItem( run.key, i ) );
+		}
+		return true;
+	}
+
+	template< class Merge >
+	bool next( Key & key, Value & value, Merge const & merge ){
+		if( heap_.empty() ) return false;
+		int irun = heap_.top().second;
+		heap_.pop();
+		first_run_ = irun;
+		key = runs_[irun].key;
+		value = runs_[irun].value;
+		if( runs_[irun].advance() ) heap_.push( HeapItem( runs_[irun].key, irun ) );
+		while( !heap_.empty() && heap_.top().first == key ){
+			irun = heap_.top().second;
+			heap_.pop();
+			merge( value, runs_[irun].value, irun );
+			if( runs_[irun].advance() ) heap_.push( HeapItem( runs_[irun].key, irun ) );
+		}
+		return true;
+	}
+
+	// run that supplied the initial value on the last next(), merge() sees the others
+	int first_run() const { return first_run_; }
+
+private:
+	std::vector< std::vector<char> > buffers_;
+	int first_run_ = -1;
+};
+
+}}}
+
+#endif
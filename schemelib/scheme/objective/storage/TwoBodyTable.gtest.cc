@@ -2,6 +2,8 @@
 
 #include "scheme/objective/storage/TwoBodyTable.hh"
 
+#include <sstream>
+
 namespace scheme { namespace objective { namespace storage { namespace ritest {
 
 using std::cout;
@@ -42,7 +44,26 @@ TEST( TwoBodyTable, test ){
 
 }
 
-
+TEST( TwoBodyTable, save_load ){
+	TwoBodyTable<float> twob( 3, 4 );
+	for( int i = 0; i < 3; ++i ) for( int j = 0; j < 4; ++j ) twob.set_onebody( i, j, (i+j)%3 - 1.0 );
+	twob.init_onebody_filter( 0.5 );
+	twob.init_twobody( 1, 0 );
+	twob.init_twobody( 2, 1 );
+	for( int k = 0; k < twob.twobody_[1][0].num_elements(); ++k ) twob.twobody_[1][0].data()[k] = k*0.5f;
+	for( int k = 0; k < twob.twobody_[2][1].num_elements(); ++k ) twob.twobody_[2][1].data()[k] = -k-1.0f;
+
+	std::ostringstream out;
+	twob.save( out, "description" );
+	std::istringstream in( out.str() );
+	TwoBodyTable<float> loaded;
+	std::string description;
+	loaded.load( in, description );
+	EXPECT_EQ( description, "description" );
+	EXPECT_TRUE( loaded.check_equal( twob ) );
+	EXPECT_EQ( loaded.twobody_[0][2].num_elements(), 0 );
+	EXPECT_EQ( in.peek(), std::char_traits<char>::eof() );
+}
 
 
 }}}}
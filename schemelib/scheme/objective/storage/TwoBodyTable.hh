@@ -8,6 +8,7 @@
 #include <boost/lexical_cast.hpp>
 
 #include <set>
+#include <vector>
 
 namespace scheme { namespace objective { namespace storage {
 
@@ -65,7 +66,7 @@ struct TwoBodyTable {
   			tbt->twobody_[ir][jr] = twobody_[ir][jr];
   		}
 		}
-		runtime_assert( check_equal(*tbt));
+		ALWAYS_ASSERT( check_equal(*tbt) );
 		return tbt;
 	}
 
@@ -120,38 +121,36 @@ struct TwoBodyTable {
 		}
 	}
 
+	// storage position of the edge between global rots irot and jrot, false
+	// if the pair has no table or either rot was filtered out
+	bool
+	edge_index( int ires, int jres, int irot, int jrot, int & ir, int & jr, int & irl, int & jrl ) const {
+		ir = ires > jres ? ires : jres;
+		jr = ires > jres ? jres : ires;
+		if( twobody_[ir][jr].num_elements() == 0 ) return false;
+		int const irotlocal = all2sel_[ires][irot];
+		int const jrotlocal = all2sel_[jres][jrot];
+		if( irotlocal < 0 || jrotlocal < 0 ) return false;
+		// swap if jres > ires
+		irl = ires > jres ? irotlocal : jrotlocal;
+		jrl = ires > jres ? jrotlocal : irotlocal;
+		return true;
+	}
+
 	void
 	upweight_edge( int ires, int jres, int irot, int jrot, Data upweight ) {
-		int const ir = ires > jres ? ires : jres;
-		int const jr = ires > jres ? jres : ires;
-		if( twobody_[ir][jr].num_elements() > 0 ){
-			int const irotlocal = all2sel_[ires][irot];
-			int const jrotlocal = all2sel_[jres][jrot];
-			if( irotlocal < 0 || jrotlocal < 0 ){
-				return;
-			}
-			// swap if jres > ires
-			int const irl = ires > jres ? irotlocal : jrotlocal;
-			int const jrl = ires > jres ? jrotlocal : irotlocal;
+		int ir, jr, irl, jrl;
+		if( edge_index( ires, jres, irot, jrot, ir, jr, irl, jrl ) ){
 			twobody_[ ir ][ jr ][ irl ][ jrl ] += upweight;
-		} 
+		}
 	}
 	void
 	restore_edge( int ires, int jres, int irot, int jrot, shared_ptr<TwoBodyTable<Data> const> twob )
 	{
-		int const ir = ires > jres ? ires : jres;
-		int const jr = ires > jres ? jres : ires;
-		if( twobody_[ir][jr].num_elements() > 0 ){
-			int const irotlocal = all2sel_[ires][irot];
-			int const jrotlocal = all2sel_[jres][jrot];
-			if( irotlocal < 0 || jrotlocal < 0 ){
-				return;
-			}
-			// swap if jres > ires
-			int const irl = ires > jres ? irotlocal : jrotlocal;
-			int const jrl = ires > jres ? jrotlocal : irotlocal;
+		int ir, jr, irl, jrl;
+		if( edge_index( ires, jres, irot, jrot, ir, jr, irl, jrl ) ){
 			twobody_[ ir ][ jr ][ irl ][ jrl ] = twob->twobody_[ ir ][ jr ][ irl ][ jrl ];
-		} 
+		}
 	}
 
 
@@ -252,9 +251,7 @@ struct TwoBodyTable {
   				ALWAYS_ASSERT( N == 0 || N == nsel_[ir]*nsel_[jr] );
   			}
 	  		out.write( (char*)&N, sizeof(size_t) );
-	  		for( int k = 0; k < N; ++k ){
-		  		out.write( (char*)&( twobody_[ir][jr].data()[k] ), sizeof(Data) );
-	  		}
+	  		if( N ) out.write( (char*)twobody_[ir][jr].data(), N*sizeof(Data) );
   		}}
 	}
 	void load( std::istream & in, std::string & description ) {
@@ -266,7 +263,7 @@ struct TwoBodyTable {
   		in.read( buf, dsrcrize*sizeof(char) );
   		description.resize( dsrcrize );
   		for( int i = 0; i < dsrcrize; ++i ) description[i] = buf[i];
-  		delete buf;
+  		delete [] buf;
   		in.read( (char*)&nres_, sizeof(size_t) );
   		in.read( (char*)&nrot_, sizeof(size_t) );
   		onebody_.resize( boost::extents[nres_][nrot_] );
@@ -284,21 +281,15 @@ struct TwoBodyTable {
   		twobody_.resize( boost::extents[nres_][nres_] );
   		for( int ir = 0; ir < nres_; ++ir ){
   		for( int jr = 0; jr < nres_; ++jr ){
-  			size_t const N = twobody_[ir][jr].num_elements();
+  			size_t N = twobody_[ir][jr].num_elements();
   			ALWAYS_ASSERT( N == 0 || N == nsel_[ir]*nsel_[jr] );
 	  		in.read( (char*)&N, sizeof(size_t) );
 	  		if( N == 0 ){
 	  			twobody_[ir][jr].resize( boost::extents[0][0] );
 	  		} else {
 		  		twobody_[ir][jr].resize( boost::extents[ nsel_[ir] ][ nsel_[jr] ] );
-				for( int k = 0; k < N; ++k ){
-			  		in.read( (char*)&( twobody_[ir][jr].data()[k] ), sizeof(Data) );
-			  		// static bool doit = true;
-			  		// if( doit ){
-				  	// 	twobody_[ir][jr].data()[k] += 1.0;
-				  	// 	doit = false;
-				  	// }
-	  			}
+		  		ALWAYS_ASSERT( N == twobody_[ir][jr].num_elements() );
+		  		in.read( (char*)twobody_[ir][jr].data(), N*sizeof(Data) );
 	  		}
   		}}
 	}
@@ -408,6 +399,51 @@ struct TwoBodyTable {
 
 };
 
+// edits on top of a shared TwoBodyTable, so threads can change a few edges
+// while packing without each holding a copy of the table. upweight_edge
+// records the change here instead of in the table, clear() throws all of it
+// away. the edits are few (one per unsat pair) so they are kept in a list
+template< class _Data = float >
+struct TwoBodyOverlay {
+	typedef _Data Data;
+	struct Edit { int ir, jr, irl, jrl; Data delta; };
+	std::vector<Edit> edits_;
+
+	bool empty() const { return edits_.empty(); }
+	void clear() { edits_.clear(); }
+
+	void
+	upweight_edge( TwoBodyTable<Data> const & twob, int ires, int jres, int irot, int jrot, Data upweight ){
+		Edit e;
+		if( !twob.edge_index( ires, jres, irot, jrot, e.ir, e.jr, e.irl, e.jrl ) ) return;
+		for( Edit & f : edits_ ){
+			if( f.ir == e.ir && f.jr == e.jr && f.irl == e.irl && f.jrl == e.jrl ){
+				f.delta += upweight;
+				return;
+			}
+		}
+		e.delta = upweight;
+		edits_.push_back( e );
+	}
+
+	// change to the table entry, same numbering as TwoBodyTable::twobody_rotlocalnumbering
+	Data delta_rotlocalnumbering( int ires, int jres, int irotlocal, int jrotlocal ) const {
+		int const ir  = ires > jres ? ires : jres;
+		int const jr  = ires > jres ? jres : ires;
+		int const irl = ires > jres ? irotlocal : jrotlocal;
+		int const jrl = ires > jres ? jrotlocal : irotlocal;
+		for( Edit const & e : edits_ ){
+			if( e.ir == ir && e.jr == jr && e.irl == irl && e.jrl == jrl ) return e.delta;
+		}
+		return Data(0.0);
+	}
+
+	Data twobody_rotlocalnumbering( TwoBodyTable<Data> const & twob, int ires, int jres, int irotlocal, int jrotlocal ) const {
+		Data const e = twob.twobody_rotlocalnumbering( ires, jres, irotlocal, jrotlocal );
+		return edits_.empty() ? e : e + delta_rotlocalnumbering( ires, jres, irotlocal, jrotlocal );
+	}
+};
+
 }}}
 
 #endif
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include "scheme/objective/voxel/CompactVoxelArray.hh"
+#include "scheme/objective/voxel/VoxelArray.hh"
+
+#include <random>
+
+namespace scheme { namespace objective { namespace voxel { namespace test_compact {
+
+using std::cout;
+using std::endl;
+
+TEST( CompactVoxelArray, half_round_trip ){
+	for( uint32_t h = 0; h < 0x10000; ++h ){
+		if( ( h & 0x7c00 ) == 0x7c00 ) continue; // inf, nan
+		float const f = half_to_float( h );
+		ASSERT_EQ( h, float_to_half( f ) ) << f;
+		if( h < 0x7bff ){ // halfway to the next half rounds to even
+			float const mid = 0.5f*( f + half_to_float( h+1 ) );
+			ASSERT_EQ( h & 1 ? h+1 : h, float_to_half( mid ) ) << mid;
+		}
+	}
+	ASSERT_EQ( 0x7bff, float_to_half( 1e9f ) );
+	ASSERT_EQ( 0xfbff, float_to_half( -1e9f ) );
+	ASSERT_EQ( 0, float_to_half( 1e-9f ) );
+}
+
+TEST( CompactVoxelArray, matches_voxel_array ){
+	typedef util::SimpleArray<3,float> F3;
+	std::mt19937 rng( 7423 );
+	std::uniform_real_distribution<float> runif;
+	VoxelArray<3,float,float> a( F3(-7,-3,-5), F3(6,9,4.3), 0.25 );
+	for( size_t i = 0; i < a.num_elements(); ++i ) a.data()[i] = runif(rng) < 0.3 ? 0 : runif(rng)*20.0f - 2.0f;
+
+	CompactVoxelArray h( a, CompactVoxelArray::FP16 );
+	CompactVoxelArray b( a, CompactVoxelArray::INT8 );
+	ASSERT_EQ( h.shape(), b.shape() );
+	for( int i = 0; i < 3; ++i ) ASSERT_EQ( h.shape()[i], a.shape()[i] );
+	cout << h << " " << (double)a.num_elements()*sizeof(float)/h.mem_use() << "x smaller" << endl;
+	cout << b << " " << (double)a.num_elements()*sizeof(float)/b.mem_use() << "x smaller" << endl;
+	ASSERT_LT( h.mem_use(), a.num_elements()*sizeof(float)*0.6 );
+	ASSERT_LT( b.mem_use(), a.num_elements()*sizeof(float)*0.32 ); // int8 plus an fp16 scale per 64 voxel brick
+
+	for( int i = 0; i < 100000; ++i ){
+		F3 p( runif(rng)*16-8, runif(rng)*16-4, runif(rng)*12-6 );
+		float const ref = a.at( p[0], p[1], p[2] );
+		if( ref == 0 ){
+			ASSERT_EQ( 0, h.at( p ) );
+			ASSERT_EQ( 0, b.at( p ) );
+		}
+		ASSERT_NEAR( ref, h.at( p ), std::abs(ref)/1000.0f );
+		ASSERT_NEAR( ref, b.at( p ), b.max_scale()*0.5001f );
+	}
+}
+
+TEST( CompactVoxelArray, int8_keeps_shallow_wells_next_to_a_repulsive_core ){
+	// like a target grid: a few hundred kcal inside the target, a well of -1 to -3
+	// around it, and zero further out
+	typedef util::SimpleArray<3,float> F3;
+	VoxelArray<3,float,float> a( F3(-12,-12,-12), F3(12,12,12), 0.25 );
+	for( size_t i = 0; i < a.shape()[0]; ++i ){
+	for( size_t j = 0; j < a.shape()[1]; ++j ){
+	for( size_t k = 0; k < a.shape()[2]; ++k ){
+		F3 const p = a.indices_to_center( util::SimpleArray<3,size_t>( i, j, k ) );
+		float const r = std::sqrt( p[0]*p[0] + p[1]*p[1] + p[2]*p[2] );
+		float val = 0;
+		if( r < 4.0f )      val = 300.0f * ( 4.0f - r ) / 4.0f;
+		else if( r < 8.0f ) val = -1.0f - 2.0f * std::sin( ( r - 4.0f ) / 4.0f * M_PI );
+		a.data()[ i*a.strides()[0] + j*a.strides()[1] + k*a.strides()[2] ] = val;
+	}}}
+
+	CompactVoxelArray b( a, CompactVoxelArray::INT8 );
+	cout << b << endl;
+	int nwell = 0, nlost = 0;
+	for( size_t i = 0; i < a.shape()[0]; ++i ){
+	for( size_t j = 0; j < a.shape()[1]; ++j ){
+	for( size_t k = 0; k < a.shape()[2]; ++k ){
+		float const ref = a.data()[ i*a.strides()[0] + j*a.strides()[1] + k*a.strides()[2] ];
+		ASSERT_NEAR( ref, b.value( i, j, k ), b.scale( i, j, k )*0.5001f );
+		if( ref < 0 ){
+			++nwell;
+			if( b.value( i, j, k ) >= 0 ) ++nlost;
+		}
+	}}}
+	cout << "well voxels " << nwell << " rounded to zero or above " << nlost << endl;
+	ASSERT_GT( nwell, 0 );
+	ASSERT_EQ( nlost, 0 );
+}
+
+}}}}
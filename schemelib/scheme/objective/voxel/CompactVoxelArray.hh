@@ -0,0 +1,193 @@
+#ifndef INCLUDED_objective_voxel_CompactVoxelArray_HH
+#define INCLUDED_objective_voxel_CompactVoxelArray_HH
+
+#include "scheme/util/SimpleArray.hh"
+#include "scheme/util/dilated_int.hh"
+#include <scheme/util/assert.hh>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+namespace scheme { namespace objective { namespace voxel {
+
+// ieee half precision, round to nearest even, saturating at +-65504
+inline uint16_t float_to_half( float f ){
+	#ifdef __F16C__
+		f = std::max( -65504.0f, std::min( 65504.0f, f ) );
+		return _cvtss_sh( f, 0 );
+	#else
+		uint32_t x;
+		std::memcpy( &x, &f, 4 );
+		uint16_t const sign = ( x >> 16 ) & 0x8000;
+		x &= 0x7fffffff;
+		if( x > 0x7f800000 ) return sign | 0x7e00; // nan
+		if( x >= 0x477ff000 ) return sign | 0x7bff; // saturate, incl. inf
+		if( x < 0x38800000 ){ // subnormal half, or zero
+			if( x < 0x33000000 ) return sign;
+			uint32_t const shift = 126 - ( x >> 23 );
+			uint32_t const mant = ( x & 0x7fffff ) | 0x800000;
+			uint32_t h = mant >> shift;
+			uint32_t const rem = mant & ( ( 1u << shift ) - 1 ), half = 1u << ( shift - 1 );
+			if( rem > half || ( rem == half && ( h & 1 ) ) ) ++h;
+			return sign | h;
+		}
+		uint32_t h = ( ( x - 0x38000000 ) >> 13 );
+		uint32_t const rem = x & 0x1fff;
+		if( rem > 0x1000 || ( rem == 0x1000 && ( h & 1 ) ) ) ++h;
+		return sign | h;
+	#endif
+}
+
+inline float half_to_float( uint16_t h ){
+	#ifdef __F16C__
+		return _cvtsh_ss( h );
+	#else
+		uint32_t const sign = ( h & 0x8000 ) << 16;
+		uint32_t expo = ( h >> 10 ) & 0x1f, mant = h & 0x3ff, x;
+		if( expo == 0 ){
+			if( mant == 0 ) x = sign;
+			else { // subnormal, normalize
+				expo = 113;
+				while( !( mant & 0x400 ) ){ mant <<= 1; --expo; }
+				x = sign | ( expo << 23 ) | ( ( mant & 0x3ff ) << 13 );
+			}
+		}
+		else if( expo == 31 ) x = sign | 0x7f800000 | ( mant << 13 );
+		else x = sign | ( ( expo + 112 ) << 23 ) | ( mant << 13 );
+		float f;
+		std::memcpy( &f, &x, 4 );
+		return f;
+	#endif
+}
+
+// read-only 3D grid with the same lookup semantics as VoxelArray<3,float,float>::at,
+// stored as fp16 or as int8. voxels are kept in 4x4x4 bricks, z-order inside
+// each brick, so atoms near each other mostly hit the same one or two cache
+// lines. int8 has one scale per brick: target grids run from hundreds of kcal
+// inside the target to shallow wells of a few kcal, and a single scale for
+// the grid would round the wells away. zero is stored exactly in both formats
+struct CompactVoxelArray {
+
+	enum Precision { FP16, INT8 };
+	static int const BRICK_BITS = 2;
+	static int64_t const BRICK = 1 << BRICK_BITS;
+	static int64_t const BRICK_SIZE = BRICK*BRICK*BRICK;
+
+	typedef float Float;
+	typedef util::SimpleArray<3,size_t> Indices;
+	typedef util::SimpleArray<3,Float> Bounds;
+
+	Bounds lb_,ub_,cs_;
+
+	CompactVoxelArray() : precision_(FP16), nbrick_y_(0), nbrick_z_(0) {}
+
+	// any VoxelArray<3,...>, shape is kept so lookups match it voxel for voxel
+	template< class VoxelArray >
+	CompactVoxelArray( VoxelArray const & src, Precision precision ) : precision_(precision) {
+		for( int i = 0; i < 3; ++i ){
+			lb_[i] = src.lb_[i];
+			ub_[i] = src.ub_[i];
+			cs_[i] = src.cs_[i];
+			shape_[i] = src.shape()[i];
+		}
+		init_layout();
+		size_t const nbricks = nbrick( 0 ) * nbrick_y_ * nbrick_z_;
+		std::vector<float> vals;
+		if( precision_ == INT8 ){
+			vals.resize( nbricks * BRICK_SIZE, 0 );
+			int8_.resize( nbricks * BRICK_SIZE, 0 );
+			brick_scale_.resize( nbricks, float_to_half( 1.0f ) );
+		} else {
+			fp16_.resize( nbricks * BRICK_SIZE, 0 );
+		}
+		for( size_t i = 0; i < shape_[0]; ++i ){
+		for( size_t j = 0; j < shape_[1]; ++j ){
+		for( size_t k = 0; k < shape_[2]; ++k ){
+			float const val = src.data()[ i*src.strides()[0] + j*src.strides()[1] + k*src.strides()[2] ];
+			size_t const idx = index( i, j, k );
+			if( precision_ == INT8 ) vals[idx] = val;
+			else fp16_[idx] = float_to_half( val );
+		}}}
+		for( size_t ib = 0; ib < brick_scale_.size(); ++ib ){
+			float maxabs = 0;
+			for( int64_t m = 0; m < BRICK_SIZE; ++m ) maxabs = std::max( maxabs, std::abs( vals[ ib*BRICK_SIZE + m ] ) );
+			// the scale is stored as fp16, rounded up so the largest value still fits
+			uint16_t h = float_to_half( maxabs > 0 ? maxabs / 127.0f : 1.0f );
+			if( half_to_float( h ) < maxabs / 127.0f ) ++h;
+			brick_scale_[ib] = h;
+			float const scale = half_to_float( h );
+			for( int64_t m = 0; m < BRICK_SIZE; ++m ){
+				float const q = std::round( vals[ ib*BRICK_SIZE + m ] / scale );
+				int8_[ ib*BRICK_SIZE + m ] = (int8_t)std::max( -127.0f, std::min( 127.0f, q ) );
+			}
+		}
+	}
+
+	Precision precision() const { return precision_; }
+	// int8 quantization step of the brick holding voxel i,j,k
+	float scale( int64_t i, int64_t j, int64_t k ) const { return half_to_float( brick_scale_[ index( i, j, k ) >> ( 3*BRICK_BITS ) ] ); }
+	float max_scale() const { return brick_scale_.empty() ? 0 : half_to_float( *std::max_element( brick_scale_.begin(), brick_scale_.end() ) ); }
+	Indices const & shape() const { return shape_; }
+	size_t num_elements() const { return shape_[0]*shape_[1]*shape_[2]; }
+	size_t mem_use() const { return sizeof(*this) + fp16_.size()*sizeof(uint16_t) + int8_.size() + brick_scale_.size()*sizeof(uint16_t); }
+
+	// position in storage of voxel i,j,k, which must be in bounds
+	size_t index( int64_t i, int64_t j, int64_t k ) const {
+		size_t const brick = ( ( i >> BRICK_BITS ) * nbrick_y_ + ( j >> BRICK_BITS ) ) * nbrick_z_ + ( k >> BRICK_BITS );
+		size_t const m = dilated_[ i & (BRICK-1) ] << 2 | dilated_[ j & (BRICK-1) ] << 1 | dilated_[ k & (BRICK-1) ];
+		return brick * BRICK_SIZE + m;
+	}
+
+	float value( int64_t i, int64_t j, int64_t k ) const {
+		size_t const idx = index( i, j, k );
+		return precision_ == INT8 ? int8_[idx] * half_to_float( brick_scale_[ idx >> ( 3*BRICK_BITS ) ] ) : half_to_float( fp16_[idx] );
+	}
+
+	float at( Float f, Float g, Float h ) const {
+		// same conversion as VoxelArray::floats_to_index
+		size_t const i = (Float)( ( f - lb_[0] ) / cs_[0] );
+		size_t const j = (Float)( ( g - lb_[1] ) / cs_[1] );
+		size_t const k = (Float)( ( h - lb_[2] ) / cs_[2] );
+		if( i < shape_[0] && j < shape_[1] && k < shape_[2] ) return value( i, j, k );
+		return 0;
+	}
+
+	template<class V>
+	float at( V const & v ) const { return at( v[0], v[1], v[2] ); }
+
+private:
+	size_t nbrick( int d ) const { return ( shape_[d] + BRICK - 1 ) >> BRICK_BITS; }
+
+	void init_layout(){
+		nbrick_y_ = nbrick( 1 );
+		nbrick_z_ = nbrick( 2 );
+		for( int i = 0; i < BRICK; ++i ) dilated_[i] = util::dilate<3>( i );
+	}
+
+	Precision precision_;
+	Indices shape_;
+	size_t nbrick_y_, nbrick_z_;
+	uint8_t dilated_[BRICK];
+	std::vector<uint16_t> fp16_;
+	std::vector<int8_t> int8_;
+	std::vector<uint16_t> brick_scale_; // fp16
+};
+
+inline std::ostream & operator << ( std::ostream & out, CompactVoxelArray const & v ){
+	out << "CompactVoxelArray( lb: " << v.lb_ << " ub: " << v.ub_ << " cs: " << v.cs_ << " nelem: " << v.num_elements()
+	    << ( v.precision() == CompactVoxelArray::INT8 ? " int8 max brick scale: " + std::to_string( v.max_scale() ) : std::string(" fp16") ) << " )";
+	return out;
+}
+
+}}}
+
+#endif
@@ -2,6 +2,8 @@
 
 #include <scheme/search/HackPack.hh>
 
+#include <random>
+
 
 namespace scheme { namespace search { namespace hptest {
 
@@ -20,4 +22,170 @@ TEST( HackPack, create_empty_packer ){
 
 }
 
+TEST( HackPack, incremental_delta_matches_reference ){
+	typedef ::scheme::objective::storage::TwoBodyTable<float> TBT;
+	int const NRES = 12, NROT = 20;
+	std::mt19937 rng( 3874 );
+	std::uniform_real_distribution<float> runif;
+	shared_ptr<TBT> twob = make_shared<TBT>( NRES, NROT );
+	for( int ires = 0; ires < NRES; ++ires )
+		for( int irot = 0; irot < NROT; ++irot )
+			twob->set_onebody( ires, irot, runif(rng) < 0.2 ? 99.0 : runif(rng)*4.0-2.0 );
+	twob->init_onebody_filter( 10.0 );
+	for( int ires = 0; ires < NRES; ++ires ){
+		for( int jres = 0; jres < ires; ++jres ){
+			if( runif(rng) < 0.5 ) continue; // leave some pairs without a table
+			twob->init_twobody( ires, jres );
+			for( int i = 0; i < twob->nsel_[ires]; ++i )
+				for( int j = 0; j < twob->nsel_[jres]; ++j )
+					twob->twobody_[ires][jres][i][j] = runif(rng)*6.0-3.0;
+		}
+	}
+
+	HackPackOpts opts;
+	HackPack packer( opts, 0 );
+	packer.reinitialize( twob );
+	for( int ires = 0; ires < NRES; ++ires )
+		for( int irot = 0; irot < NROT; ++irot )
+			if( packer.using_rotamer( ires, irot ) ) packer.add_tmp_rot( ires, irot, twob->onebody( ires, irot ) );
+
+	packer.build_edge_tiles();
+	packer.assign_random_rots();
+	packer.update_res_energy_cache();
+	float score = packer.compute_energy_full( packer.current_rots_ );
+	for( int k = 0; k < 2000; ++k ){
+		int32_t ires, irot;
+		packer.randrot_not_current_uniform_rot( ires, irot );
+		float ref = packer.compute_energy_delta( packer.current_rots_, ires, irot );
+		float inc = packer.compute_energy_delta_incremental( ires, irot );
+		ASSERT_NEAR( ref, inc, 1e-3 );
+		if( runif(rng) < 0.5 ){
+			packer.accept_substitution( ires, irot );
+			score += inc;
+		}
+	}
+	ASSERT_NEAR( score, packer.compute_energy_full( packer.current_rots_ ), 1e-2 );
+
+	std::vector<std::pair<int32_t,int32_t> > result_rots;
+	packer.pack( result_rots );
+	ASSERT_EQ( result_rots.size(), NRES );
+}
+
+TEST( HackPack, exact_packer_matches_brute_force ){
+	typedef ::scheme::objective::storage::TwoBodyTable<float> TBT;
+	int const NRES = 6, NROT = 8;
+	std::mt19937 rng( 1209 );
+	std::uniform_real_distribution<float> runif;
+	for( int itest = 0; itest < 10; ++itest ){
+		shared_ptr<TBT> twob = make_shared<TBT>( NRES, NROT );
+		for( int ires = 0; ires < NRES; ++ires )
+			for( int irot = 0; irot < NROT; ++irot )
+				twob->set_onebody( ires, irot, runif(rng)*4.0-2.0 );
+		twob->init_onebody_filter( 10.0 );
+		for( int ires = 0; ires < NRES; ++ires ){
+			for( int jres = 0; jres < ires; ++jres ){
+				if( runif(rng) < 0.4 ) continue;
+				twob->init_twobody( ires, jres );
+				for( int i = 0; i < NROT; ++i )
+					for( int j = 0; j < NROT; ++j )
+						twob->twobody_[ires][jres][i][j] = runif(rng)*6.0-3.0;
+			}
+		}
+
+		HackPackOpts opts;
+		opts.packer = "exact";
+		HackPack packer( opts, 0 );
+		packer.reinitialize( twob );
+		for( int ires = 0; ires < NRES; ++ires )
+			for( int irot = 1; irot < NROT; ++irot ) // rot 0 is added as the default rot
+				packer.add_tmp_rot( ires, irot, twob->onebody( ires, irot ) );
+		std::vector<std::pair<int32_t,int32_t> > result_rots;
+		float score = packer.pack( result_rots );
+		ASSERT_EQ( result_rots.size(), NRES );
+
+		// brute force over all NROT^NRES assignments
+		std::vector<int32_t> rots( NRES, 0 );
+		float best = 9e9;
+		for( int64_t i = 0; i < (int64_t)std::pow( NROT, NRES ); ++i ){
+			int64_t k = i;
+			for( int ires = 0; ires < NRES; ++ires ){ rots[ires] = k % NROT; k /= NROT; }
+			best = std::min( best, packer.compute_energy_full( rots ) );
+		}
+		ASSERT_NEAR( score, best, 1e-3 );
+
+		// annealing can't beat it
+		packer.opts_.packer = "anneal";
+		ASSERT_GE( packer.pack( result_rots ), score - 1e-3 );
+		// over the cost limit auto falls back to annealing
+		packer.opts_.packer = "auto";
+		packer.opts_.exact_pack_max_cost = 10;
+		packer.build_edge_tiles();
+		ASSERT_FALSE( packer.pack_exact( packer.opts_.exact_pack_max_cost ) );
+		// so does exact once a table would be too big
+		packer.opts_.packer = "exact";
+		packer.opts_.exact_pack_max_table = 1;
+		ASSERT_FALSE( packer.pack_exact( 9e99 ) );
+		ASSERT_GE( packer.pack( result_rots ), score - 1e-3 );
+	}
+}
+
+TEST( HackPack, twobody_edits_match_modified_table ){
+	typedef ::scheme::objective::storage::TwoBodyTable<float> TBT;
+	int const NRES = 10, NROT = 12;
+	std::mt19937 rng( 5521 );
+	std::uniform_real_distribution<float> runif;
+	shared_ptr<TBT> twob = make_shared<TBT>( NRES, NROT );
+	for( int ires = 0; ires < NRES; ++ires )
+		for( int irot = 0; irot < NROT; ++irot )
+			twob->set_onebody( ires, irot, runif(rng) < 0.2 ? 99.0 : runif(rng)*4.0-2.0 );
+	twob->init_onebody_filter( 10.0 );
+	for( int ires = 0; ires < NRES; ++ires ){
+		for( int jres = 0; jres < ires; ++jres ){
+			if( runif(rng) < 0.3 ) continue;
+			twob->init_twobody( ires, jres );
+			for( int i = 0; i < twob->nsel_[ires]; ++i )
+				for( int j = 0; j < twob->nsel_[jres]; ++j )
+					twob->twobody_[ires][jres][i][j] = runif(rng)*6.0-3.0;
+		}
+	}
+	shared_ptr<TBT const> original = twob->clone();
+	shared_ptr<TBT> modified = twob->clone();
+
+	HackPackOpts opts;
+	HackPack packer( opts, 0 ), reference( opts, 0 );
+	packer.reinitialize( twob );
+	reference.reinitialize( modified );
+	for( int k = 0; k < 60; ++k ){
+		int const ires = rng() % NRES, jres = rng() % NRES, irot = rng() % NROT, jrot = rng() % NROT;
+		if( ires == jres ) continue;
+		float const upweight = runif(rng)*3.0;
+		packer.upweight_edge( ires, jres, irot, jrot, upweight );
+		modified->upweight_edge( ires, jres, irot, jrot, upweight );
+	}
+	ASSERT_FALSE( packer.twob_overlay_.empty() );
+	ASSERT_TRUE( twob->check_equal( *original ) );
+
+	for( HackPack * p : { &packer, &reference } ){
+		for( int ires = 0; ires < NRES; ++ires )
+			for( int irot = 1; irot < NROT; ++irot )
+				if( p->using_rotamer( ires, irot ) ) p->add_tmp_rot( ires, irot, twob->onebody( ires, irot ) );
+		p->build_edge_tiles();
+	}
+	ASSERT_EQ( packer.edge_e_, reference.edge_e_ );
+	for( int k = 0; k < 200; ++k ){
+		reference.assign_random_rots();
+		packer.current_rots_ = reference.current_rots_;
+		ASSERT_FLOAT_EQ( reference.compute_energy_full( reference.current_rots_ ), packer.compute_energy_full( packer.current_rots_ ) );
+	}
+
+	packer.clear_twobody_edits();
+	packer.build_edge_tiles();
+	reference.reinitialize( original );
+	for( int ires = 0; ires < NRES; ++ires )
+		for( int irot = 1; irot < NROT; ++irot )
+			if( reference.using_rotamer( ires, irot ) ) reference.add_tmp_rot( ires, irot, twob->onebody( ires, irot ) );
+	reference.build_edge_tiles();
+	ASSERT_EQ( packer.edge_e_, reference.edge_e_ );
+}
+
 }}}
@@ -5,6 +5,8 @@
 
 	#include <random>
 	#include <boost/foreach.hpp>
+	#include <algorithm>
+	#include <string>
 
 
 namespace scheme { namespace search {
@@ -51,6 +53,9 @@ struct HackPackOpts
 	float user_rotamer_bonus_constant = -2; //-2
 	float user_rotamer_bonus_per_chi = -2; // 2
 	bool  rescore_rots_before_insertion = true;		// this isn't a real flag, gets used in MyScoreBBActorVsRif
+	std::string packer = "auto"; // anneal, exact, or auto: exact when estimated cost <= exact_pack_max_cost
+	double exact_pack_max_cost = 2e6;
+	double exact_pack_max_table = 1e7; // entries in any one elimination table, even with packer exact
 };
 inline
 std::ostream & operator<<( std::ostream & out, HackPackOpts const & hpo ){
@@ -69,6 +74,9 @@ std::ostream & operator<<( std::ostream & out, HackPackOpts const & hpo ){
 		<< "\n  user_rotamer_bonus_constant " << hpo.user_rotamer_bonus_constant 
 		<< "\n  user_rotamer_bonus_per_chi" << hpo.user_rotamer_bonus_per_chi
 		<< "\n  rescore_rots_before_insertion " << hpo.rescore_rots_before_insertion
+		<< "\n  packer " << hpo.packer
+		<< "\n  exact_pack_max_cost " << hpo.exact_pack_max_cost
+		<< "\n  exact_pack_max_table " << hpo.exact_pack_max_table
 
 
 	    << std::endl;
@@ -79,15 +87,25 @@ struct HackPack
 {
 	typedef std::pair<int32_t,float> RotInfo;
 	typedef std::pair< int32_t, std::vector< RotInfo > > RotInfos;
+	// one direction of a residue pair with a nonzero twobody table. the pair's
+	// energies live in one contiguous tile of edge_e_, energy for local rots
+	// irot,jrot is edge_e_[ offset + irot*istride + jrot*jstride ]
+	struct EdgeRef { int32_t jres, offset, istride, jstride; };
 	int nres_; // total res currently stored
 	std::vector< RotInfos > res_rots_; // iresapp + list of irottwob/onebody pairs
 	std::vector< std::pair<int32_t,int32_t> > rot_list_; // list of ireslocal / irotlocal pairs
 	std::vector< int32_t > current_rots_, trial_best_rots_, global_best_rots_; // current rotamer in local numbering
 	std::mt19937 rng;
-	shared_ptr<::scheme::objective::storage::TwoBodyTable<float>> twob_; 
+	shared_ptr<::scheme::objective::storage::TwoBodyTable<float> const> twob_; // shared by all threads, never modified
+	::scheme::objective::storage::TwoBodyOverlay<float> twob_overlay_; // this packer's edits to twob_
 	float score_, trial_best_score_, global_best_score_;
 	HackPackOpts opts_;
 	int32_t default_rot_num_;
+	// flat twobody tiles in local numbering, built at start of pack()
+	std::vector< float > edge_e_;
+	std::vector< EdgeRef > edges_; // grouped by residue
+	std::vector< int32_t > edge_begin_; // edges of ilres are [ edge_begin_[ilres], edge_begin_[ilres+1] )
+	std::vector< float > cur_res_e_; // twobody energy of each res with its neighbors at current_rots_
 	HackPack(
 		// ::scheme::objective::storage::TwoBodyTable<float> const & twob,
 		HackPackOpts const & opts,
@@ -102,11 +120,12 @@ struct HackPack
 	{}
 
 	void reinitialize(
-		shared_ptr<::scheme::objective::storage::TwoBodyTable<float> > twob ){
+		shared_ptr<::scheme::objective::storage::TwoBodyTable<float> const> twob ){
 
 		// Brian
 
 		twob_ = twob;
+		twob_overlay_.clear();
 		ALWAYS_ASSERT( twob_->nrot_ > 0 );
 		ALWAYS_ASSERT( twob_->nres_ > 0 );
 		ALWAYS_ASSERT( twob_->nrot_ < 99999 );
@@ -178,6 +197,17 @@ struct HackPack
 	}
 
 
+	// add upweight to the twobody energy of global rots irot,jrot for this
+	// packer only, until clear_twobody_edits() or reinitialize()
+	void upweight_edge( int ires, int jres, int irot, int jrot, float upweight ){
+		twob_overlay_.upweight_edge( *twob_, ires, jres, irot, jrot, upweight );
+	}
+	void clear_twobody_edits(){ twob_overlay_.clear(); }
+
+	float twobody_rotlocalnumbering( int ires, int jres, int irotlocal, int jrotlocal ) const {
+		return twob_overlay_.twobody_rotlocalnumbering( *twob_, ires, jres, irotlocal, jrotlocal );
+	}
+
 	float
 	compute_energy_full(
 		std::vector< int32_t > const & rots
@@ -209,7 +239,7 @@ struct HackPack
 				int32_t const jresglobal = res_rots_.at(jres).first;
 				int32_t const jrottwob   = res_rots_.at(jres).second.at( jrotlocal ).first;
 				float const jonebody     = res_rots_.at(jres).second.at( jrotlocal ).second;
-				float const twobodye     = twob_->twobody_rotlocalnumbering( iresglobal, jresglobal, irottwob, jrottwob );
+				float const twobodye     = twobody_rotlocalnumbering( iresglobal, jresglobal, irottwob, jrottwob );
 				score += twobodye;
 					// int irotglobal = twob_->sel2all_[ iresglobal ][ irottwob ];
 					// int jrotglobal = twob_->sel2all_[ jresglobal ][ jrottwob ];
@@ -244,8 +274,8 @@ struct HackPack
 			int32_t const jresglobal = res_rots_.at(j).first;
 			int32_t const jrottwob   = res_rots_.at(j).second.at( rots.at(j) ).first;
 			float   const jonebody   = res_rots_.at(j).second.at( rots.at(j) ).second;
-			float   const twobodyeold = twob_->twobody_rotlocalnumbering( iresglobal, jresglobal, irottwobold, jrottwob );
-			float   const twobodyenew = twob_->twobody_rotlocalnumbering( iresglobal, jresglobal, irottwobnew, jrottwob );
+			float   const twobodyeold = twobody_rotlocalnumbering( iresglobal, jresglobal, irottwobold, jrottwob );
+			float   const twobodyenew = twobody_rotlocalnumbering( iresglobal, jresglobal, irottwobnew, jrottwob );
 			delta -= twobodyeold;
 			delta += twobodyenew;
 			// std::cout << "DELTA TWOB"
@@ -273,6 +303,299 @@ struct HackPack
 		}
 		return delta;
 	}
+
+	// copy the twobody tables needed by the current rotamer set into one
+	// contiguous buffer, so the packing loop only touches residue pairs that
+	// interact and indexes them without going through the boost arrays.
+	// edits in twob_overlay_ are added to the tiles here
+	void build_edge_tiles(){
+		edge_begin_.assign( nres_+1, 0 );
+		for( int ires = 0; ires < nres_; ++ires ){
+			for( int jres = 0; jres < ires; ++jres ){
+				if( !twobody_table( ires, jres ) ) continue;
+				++edge_begin_[ires+1];
+				++edge_begin_[jres+1];
+			}
+		}
+		for( int ires = 0; ires < nres_; ++ires ) edge_begin_[ires+1] += edge_begin_[ires];
+		edges_.resize( edge_begin_[nres_] );
+		edge_e_.clear();
+		std::vector< int32_t > pos( edge_begin_.begin(), edge_begin_.end()-1 );
+		for( int ires = 0; ires < nres_; ++ires ){
+			std::vector< RotInfo > const & irots = res_rots_[ires].second;
+			for( int jres = 0; jres < ires; ++jres ){
+				::scheme::objective::storage::TwoBodyTable<float>::Array2D const * table = twobody_table( ires, jres );
+				if( !table ) continue;
+				std::vector< RotInfo > const & jrots = res_rots_[jres].second;
+				bool const iisfirst = res_rots_[ires].first > res_rots_[jres].first;
+				int32_t const offset = edge_e_.size();
+				int32_t const ni = irots.size(), nj = jrots.size();
+				edge_e_.resize( offset + ni*nj );
+				for( int irot = 0; irot < ni; ++irot ){
+					float * row = &edge_e_[ offset + irot*nj ];
+					for( int jrot = 0; jrot < nj; ++jrot ){
+						row[jrot] = iisfirst ? (*table)[ irots[irot].first ][ jrots[jrot].first ]
+						                     : (*table)[ jrots[jrot].first ][ irots[irot].first ];
+					}
+				}
+				for( auto const & edit : twob_overlay_.edits_ ){
+					int32_t const ir = iisfirst ? res_rots_[ires].first : res_rots_[jres].first;
+					int32_t const jr = iisfirst ? res_rots_[jres].first : res_rots_[ires].first;
+					if( edit.ir != ir || edit.jr != jr ) continue;
+					int32_t const irl = iisfirst ? edit.irl : edit.jrl;
+					int32_t const jrl = iisfirst ? edit.jrl : edit.irl;
+					for( int irot = 0; irot < ni; ++irot ){
+						if( irots[irot].first != irl ) continue;
+						for( int jrot = 0; jrot < nj; ++jrot ){
+							if( jrots[jrot].first == jrl ) edge_e_[ offset + irot*nj + jrot ] += edit.delta;
+						}
+					}
+				}
+				EdgeRef & ie = edges_[ pos[ires]++ ];
+				ie.jres = jres; ie.offset = offset; ie.istride = nj; ie.jstride = 1;
+				EdgeRef & je = edges_[ pos[jres]++ ];
+				je.jres = ires; je.offset = offset; je.istride = 1; je.jstride = nj;
+			}
+		}
+	}
+	::scheme::objective::storage::TwoBodyTable<float>::Array2D const *
+	twobody_table( int32_t ilres, int32_t jlres ) const {
+		int32_t const iresglobal = res_rots_[ilres].first;
+		int32_t const jresglobal = res_rots_[jlres].first;
+		int32_t const ir = iresglobal > jresglobal ? iresglobal : jresglobal;
+		int32_t const jr = iresglobal > jresglobal ? jresglobal : iresglobal;
+		::scheme::objective::storage::TwoBodyTable<float>::Array2D const & table = twob_->twobody_[ir][jr];
+		return table.num_elements() > 0 ? &table : nullptr;
+	}
+	float edge_energy( EdgeRef const & e, int32_t irot, int32_t jrot ) const {
+		return edge_e_[ e.offset + irot*e.istride + jrot*e.jstride ];
+	}
+	void update_res_energy_cache(){
+		cur_res_e_.assign( nres_, 0.0f );
+		for( int ilres = 0; ilres < nres_; ++ilres ){
+			for( int k = edge_begin_[ilres]; k < edge_begin_[ilres+1]; ++k ){
+				cur_res_e_[ilres] += edge_energy( edges_[k], current_rots_[ilres], current_rots_[ edges_[k].jres ] );
+			}
+		}
+	}
+	// same as compute_energy_delta( current_rots_, ... ) but only visits
+	// neighbors of ilres and takes the old energy from cur_res_e_
+	float
+	compute_energy_delta_incremental(
+		int32_t const & ilres,
+		int32_t const & ilrotnew
+	) const {
+		std::vector< RotInfo > const & rots = res_rots_[ilres].second;
+		float delta = rots[ilrotnew].second - rots[ current_rots_[ilres] ].second - cur_res_e_[ilres];
+		for( int k = edge_begin_[ilres]; k < edge_begin_[ilres+1]; ++k ){
+			delta += edge_energy( edges_[k], ilrotnew, current_rots_[ edges_[k].jres ] );
+		}
+		if( -123460.0 > delta || delta > 123460.0 ){
+			// let the reference version report it
+			return compute_energy_delta( current_rots_, ilres, ilrotnew );
+		}
+		return delta;
+	}
+	void accept_substitution( int32_t const & ilres, int32_t const & ilrotnew ){
+		int32_t const ilrotold = current_rots_[ilres];
+		float enew = 0.0f;
+		for( int k = edge_begin_[ilres]; k < edge_begin_[ilres+1]; ++k ){
+			EdgeRef const & e = edges_[k];
+			float const ejnew = edge_energy( e, ilrotnew, current_rots_[e.jres] );
+			cur_res_e_[e.jres] += ejnew - edge_energy( e, ilrotold, current_rots_[e.jres] );
+			enew += ejnew;
+		}
+		cur_res_e_[ilres] = enew;
+		current_rots_[ilres] = ilrotnew;
+	}
+
+	// Goldstein singles DEE: drop ilrot r at ilres if some other alive t has
+	// E1(r) - E1(t) + sum_j min_s [ E(r,s) - E(t,s) ] > 0, repeated until
+	// nothing changes. never removes the rotamer of the optimal solution
+	void prune_dee_goldstein( std::vector< std::vector<char> > & alive ) const {
+		alive.resize( nres_ );
+		for( int ilres = 0; ilres < nres_; ++ilres ) alive[ilres].assign( res_rots_[ilres].second.size(), 1 );
+		bool changed = true;
+		while( changed ){
+			changed = false;
+			for( int ilres = 0; ilres < nres_; ++ilres ){
+				std::vector< RotInfo > const & rots = res_rots_[ilres].second;
+				for( int r = 0; r < rots.size(); ++r ){
+					if( !alive[ilres][r] ) continue;
+					for( int t = 0; t < rots.size(); ++t ){
+						if( t == r || !alive[ilres][t] ) continue;
+						float gap = rots[r].second - rots[t].second;
+						for( int k = edge_begin_[ilres]; k < edge_begin_[ilres+1]; ++k ){
+							EdgeRef const & e = edges_[k];
+							float mindiff = 9e9;
+							for( int s = 0; s < alive[e.jres].size(); ++s ){
+								if( !alive[e.jres][s] ) continue;
+								mindiff = std::min( mindiff, edge_energy( e, r, s ) - edge_energy( e, t, s ) );
+							}
+							gap += mindiff;
+						}
+						if( gap > 1e-4 ){
+							alive[ilres][r] = 0;
+							changed = true;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// variable elimination over the interaction graph (exact DP on the tree
+	// decomposition given by a greedy min-table-size elimination order).
+	// returns false without packing if the estimated work exceeds max_cost,
+	// a table would exceed opts_.exact_pack_max_table entries, or the result
+	// doesn't rescore to the dp total; the caller then anneals
+	bool pack_exact( double max_cost ){
+		// DEE itself is quadratic in rotamers per res, skip it if that's already too much
+		double dee_cost = 0;
+		for( int ilres = 0; ilres < nres_; ++ilres ){
+			double nnbr = 0;
+			for( int k = edge_begin_[ilres]; k < edge_begin_[ilres+1]; ++k ) nnbr += res_rots_[ edges_[k].jres ].second.size();
+			dee_cost += (double)res_rots_[ilres].second.size() * res_rots_[ilres].second.size() * nnbr;
+		}
+		if( dee_cost > 10*max_cost ) return false;
+
+		std::vector< std::vector<char> > alive;
+		prune_dee_goldstein( alive );
+		std::vector< std::vector< int32_t > > dom( nres_ );
+		for( int ilres = 0; ilres < nres_; ++ilres ){
+			for( int r = 0; r < alive[ilres].size(); ++r ) if( alive[ilres][r] ) dom[ilres].push_back( r );
+			ALWAYS_ASSERT( dom[ilres].size() > 0 );
+		}
+
+		// elimination order and cost estimate on the graph alone
+		std::vector< std::vector< char > > adj( nres_, std::vector< char >( nres_, 0 ) );
+		for( int ilres = 0; ilres < nres_; ++ilres )
+			for( int k = edge_begin_[ilres]; k < edge_begin_[ilres+1]; ++k ) adj[ilres][ edges_[k].jres ] = 1;
+		std::vector< int32_t > order;
+		std::vector< char > eliminated( nres_, 0 );
+		double cost = 0;
+		for( int iter = 0; iter < nres_; ++iter ){
+			int32_t best = -1;
+			double bestsize = 9e99;
+			for( int v = 0; v < nres_; ++v ){
+				if( eliminated[v] ) continue;
+				double size = 1;
+				for( int u = 0; u < nres_; ++u ) if( !eliminated[u] && adj[v][u] ) size *= dom[u].size();
+				if( size < bestsize ){ bestsize = size; best = v; }
+			}
+			cost += bestsize * dom[best].size();
+			if( cost > max_cost || bestsize > opts_.exact_pack_max_table ) return false;
+			eliminated[best] = 1;
+			order.push_back( best );
+			for( int u = 0; u < nres_; ++u ){
+				if( eliminated[u] || !adj[best][u] ) continue;
+				for( int w = 0; w < nres_; ++w ) if( w != u && !eliminated[w] && adj[best][w] ) adj[u][w] = 1;
+			}
+		}
+
+		// factors over dom indices, vars sorted, last var fastest
+		struct Factor { std::vector< int32_t > vars; std::vector< float > e; };
+		std::vector< Factor > factors;
+		for( int ilres = 0; ilres < nres_; ++ilres ){
+			Factor f;
+			f.vars.push_back( ilres );
+			for( int32_t r : dom[ilres] ) f.e.push_back( res_rots_[ilres].second[r].second );
+			factors.push_back( f );
+			for( int k = edge_begin_[ilres]; k < edge_begin_[ilres+1]; ++k ){
+				EdgeRef const & e = edges_[k];
+				if( e.jres < ilres ) continue; // each pair once, as ( ilres, jres )
+				Factor g;
+				g.vars.push_back( ilres );
+				g.vars.push_back( e.jres );
+				for( int32_t r : dom[ilres] ) for( int32_t s : dom[e.jres] ) g.e.push_back( edge_energy( e, r, s ) );
+				factors.push_back( g );
+			}
+		}
+
+		// eliminate, keeping the argmin table of each var for the traceback
+		std::vector< std::vector< int32_t > > scopes( nres_ );
+		std::vector< std::vector< int32_t > > argmins( nres_ );
+		float total = 0;
+		for( int32_t v : order ){
+			std::vector< Factor > bucket, rest;
+			for( Factor & f : factors ){
+				if( std::find( f.vars.begin(), f.vars.end(), v ) != f.vars.end() ) bucket.push_back( f );
+				else rest.push_back( f );
+			}
+			std::vector< int32_t > scope;
+			for( Factor const & f : bucket ) for( int32_t u : f.vars ) if( u != v ) scope.push_back( u );
+			std::sort( scope.begin(), scope.end() );
+			scope.erase( std::unique( scope.begin(), scope.end() ), scope.end() );
+			// stride of each scope var and of v in each bucket factor
+			int const ns = scope.size();
+			std::vector< std::vector< int64_t > > strides( bucket.size(), std::vector< int64_t >( ns, 0 ) );
+			std::vector< int64_t > vstride( bucket.size(), 0 );
+			for( int ib = 0; ib < bucket.size(); ++ib ){
+				int64_t stride = 1;
+				for( int iv = bucket[ib].vars.size()-1; iv >= 0; --iv ){
+					int32_t const u = bucket[ib].vars[iv];
+					if( u == v ) vstride[ib] = stride;
+					else strides[ib][ std::lower_bound( scope.begin(), scope.end(), u ) - scope.begin() ] = stride;
+					stride *= dom[u].size();
+				}
+			}
+			Factor msg;
+			msg.vars = scope;
+			int64_t size = 1;
+			for( int32_t u : scope ) size *= dom[u].size();
+			msg.e.resize( size );
+			std::vector< int32_t > & argmin = argmins[v];
+			argmin.resize( size );
+			std::vector< int32_t > assign( ns, 0 );
+			std::vector< int64_t > base( bucket.size() );
+			for( int64_t idx = 0; idx < size; ++idx ){
+				for( int ib = 0; ib < bucket.size(); ++ib ){
+					base[ib] = 0;
+					for( int is = 0; is < ns; ++is ) base[ib] += assign[is] * strides[ib][is];
+				}
+				float best = 9e9;
+				int32_t bestx = 0;
+				for( int x = 0; x < dom[v].size(); ++x ){
+					float e = 0;
+					for( int ib = 0; ib < bucket.size(); ++ib ) e += bucket[ib].e[ base[ib] + x*vstride[ib] ];
+					if( e < best ){ best = e; bestx = x; }
+				}
+				msg.e[idx] = best;
+				argmin[idx] = bestx;
+				for( int is = ns-1; is >= 0; --is ){ // last var fastest
+					if( ++assign[is] < dom[ scope[is] ].size() ) break;
+					assign[is] = 0;
+				}
+			}
+			scopes[v] = scope;
+			if( scope.empty() ) total += msg.e[0];
+			else rest.push_back( msg );
+			factors.swap( rest );
+		}
+
+		// traceback: vars in each scope are eliminated later, so already assigned
+		std::vector< int32_t > x( nres_, 0 );
+		for( int io = order.size()-1; io >= 0; --io ){
+			int32_t const v = order[io];
+			int64_t idx = 0;
+			for( int32_t u : scopes[v] ) idx = idx * dom[u].size() + x[u];
+			x[v] = argmins[v][idx];
+		}
+		std::vector< int32_t > rots( nres_ );
+		for( int ilres = 0; ilres < nres_; ++ilres ) rots[ilres] = dom[ilres][ x[ilres] ];
+		float const score = compute_energy_full( rots );
+		if( std::fabs( score - total ) >= 0.01 + 1e-4*std::fabs(total) ){
+			std::cerr << "HackPack::pack_exact: rescored " << score << " != dp total " << total
+			          << " (diff " << score - total << "), falling back to annealing" << std::endl;
+			return false;
+		}
+		current_rots_ = rots;
+		global_best_rots_ = current_rots_;
+		score_ = global_best_score_ = score;
+		return true;
+	}
+
 	int32_t randres()
 	{
 		std::uniform_int_distribution<> rand_idx(0,nres_-1);
@@ -318,7 +641,7 @@ struct HackPack
 		int32_t ires, irot;
 		randrot_not_current_uniform_rot( ires, irot );
 
-		float delta = compute_energy_delta( current_rots_, ires, irot );
+		float delta = compute_energy_delta_incremental( ires, irot );
 		// {
 		// 	// std::cout << "SUB: " << ires << " " << irot << " " << res_rots_[ires].first << std::endl;
 		// 	// std::cout << "==================================== old ==========================================" << std::endl;
@@ -339,7 +662,7 @@ struct HackPack
 		// }
 
 		if( pass_metropolis( temperature, delta, runif(rng) ) ){
-			current_rots_.at(ires) = irot;
+			accept_substitution( ires, irot );
 			score_ += delta;
 			if( score_ < trial_best_score_ ){
 				trial_best_score_ = score_;
@@ -350,6 +673,7 @@ struct HackPack
 	void recover_trial_best(){
 		score_ = trial_best_score_;
 		current_rots_ = trial_best_rots_;
+		update_res_energy_cache(); // also clears drift from the incremental updates
 	}
 	void assign_random_rots(){
 		current_rots_.resize( nres_ );
@@ -424,12 +748,23 @@ struct HackPack
 			return score_;
 		}
 
+		build_edge_tiles();
+
+		if( opts_.packer != "anneal" ){
+			double const max_cost = opts_.packer == "exact" ? 9e99 : opts_.exact_pack_max_cost;
+			if( pack_exact( max_cost ) ){
+				fill_result_rots( result_rots );
+				return score_;
+			}
+		}
+
 		int const ntrials = opts_.pack_n_iters;
 		int const pack_iters = opts_.pack_iter_mult * rot_list_.size()+10;
 		global_best_score_ = 9e9;
 		for( int k = 0; k < ntrials; ++k ){
 			if( k > 0 ) assign_initial_rots();
 			score_ = compute_energy_full( current_rots_ );
+			update_res_energy_cache();
 			trial_best_score_ = score_;
 			trial_best_rots_ = current_rots_;
 			for( int i = 0; i < pack_iters; ++i ) random_substitution_test( 100.0  ); recover_trial_best();
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <scheme/search/ParentBound.hh>
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace scheme { namespace search { namespace test_parent_bound {
+
+using std::cout;
+using std::endl;
+
+// parents with random scores, each child no better than its parent minus 2
+struct Level {
+	std::vector<float> parents;
+	std::vector< std::vector<float> > children;
+	Level( int nparents, int nchildren, int seed ){
+		std::mt19937 rng( seed );
+		std::uniform_real_distribution<float> runif;
+		for( int i = 0; i < nparents; ++i ){
+			parents.push_back( -10.0f * runif(rng) );
+			children.push_back( std::vector<float>() );
+			for( int j = 0; j < nchildren; ++j ) children.back().push_back( parents.back() - 2.0f + 4.0f * runif(rng) );
+		}
+	}
+	std::vector<float> beam( size_t beam_size, float cut ) const {
+		std::vector<float> all;
+		for( auto const & c : children ) for( float s : c ) if( s < cut ) all.push_back( s );
+		std::sort( all.begin(), all.end() );
+		if( all.size() > beam_size ) all.resize( beam_size );
+		return all;
+	}
+};
+
+std::vector<float> search( Level const & level, ParentBound<float> & bound, size_t beam_size, float cut, int nthreads ){
+	std::vector<int> order( level.parents.size() );
+	for( size_t i = 0; i < order.size(); ++i ) order[i] = i;
+	std::sort( order.begin(), order.end(), [&]( int i, int j ){ return level.parents[i] < level.parents[j]; } );
+	std::vector<float> kept;
+	std::mutex kept_mutex;
+	std::atomic<size_t> next( 0 );
+	std::vector<std::thread> threads;
+	for( int t = 0; t < nthreads; ++t ){
+		threads.emplace_back( [&,t](){
+			for( size_t i = next++; i < order.size(); i = next++ ){
+				int const ip = order[i];
+				if( bound.prune( level.parents[ip] ) ) continue;
+				float best = 9e9;
+				for( float s : level.children[ip] ){
+					best = std::min( best, s );
+					if( s >= cut ) continue;
+					bound.add_child( t, s );
+					std::lock_guard<std::mutex> lock( kept_mutex );
+					kept.push_back( s );
+				}
+				bound.add_parent( level.parents[ip], best );
+			}
+		});
+	}
+	for( auto & t : threads ) t.join();
+	std::sort( kept.begin(), kept.end() );
+	if( kept.size() > beam_size ) kept.resize( beam_size );
+	return kept;
+}
+
+TEST( ParentBound, same_beam_as_exhaustive ){
+	Level level( 20000, 64, 2384 );
+	for( float cut : { 0.0f, -10.5f } ){
+		for( int nthreads : { 1, 4 } ){
+			ParentBound<float> bound( 5000, nthreads, cut, 1.5, 100 );
+			std::vector<float> beam = search( level, bound, 5000, cut, nthreads );
+			ASSERT_EQ( level.beam( 5000, cut ), beam );
+			cout << "cut " << cut << " threads " << nthreads << " pruned " << bound.npruned() << " of " << level.parents.size()
+			     << " cutoff " << bound.cutoff() << " slack " << bound.slack() << endl;
+			ASSERT_GT( bound.npruned(), level.parents.size() / 2 );
+			ASSERT_EQ( level.parents.size(), bound.npruned() + bound.nexpanded() );
+		}
+	}
+}
+
+TEST( ParentBound, off_without_slack_scale_or_calibration ){
+	Level level( 2000, 64, 834 );
+	ParentBound<float> off( 100, 1, 0.0f, 0.0, 10 );
+	search( level, off, 100, 0.0f, 1 );
+	ASSERT_EQ( 0, off.npruned() );
+	ParentBound<float> uncalibrated( 100, 1, 0.0f, 1.5, 1000000 );
+	search( level, uncalibrated, 100, 0.0f, 1 );
+	ASSERT_EQ( 0, uncalibrated.npruned() );
+	ASSERT_LT( uncalibrated.cutoff(), 0.0f );
+}
+
+TEST( ParentBound, never_prunes_unscored_parents ){
+	// every parent still has the 9e9 placeholder, as before the first stage is scored
+	Level level( 1000, 64, 4471 );
+	for( float & p : level.parents ) p = 9e9;
+	for( float scale : { 0.5f, 1.0f, 1.5f } ){
+		ParentBound<float> bound( 100, 1, 0.0f, scale, 10 );
+		std::vector<float> beam = search( level, bound, 100, 0.0f, 1 );
+		ASSERT_EQ( 0, bound.npruned() );
+		ASSERT_EQ( 0.0f, bound.slack() );
+		ASSERT_EQ( level.beam( 100, 0.0f ), beam );
+	}
+	// scored parents still calibrate and prune when mixed with unscored ones
+	Level mixed( 20000, 64, 2384 );
+	for( size_t i = 0; i < mixed.parents.size(); i += 10 ) mixed.parents[i] = 9e9;
+	ParentBound<float> bound( 5000, 1, 0.0f, 1.5, 100 );
+	ASSERT_EQ( mixed.beam( 5000, 0.0f ), search( mixed, bound, 5000, 0.0f, 1 ) );
+	ASSERT_GT( bound.npruned(), 0 );
+	ASSERT_EQ( mixed.parents.size(), bound.npruned() + bound.nexpanded() );
+}
+
+}}}
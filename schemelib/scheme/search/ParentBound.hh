@@ -0,0 +1,107 @@
+#ifndef INCLUDED_search_ParentBound_hh
+#define INCLUDED_search_ParentBound_hh
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <queue>
+#include <vector>
+
+namespace scheme { namespace search {
+
+// branch and bound for one level of a hierarchical beam search. the parents
+// are expanded best first, and a parent is skipped if none of its children
+// can make the beam of the beam_size best children under cut.
+//
+// the cutoff: each thread keeps the beam_size best children it scored. any
+// thread's worst kept score is no better than the worst score of the final
+// beam, so the lowest of these, and cut, is a safe cutoff for the beam.
+//
+// the bound: children are assumed to score no better than parent score minus
+// slack, where slack is slack_scale times the largest improvement of a child
+// over its parent seen so far at this level. it is not a proof, so no parent
+// is skipped until min_calibration parents have been expanded, and a larger
+// slack_scale is more cautious.
+//
+// parents scoring unscored or worse (e.g. the 9e9 placeholder of points that
+// were never scored) say nothing about their children: they are always
+// expanded and don't count towards the calibration
+template< class Float = float >
+struct ParentBound {
+
+	ParentBound( size_t beam_size, int nthreads, Float cut, Float slack_scale, size_t min_calibration, Float unscored = 1e9 )
+		: beam_size_( beam_size )
+		, slack_scale_( slack_scale )
+		, min_calibration_( min_calibration )
+		, unscored_( unscored )
+		, threads_( nthreads > 0 ? nthreads : 1 )
+		, cutoff_( cut )
+		, max_improvement_( 0 )
+		, nexpanded_( 0 )
+		, ncalibrated_( 0 )
+		, npruned_( 0 )
+	{}
+
+	// a child scored by ithread. only children under cut are beam candidates
+	void add_child( int ithread, Float score ){
+		if( beam_size_ == 0 || !( score < cutoff_.load( std::memory_order_relaxed ) ) ) return;
+		ThreadBeam & t = threads_[ithread];
+		if( t.worst.size() < beam_size_ ){
+			t.worst.push( score );
+		} else if( score < t.worst.top() ){
+			t.worst.pop();
+			t.worst.push( score );
+		}
+		if( t.worst.size() == beam_size_ ) lower( cutoff_, t.worst.top() );
+	}
+
+	// a parent and the best score among its children
+	void add_parent( Float parent_score, Float best_child_score ){
+		++nexpanded_;
+		if( !( parent_score < unscored_ ) ) return;
+		raise( max_improvement_, parent_score - best_child_score );
+		++ncalibrated_;
+	}
+
+	// true if no child of a parent with this score can make the beam. counts it
+	bool prune( Float parent_score ){
+		if( slack_scale_ <= 0 || ncalibrated_.load( std::memory_order_relaxed ) < min_calibration_ ) return false;
+		if( !( parent_score < unscored_ ) ) return false;
+		if( parent_score - slack() < cutoff() ) return false;
+		++npruned_;
+		return true;
+	}
+
+	Float cutoff() const { return cutoff_.load( std::memory_order_relaxed ); }
+	Float slack() const { return slack_scale_ * max_improvement_.load( std::memory_order_relaxed ); }
+	uint64_t nexpanded() const { return nexpanded_; }
+	uint64_t npruned() const { return npruned_; }
+
+private:
+	static void lower( std::atomic<Float> & a, Float x ){
+		Float cur = a.load( std::memory_order_relaxed );
+		while( x < cur && !a.compare_exchange_weak( cur, x, std::memory_order_relaxed ) );
+	}
+	static void raise( std::atomic<Float> & a, Float x ){
+		Float cur = a.load( std::memory_order_relaxed );
+		while( x > cur && !a.compare_exchange_weak( cur, x, std::memory_order_relaxed ) );
+	}
+
+	struct ThreadBeam {
+		std::priority_queue<Float> worst; // max heap, top is the worst kept
+		char pad[64]; // keep threads off each other's cache lines
+	};
+
+	size_t beam_size_;
+	Float slack_scale_;
+	size_t min_calibration_;
+	Float unscored_;
+	std::vector<ThreadBeam> threads_;
+	std::atomic<Float> cutoff_, max_improvement_;
+	std::atomic<uint64_t> nexpanded_, ncalibrated_, npruned_;
+};
+
+}}
+
+#endif
@@ -1,5 +1,8 @@
+#ifndef INCLUDED_search_SpatialBandB_hh
+#define INCLUDED_search_SpatialBandB_hh
 
 #include <scheme/kinematics/Director.hh>
+#include <scheme/search/ParentBound.hh>
 
 #include <list>
 
@@ -71,3 +74,5 @@ struct SpatialBandB {
 };
 
 }}
+
+#endif
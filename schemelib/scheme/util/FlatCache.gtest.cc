@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include "scheme/util/FlatCache.hh"
+
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace scheme { namespace util { namespace test_flat_cache {
+
+TEST( FlatCache, content_hash ){
+	ContentHash a, b, c;
+	a.add( std::string("ab") ); a.add( std::string("c") );
+	b.add( std::string("a") ); b.add( std::string("bc") );
+	c.add( std::string("ab") ); c.add( std::string("c") );
+	ASSERT_NE( a.hex(), b.hex() );
+	ASSERT_EQ( a.hex(), c.hex() );
+	ASSERT_EQ( 32, a.hex().size() );
+	std::vector<float> x( 1001, 1.0f );
+	ContentHash h0, h1;
+	h0.add( &x[0], x.size()*sizeof(float) );
+	x[777] = 1.0001f;
+	h1.add( &x[0], x.size()*sizeof(float) );
+	ASSERT_NE( h0.hex(), h1.hex() );
+}
+
+TEST( FlatCache, save_open ){
+	std::string const fname = "FlatCache_test.flat";
+	ContentHash key, other;
+	key.add( std::string("scaffold") );
+	other.add( std::string("target") );
+	std::string payload( 100003, 0 );
+	std::mt19937 rng( 123 );
+	for( auto & ch : payload ) ch = rng();
+
+	::unlink( fname.c_str() );
+	FlatCacheFile f;
+	ASSERT_FALSE( f.open( fname, "test", key ) );
+	ASSERT_TRUE( save_flat_cache( fname, "test", key, payload ) );
+	ASSERT_TRUE( f.open( fname, "test", key ) );
+	ASSERT_EQ( payload, std::string( f.data(), f.size() ) );
+	ASSERT_FALSE( FlatCacheFile().open( fname, "test", other ) );
+	ASSERT_FALSE( FlatCacheFile().open( fname, "other", key ) );
+
+	// the mapping stays valid after the file is replaced
+	ASSERT_TRUE( save_flat_cache( fname, "test", key, std::string("new") ) );
+	ASSERT_EQ( payload, std::string( f.data(), f.size() ) );
+
+	{ // corrupt one byte of the payload
+		ASSERT_TRUE( save_flat_cache( fname, "test", key, payload ) );
+		std::fstream io( fname, std::ios::in | std::ios::out | std::ios::binary );
+		io.seekp( -5, std::ios::end );
+		io.put( ~payload[ payload.size()-5 ] );
+	}
+	ASSERT_FALSE( FlatCacheFile().open( fname, "test", key ) );
+
+	MemoryStreamBuf buf( f.data(), f.size() );
+	std::istream in( &buf );
+	std::string head( 10, 0 );
+	in.read( &head[0], 10 );
+	ASSERT_EQ( payload.substr( 0, 10 ), head );
+	::unlink( fname.c_str() );
+}
+
+TEST( FlatCache, concurrent_writers_and_readers ){
+	std::string const fname = "FlatCache_test_concurrent.flat";
+	::unlink( fname.c_str() );
+	ContentHash key;
+	key.add( std::string("shared") );
+	std::string payload( 1<<20, 'x' );
+	for( size_t i = 0; i < payload.size(); ++i ) payload[i] = i*7919;
+	ASSERT_TRUE( save_flat_cache( fname, "test", key, payload ) );
+	// readers always find a complete file while writers keep replacing it
+	std::atomic<int> nread( 0 ), nbad( 0 );
+	std::vector<std::thread> threads;
+	for( int t = 0; t < 8; ++t ){
+		threads.push_back( std::thread( [&,t](){
+			for( int i = 0; i < 20; ++i ){
+				if( t%2 ){
+					if( !save_flat_cache( fname, "test", key, payload ) ) ++nbad;
+				} else {
+					FlatCacheFile f;
+					if( !f.open( fname, "test", key ) ) ++nbad;
+					else if( std::string( f.data(), f.size() ) != payload ) ++nbad;
+					else ++nread;
+				}
+			}
+		}));
+	}
+	for( auto & th : threads ) th.join();
+	ASSERT_EQ( 0, nbad );
+	ASSERT_EQ( 80, nread );
+	::unlink( fname.c_str() );
+}
+
+}}}
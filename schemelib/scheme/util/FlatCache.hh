@@ -0,0 +1,253 @@
+#ifndef INCLUDED_util_FlatCache_HH
+#define INCLUDED_util_FlatCache_HH
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace scheme { namespace util {
+
+// streaming 128 bit hash for content addressed cache keys, two 64 bit lanes
+// with murmur3 style mixing. not cryptographic. the result depends on how the
+// input is split into add() calls, so add things field by field, the same way
+// every time. add( std::string ) includes the length, so fields can't run together
+struct ContentHash {
+
+	ContentHash() : h1_( 0x9e3779b97f4a7c15ULL ), h2_( 0xc2b2ae3d27d4eb4fULL ), len_( 0 ) {}
+
+	void add( void const * data, size_t n ){
+		unsigned char const * p = static_cast<unsigned char const *>( data );
+		size_t const nblock = n / 16;
+		for( size_t i = 0; i < nblock; ++i ){
+			uint64_t k1, k2;
+			std::memcpy( &k1, p + 16*i, 8 );
+			std::memcpy( &k2, p + 16*i + 8, 8 );
+			mix( k1, k2 );
+		}
+		uint64_t k[2] = { 0, 0 };
+		if( n > 16*nblock ) std::memcpy( k, p + 16*nblock, n - 16*nblock );
+		mix( k[0] ^ ( n - 16*nblock ), k[1] );
+		len_ += n;
+	}
+
+	template< class T >
+	void add_pod( T const & t ){ add( &t, sizeof(T) ); }
+
+	void add( std::string const & s ){
+		add_pod( (uint64_t)s.size() );
+		add( s.data(), s.size() );
+	}
+
+	void digest( uint64_t & d1, uint64_t & d2 ) const {
+		d1 = h1_ ^ len_;
+		d2 = h2_ ^ len_;
+		d1 += d2;
+		d2 += d1;
+		d1 = fmix( d1 );
+		d2 = fmix( d2 );
+		d1 += d2;
+		d2 += d1;
+	}
+
+	std::string hex() const {
+		uint64_t d1, d2;
+		digest( d1, d2 );
+		char buf[33];
+		std::snprintf( buf, 33, "%016llx%016llx", (unsigned long long)d1, (unsigned long long)d2 );
+		return std::string( buf );
+	}
+
+private:
+	static uint64_t rotl( uint64_t x, int r ){ return ( x << r ) | ( x >> ( 64 - r ) ); }
+
+	static uint64_t fmix( uint64_t k ){
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdULL;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ULL;
+		k ^= k >> 33;
+		return k;
+	}
+
+	void mix( uint64_t k1, uint64_t k2 ){
+		uint64_t const c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+		k1 *= c1; k1 = rotl( k1, 31 ); k1 *= c2; h1_ ^= k1;
+		h1_ = rotl( h1_, 27 ); h1_ += h2_; h1_ = h1_*5 + 0x52dce729;
+		k2 *= c2; k2 = rotl( k2, 33 ); k2 *= c1; h2_ ^= k2;
+		h2_ = rotl( h2_, 31 ); h2_ += h1_; h2_ = h2_*5 + 0x38495ab5;
+	}
+
+	uint64_t h1_, h2_, len_;
+};
+
+
+// fixed size header of a flat cache file, followed by the payload at
+// payload_offset. the payload is stored uncompressed so it can be mmaped
+struct FlatCacheHeader {
+	char     magic[16];
+	uint64_t version;
+	char     kind[32];
+	uint64_t key[2];
+	uint64_t checksum[2];
+	uint64_t payload_size;
+	uint64_t payload_offset;
+	static char const * MAGIC() { return "SchemeFlatCache"; }
+	static uint64_t VERSION() { return 1; }
+};
+
+// Write payload to fname so that concurrent readers and writers are safe
+// without locks: the file is written under a unique temporary name in the
+// same directory, synced, then renamed over fname, which is atomic. Readers
+// see either no file or a complete one. If two jobs miss at once, both write
+// and the last rename wins; as the name is content addressed the files are
+// the same. kind must be shorter than 32 chars
+inline bool save_flat_cache(
+	std::string const & fname,
+	std::string const & kind,
+	ContentHash const & key,
+	char const * payload,
+	size_t payload_size
+){
+	if( kind.size() >= 32 ){
+		std::cerr << "save_flat_cache: kind too long " << kind << std::endl;
+		return false;
+	}
+	FlatCacheHeader header;
+	std::memset( &header, 0, sizeof(FlatCacheHeader) );
+	std::strncpy( header.magic, FlatCacheHeader::MAGIC(), 15 );
+	std::strncpy( header.kind, kind.c_str(), 31 );
+	header.version = FlatCacheHeader::VERSION();
+	key.digest( header.key[0], header.key[1] );
+	ContentHash check;
+	check.add( payload, payload_size );
+	check.digest( header.checksum[0], header.checksum[1] );
+	header.payload_size = payload_size;
+	header.payload_offset = ( sizeof(FlatCacheHeader) + 63 ) / 64 * 64;
+
+	static std::atomic<uint64_t> counter( 0 );
+	char suffix[64];
+	std::snprintf( suffix, 64, ".tmp.%ld.%llu", (long)::getpid(), (unsigned long long)counter++ );
+	std::string const tmpname = fname + suffix;
+
+	int fd = ::open( tmpname.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644 );
+	if( fd < 0 ){
+		std::cerr << "save_flat_cache: can't create " << tmpname << std::endl;
+		return false;
+	}
+	char pad[64];
+	std::memset( pad, 0, 64 );
+	bool ok = true;
+	auto write_all = [&]( char const * p, size_t n ){
+		while( ok && n > 0 ){
+			ssize_t const w = ::write( fd, p, n );
+			if( w <= 0 ){ ok = false; break; }
+			p += w;
+			n -= w;
+		}
+	};
+	write_all( (char const *)&header, sizeof(FlatCacheHeader) );
+	write_all( pad, header.payload_offset - sizeof(FlatCacheHeader) );
+	write_all( payload, payload_size );
+	ok = ok && ::fsync( fd ) == 0;
+	ok = ( ::close( fd ) == 0 ) && ok;
+	ok = ok && ::rename( tmpname.c_str(), fname.c_str() ) == 0;
+	if( !ok ){
+		std::cerr << "save_flat_cache: write failed " << fname << std::endl;
+		::unlink( tmpname.c_str() );
+	}
+	return ok;
+}
+
+inline bool save_flat_cache( std::string const & fname, std::string const & kind, ContentHash const & key, std::string const & payload ){
+	return save_flat_cache( fname, kind, key, payload.data(), payload.size() );
+}
+
+// read-only mapping of a file written by save_flat_cache. open() is false if
+// the file doesn't exist, or doesn't match kind and key, or fails the checksum;
+// all of these are cache misses
+struct FlatCacheFile {
+
+	bool open( std::string const & fname, std::string const & kind, ContentHash const & key ){
+		close();
+		int fd = ::open( fname.c_str(), O_RDONLY );
+		if( fd < 0 ) return false;
+		struct stat st;
+		if( ::fstat( fd, &st ) != 0 || (size_t)st.st_size < sizeof(FlatCacheHeader) ){
+			std::cerr << "FlatCacheFile::open, file too small " << fname << std::endl;
+			::close( fd );
+			return false;
+		}
+		size_t const file_size = st.st_size;
+		void * addr = ::mmap( nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0 );
+		::close( fd );
+		if( addr == MAP_FAILED ){
+			std::cerr << "FlatCacheFile::open, mmap failed " << fname << std::endl;
+			return false;
+		}
+		std::shared_ptr<void const> mapping( addr, [file_size]( void const * p ){ ::munmap( const_cast<void*>(p), file_size ); } );
+		char const * base = static_cast<char const *>( addr );
+
+		FlatCacheHeader header;
+		std::memcpy( &header, base, sizeof(FlatCacheHeader) );
+		uint64_t k1, k2;
+		key.digest( k1, k2 );
+		if( std::strncmp( header.magic, FlatCacheHeader::MAGIC(), 16 ) != 0 ||
+		    header.version != FlatCacheHeader::VERSION() ||
+		    std::strncmp( header.kind, kind.c_str(), 32 ) != 0 ||
+		    header.key[0] != k1 || header.key[1] != k2 ){
+			std::cerr << "FlatCacheFile::open, wrong version, kind or key " << fname << std::endl;
+			return false;
+		}
+		if( header.payload_offset + header.payload_size != file_size ){
+			std::cerr << "FlatCacheFile::open, truncated " << fname << std::endl;
+			return false;
+		}
+		ContentHash check;
+		check.add( base + header.payload_offset, header.payload_size );
+		check.digest( k1, k2 );
+		if( header.checksum[0] != k1 || header.checksum[1] != k2 ){
+			std::cerr << "FlatCacheFile::open, bad checksum " << fname << std::endl;
+			return false;
+		}
+		mapping_ = mapping;
+		data_ = base + header.payload_offset;
+		size_ = header.payload_size;
+		return true;
+	}
+
+	void close(){
+		mapping_.reset();
+		data_ = nullptr;
+		size_ = 0;
+	}
+
+	char const * data() const { return data_; }
+	size_t size() const { return size_; }
+
+private:
+	std::shared_ptr<void const> mapping_;
+	char const * data_ = nullptr;
+	size_t size_ = 0;
+};
+
+// istream source over memory, e.g. a FlatCacheFile payload, for code that loads from streams
+struct MemoryStreamBuf : public std::streambuf {
+	MemoryStreamBuf( char const * data, size_t size ){
+		char * p = const_cast<char*>( data );
+		setg( p, p, p + size );
+	}
+};
+
+}}
+
+#endif
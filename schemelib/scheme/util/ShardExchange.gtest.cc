@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+
+#include "scheme/util/ShardExchange.hh"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace scheme { namespace util { namespace test_shard_exchange {
+
+TEST( ShardExchange, shard_range ){
+	for( int64_t n : { 0, 1, 7, 64, 1001 } ){
+		for( int nshards : { 1, 2, 3, 8 } ){
+			int64_t prev_end = 0;
+			for( int i = 0; i < nshards; ++i ){
+				int64_t b, e;
+				shard_range( n, nshards, i, b, e );
+				ASSERT_EQ( prev_end, b );
+				ASSERT_LE( e - b, n / nshards + 1 );
+				prev_end = e;
+			}
+			ASSERT_EQ( n, prev_end );
+		}
+	}
+}
+
+// a coordinator and worker processes scoring a "beam" in stages, with the
+// coordinator keeping the global top of the merged scores at each stage
+TEST( ShardExchange, coordinator_and_worker_processes ){
+	char tmpl[] = "/tmp/ShardExchange_test_XXXXXX";
+	ASSERT_TRUE( mkdtemp( tmpl ) );
+	std::string const dir( tmpl );
+	int const NSHARDS = 4, NSTAGES = 3;
+	auto score = []( int64_t x, int stage ){ return (float)( ( x * 7919 + stage * 104729 ) % 1000 ); };
+
+	std::vector<pid_t> workers;
+	for( int ishard = 1; ishard < NSHARDS; ++ishard ){
+		pid_t pid = fork();
+		ASSERT_GE( pid, 0 );
+		if( pid == 0 ){
+			ShardExchange ex( dir, NSHARDS, ishard );
+			for( int stage = 0; stage < NSTAGES; ++stage ){
+				FlatCacheFile msg;
+				if( !ex.wait_for( "points_" + std::to_string( stage ), msg, "done", 60 ) ) _exit( 1 );
+				int64_t const * points = (int64_t const *)msg.data();
+				int64_t b, e;
+				shard_range( msg.size() / sizeof(int64_t), NSHARDS, ishard, b, e );
+				std::vector<float> scores;
+				for( int64_t i = b; i < e; ++i ) scores.push_back( score( points[i], stage ) );
+				if( !ex.publish( "scores_" + std::to_string( stage ) + "_" + std::to_string( ishard ),
+					(char const *)scores.data(), scores.size() * sizeof(float) ) ) _exit( 2 );
+			}
+			FlatCacheFile msg;
+			_exit( ex.wait_for( "never", msg, "done", 60 ) ? 3 : 0 );
+		}
+		workers.push_back( pid );
+	}
+
+	ShardExchange ex( dir, NSHARDS, 0 );
+	ASSERT_TRUE( ex.is_coordinator() );
+	std::vector<int64_t> beam;
+	for( int64_t i = 0; i < 1003; ++i ) beam.push_back( i );
+	for( int stage = 0; stage < NSTAGES; ++stage ){
+		ASSERT_TRUE( ex.publish( "points_" + std::to_string( stage ), (char const *)beam.data(), beam.size() * sizeof(int64_t) ) );
+		std::vector<float> scores( beam.size() );
+		int64_t b, e;
+		shard_range( beam.size(), NSHARDS, 0, b, e );
+		for( int64_t i = b; i < e; ++i ) scores[i] = score( beam[i], stage );
+		for( int ishard = 1; ishard < NSHARDS; ++ishard ){
+			FlatCacheFile msg;
+			ASSERT_TRUE( ex.wait_for( "scores_" + std::to_string( stage ) + "_" + std::to_string( ishard ), msg, "", 60 ) );
+			shard_range( beam.size(), NSHARDS, ishard, b, e );
+			ASSERT_EQ( ( e - b ) * sizeof(float), msg.size() );
+			std::copy( (float const *)msg.data(), (float const *)msg.data() + ( e - b ), scores.begin() + b );
+			ASSERT_TRUE( ex.remove( "scores_" + std::to_string( stage ) + "_" + std::to_string( ishard ) ) );
+		}
+		// every worker has sent its scores, so it is done with the points
+		ASSERT_TRUE( ex.remove( "points_" + std::to_string( stage ) ) );
+		ASSERT_FALSE( ex.remove( "points_" + std::to_string( stage ) ) );
+		for( size_t i = 0; i < beam.size(); ++i ) ASSERT_EQ( score( beam[i], stage ), scores[i] );
+
+		// keep the best half, expand each survivor into two children
+		std::vector<size_t> order( beam.size() );
+		for( size_t i = 0; i < order.size(); ++i ) order[i] = i;
+		std::stable_sort( order.begin(), order.end(), [&]( size_t i, size_t j ){ return scores[i] < scores[j]; } );
+		std::vector<int64_t> next;
+		for( size_t i = 0; i < order.size() / 2; ++i ){
+			next.push_back( beam[order[i]] * 2 );
+			next.push_back( beam[order[i]] * 2 + 1 );
+		}
+		beam.swap( next );
+	}
+	ASSERT_TRUE( ex.publish( "done", "" ) );
+
+	for( pid_t pid : workers ){
+		int status = 0;
+		ASSERT_EQ( pid, waitpid( pid, &status, 0 ) );
+		ASSERT_TRUE( WIFEXITED( status ) );
+		ASSERT_EQ( 0, WEXITSTATUS( status ) );
+	}
+	ASSERT_FALSE( ex.is_empty() );
+	ASSERT_TRUE( ex.remove( "done" ) );
+	ASSERT_TRUE( ex.is_empty() ); // nothing else was left behind
+	ASSERT_EQ( 0, std::system( ( "rm -rf " + dir ).c_str() ) );
+}
+
+}}}
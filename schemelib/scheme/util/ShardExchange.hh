@@ -0,0 +1,110 @@
+#ifndef INCLUDED_util_ShardExchange_HH
+#define INCLUDED_util_ShardExchange_HH
+
+#include "scheme/util/FlatCache.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include <dirent.h>
+
+namespace scheme { namespace util {
+
+// contiguous slice [begin,end) of n items for shard ishard of nshards. the
+// slices cover [0,n) in order and differ in size by at most one
+inline void shard_range( int64_t n, int nshards, int ishard, int64_t & begin, int64_t & end ){
+	begin = n * ishard / nshards;
+	end   = n * ( ishard + 1 ) / nshards;
+}
+
+// rendezvous between the processes of one sharded job through a directory
+// they all see, e.g. a local or network disk. shard 0 coordinates, the rest
+// are workers. messages are named files written with save_flat_cache, so a
+// reader sees either no message or a complete one, and there is no server or
+// socket to set up. each name must be published once per run, so the
+// directory must not hold messages from an earlier run; see is_empty().
+// a message can be removed once every process that reads it is known to be
+// past it; readers that still have it open keep their mapping
+struct ShardExchange {
+
+	ShardExchange( std::string const & dir, int nshards, int ishard )
+	  : dir_( dir ), nshards_( nshards ), ishard_( ishard ), poll_ms_( 20 ) {}
+
+	int nshards() const { return nshards_; }
+	int ishard() const { return ishard_; }
+	bool is_coordinator() const { return ishard_ == 0; }
+
+	bool publish( std::string const & name, char const * data, size_t size ) const {
+		return save_flat_cache( fname( name ), KIND(), key( name ), data, size );
+	}
+
+	bool publish( std::string const & name, std::string const & data ) const {
+		return publish( name, data.data(), data.size() );
+	}
+
+	bool poll( std::string const & name, FlatCacheFile & msg ) const {
+		return msg.open( fname( name ), KIND(), key( name ) );
+	}
+
+	// blocks until name is published. if cancel_name is published first, or
+	// nothing comes within timeout_seconds (<= 0 waits forever), it is false
+	bool wait_for( std::string const & name, FlatCacheFile & msg,
+		std::string const & cancel_name = "", double timeout_seconds = 0 ) const
+	{
+		auto const start = std::chrono::steady_clock::now();
+		while( true ){
+			if( exists( name ) && poll( name, msg ) ) return true;
+			if( cancel_name.size() && exists( cancel_name ) ) return false;
+			std::chrono::duration<double> waited = std::chrono::steady_clock::now() - start;
+			if( timeout_seconds > 0 && waited.count() > timeout_seconds ){
+				std::cerr << "ShardExchange: timed out waiting for " << fname( name ) << std::endl;
+				return false;
+			}
+			std::this_thread::sleep_for( std::chrono::milliseconds( poll_ms_ ) );
+		}
+	}
+
+	// false if there was no such message
+	bool remove( std::string const & name ) const {
+		return std::remove( fname( name ).c_str() ) == 0;
+	}
+
+	bool exists( std::string const & name ) const {
+		return ::access( fname( name ).c_str(), F_OK ) == 0;
+	}
+
+	// true if dir holds no messages, i.e. it is safe to start a run in it
+	bool is_empty() const {
+		DIR * dir = opendir( dir_.c_str() );
+		if( !dir ) return true;
+		bool empty = true;
+		while( dirent * ent = readdir( dir ) ){
+			std::string const name( ent->d_name );
+			if( name != "." && name != ".." ) empty = false;
+		}
+		closedir( dir );
+		return empty;
+	}
+
+	std::string fname( std::string const & name ) const { return dir_ + "/" + name + ".shardmsg"; }
+
+private:
+	static char const * KIND() { return "ShardExchange"; }
+
+	ContentHash key( std::string const & name ) const {
+		ContentHash k;
+		k.add( name );
+		k.add_pod( (int32_t)nshards_ );
+		return k;
+	}
+
+	std::string dir_;
+	int nshards_, ishard_, poll_ms_;
+};
+
+}}
+
+#endif
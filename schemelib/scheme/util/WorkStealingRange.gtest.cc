@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+
+#include "scheme/util/WorkStealingRange.hh"
+
+#include <thread>
+
+namespace scheme { namespace util { namespace test_wsr {
+
+TEST( WorkStealingRange, covers_range_once ){
+	for( int nthreads : { 1, 3, 8 } ){
+		for( int64_t n : { 0, 1, 100, 12345 } ){
+			WorkStealingRange work( n, nthreads, 2, 7 );
+			std::vector< std::atomic<int> > count( n );
+			for( auto & c : count ) c = 0;
+			std::vector< std::thread > threads;
+			for( int t = 0; t < nthreads; ++t ){
+				threads.push_back( std::thread( [&,t](){
+					int victim = 0;
+					int64_t begin, end;
+					while( work.next( t, victim, begin, end ) ){
+						ASSERT_LT( begin, end );
+						ASSERT_LE( end - begin, 7 );
+						for( int64_t i = begin; i < end; ++i ) ++count[i];
+					}
+				}));
+			}
+			for( auto & th : threads ) th.join();
+			for( int64_t i = 0; i < n; ++i ) ASSERT_EQ( count[i], 1 );
+		}
+	}
+}
+
+TEST( WorkStealingRange, steals_own_group_first ){
+	// thread 0 alone does all the work: its own block, then 1 (same group), then 2 and 3
+	WorkStealingRange work( 40, 4, 2, 10 );
+	int victim = 0;
+	int64_t begin, end;
+	std::vector<int64_t> order;
+	while( work.next( 0, victim, begin, end ) ) order.push_back( begin );
+	ASSERT_EQ( order, std::vector<int64_t>( { 0, 10, 20, 30 } ) );
+	ASSERT_EQ( work.nstolen(), 3 );
+}
+
+TEST( WorkStealingRange, steals_from_the_back ){
+	// thread 1 finishes its block then takes thread 0's from the end, leaving
+	// thread 0 its front
+	WorkStealingRange work( 40, 2, 1, 5 );
+	int victim0 = 0, victim1 = 0;
+	int64_t begin, end;
+	ASSERT_TRUE( work.next( 0, victim0, begin, end ) );
+	ASSERT_EQ( begin, 0 );
+	std::vector<int64_t> order;
+	while( work.next( 1, victim1, begin, end ) ) order.push_back( begin );
+	ASSERT_EQ( order, std::vector<int64_t>( { 20, 25, 30, 35, 15, 10, 5 } ) );
+	ASSERT_EQ( work.nstolen(), 3 );
+	ASSERT_FALSE( work.next( 0, victim0, begin, end ) );
+}
+
+}}}
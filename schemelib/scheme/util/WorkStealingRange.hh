@@ -0,0 +1,121 @@
+#ifndef INCLUDED_scheme_util_WorkStealingRange_HH
+#define INCLUDED_scheme_util_WorkStealingRange_HH
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+
+namespace scheme {
+namespace util {
+
+// number of NUMA nodes, from sysfs. 1 if unknown
+inline int numa_node_count(){
+	DIR * dir = opendir( "/sys/devices/system/node" );
+	if( !dir ) return 1;
+	int n = 0;
+	while( dirent * ent = readdir( dir ) ){
+		std::string name( ent->d_name );
+		if( name.size() > 4 && name.substr( 0, 4 ) == "node" && name.find_first_not_of( "0123456789", 4 ) == std::string::npos ) ++n;
+	}
+	closedir( dir );
+	return n > 0 ? n : 1;
+}
+
+// parallel loop over [0,n) where each thread owns one contiguous block and
+// takes grains from the front of it in order, so neighboring items (e.g.
+// children of the same parent) stay on one thread. a thread that runs out
+// steals grains from the back of other blocks, first from threads in its own
+// group (socket), then from the other groups, so the owner's front stays
+// contiguous. thread ithread is in group ithread*ngroups/nthreads, which
+// matches OMP_PROC_BIND=close placement
+class WorkStealingRange {
+	// grains [front,back) of the block still to take, front in the low 32 bits
+	// and back in the high 32 bits of one word, so the owner's fetch_add on the
+	// front and a thief's cas on the back can never hand out the same grain
+	struct Block {
+		std::atomic<uint64_t> grains;
+		int64_t begin, end;
+		char pad[64]; // keep the counters of different threads off one cache line
+	};
+	static uint64_t front( uint64_t g ){ return g & 0xffffffffull; }
+	static uint64_t back( uint64_t g ){ return g >> 32; }
+
+	std::vector<Block> blocks_;
+	std::vector<int> victims_; // steal order per thread, flattened nthreads x nthreads
+	int nthreads_, ngroups_;
+	int64_t grain_;
+	std::atomic<int64_t> nstolen_;
+
+	int group( int ithread ) const { return (int64_t)ithread * ngroups_ / nthreads_; }
+
+	void grain_range( Block const & b, uint64_t igrain, int64_t & begin, int64_t & end ) const {
+		begin = b.begin + (int64_t)igrain * grain_;
+		end = begin + grain_ < b.end ? begin + grain_ : b.end;
+	}
+
+public:
+	WorkStealingRange( int64_t n, int nthreads, int ngroups = 1, int64_t grain = 64 )
+		: blocks_( nthreads > 0 ? nthreads : 1 )
+		, nthreads_( nthreads > 0 ? nthreads : 1 )
+		, ngroups_( ngroups < 1 ? 1 : ( ngroups > nthreads_ ? nthreads_ : ngroups ) )
+		, grain_( grain > 0 ? grain : 1 )
+		, nstolen_( 0 )
+	{
+		// grain counts must fit in 31 bits, leaving room for the owner to overshoot
+		int64_t const maxblock = n / nthreads_ + 1;
+		if( maxblock / grain_ >= ( int64_t(1) << 31 ) ) grain_ = maxblock / ( int64_t(1) << 31 ) + 1;
+		for( int i = 0; i < nthreads_; ++i ){
+			Block & b = blocks_[i];
+			b.begin = n * i / nthreads_;
+			b.end = n * (i+1) / nthreads_;
+			uint64_t const ngrains = ( b.end - b.begin + grain_ - 1 ) / grain_;
+			b.grains = ngrains << 32;
+		}
+		victims_.reserve( nthreads_ * nthreads_ );
+		for( int i = 0; i < nthreads_; ++i ){
+			victims_.push_back( i );
+			for( int pass = 0; pass < 2; ++pass ){
+				for( int k = 1; k < nthreads_; ++k ){
+					int const j = ( i + k ) % nthreads_;
+					if( ( group(j) == group(i) ) == ( pass == 0 ) ) victims_.push_back( j );
+				}
+			}
+		}
+	}
+
+	// next chunk [begin,end) for ithread, false when no work is left anywhere.
+	// victim is per-thread state, start it at 0
+	bool next( int ithread, int & victim, int64_t & begin, int64_t & end ){
+		for( ; victim < nthreads_; ++victim ){
+			Block & b = blocks_[ victims_[ ithread*nthreads_ + victim ] ];
+			uint64_t g = b.grains.load( std::memory_order_relaxed );
+			if( front(g) >= back(g) ) continue;
+			if( victim == 0 ){
+				g = b.grains.fetch_add( 1 );
+				if( front(g) >= back(g) ) continue;
+				grain_range( b, front(g), begin, end );
+				return true;
+			}
+			while( front(g) < back(g) ){
+				if( b.grains.compare_exchange_weak( g, g - ( uint64_t(1) << 32 ) ) ){
+					grain_range( b, back(g) - 1, begin, end );
+					++nstolen_;
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	int64_t nstolen() const { return nstolen_; }
+	int ngroups() const { return ngroups_; }
+};
+
+}
+}
+
+#endif